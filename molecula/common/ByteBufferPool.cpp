@@ -0,0 +1,38 @@
+#include "molecula/common/ByteBufferPool.hpp"
+
+namespace molecula {
+
+ByteBuffer ByteBufferPool::acquire(size_t capacity) {
+    {
+        std::lock_guard lock{mutex};
+        auto it = buffers.lower_bound(capacity);
+        if (it != buffers.end() && it->first <= 2 * capacity) {
+            ByteBuffer buffer = std::move(it->second);
+            pooledBytes -= it->first;
+            buffers.erase(it);
+            buffer.clear();
+            return buffer;
+        }
+    }
+    return ByteBuffer{ByteBuffer::align(capacity)};
+}
+
+void ByteBufferPool::release(ByteBuffer buffer) {
+    size_t capacity = buffer.capacity();
+    if (capacity == 0) {
+        return;
+    }
+    std::lock_guard lock{mutex};
+    if (pooledBytes + capacity > maxPooledBytes) {
+        return;
+    }
+    pooledBytes += capacity;
+    buffers.emplace(capacity, std::move(buffer));
+}
+
+size_t ByteBufferPool::getPooledBytes() const {
+    std::lock_guard lock{mutex};
+    return pooledBytes;
+}
+
+} // namespace molecula
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "molecula/common/ByteBuffer.hpp"
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+
+namespace molecula {
+
+// Pool of released buffers for reuse, to avoid allocating and faulting in large buffers again.
+// Keeps at most @maxPooledBytes of capacity, buffers released beyond that are freed. Thread safe.
+class ByteBufferPool {
+public:
+    explicit ByteBufferPool(size_t maxPooledBytes) : maxPooledBytes{maxPooledBytes} {}
+
+    ByteBufferPool(const ByteBufferPool &) = delete;
+    ByteBufferPool &operator=(const ByteBufferPool &) = delete;
+
+    // Empty buffer with at least @capacity. A pooled buffer is taken if it is at most twice as
+    // large as needed.
+    ByteBuffer acquire(size_t capacity);
+    void release(ByteBuffer buffer);
+
+    size_t getPooledBytes() const;
+
+private:
+    const size_t maxPooledBytes{};
+    mutable std::mutex mutex;
+    // By capacity
+    std::multimap<size_t, ByteBuffer> buffers;
+    size_t pooledBytes{};
+};
+
+} // namespace molecula
@@ -0,0 +1,36 @@
+#include "molecula/common/ByteBufferPool.hpp"
+
+#include <gtest/gtest.h>
+
+namespace molecula {
+
+GTEST_TEST(ByteBufferPool, Reuse) {
+    ByteBufferPool pool{1024};
+    ByteBuffer buffer = pool.acquire(100);
+    EXPECT_EQ(buffer.size(), 0);
+    EXPECT_GE(buffer.capacity(), 100);
+    buffer.append("data");
+    const char *data = buffer.data();
+    pool.release(std::move(buffer));
+    EXPECT_EQ(pool.getPooledBytes(), 128);
+
+    ByteBuffer reused = pool.acquire(64);
+    EXPECT_EQ(reused.data(), data);
+    EXPECT_EQ(reused.size(), 0);
+    EXPECT_EQ(pool.getPooledBytes(), 0);
+}
+
+GTEST_TEST(ByteBufferPool, Sizes) {
+    ByteBufferPool pool{1024};
+    pool.release(pool.acquire(512));
+    // Too small, and too large to waste
+    EXPECT_EQ(pool.acquire(1000).capacity(), 1024);
+    EXPECT_EQ(pool.acquire(100).capacity(), 128);
+    EXPECT_EQ(pool.getPooledBytes(), 512);
+
+    // Over the limit
+    pool.release(pool.acquire(1000));
+    EXPECT_EQ(pool.getPooledBytes(), 512);
+}
+
+} // namespace molecula
@@ -0,0 +1,67 @@
+#include "molecula/common/LatencyHistogram.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace molecula {
+
+int LatencyHistogram::getBucket(uint64_t micros) {
+    if (micros < kSubBuckets) {
+        return static_cast<int>(micros);
+    }
+    // Position of the highest bit, then two next bits select the sub-bucket.
+    int exponent = std::bit_width(micros) - 1;
+    int subBucket = static_cast<int>((micros >> (exponent - 2)) & (kSubBuckets - 1));
+    return std::min((exponent - 1) * kSubBuckets + subBucket, kNumBuckets - 1);
+}
+
+uint64_t LatencyHistogram::getBucketUpperBound(int bucket) {
+    if (bucket < kSubBuckets) {
+        return bucket;
+    }
+    int exponent = bucket / kSubBuckets + 1;
+    uint64_t subBucket = bucket % kSubBuckets;
+    return ((kSubBuckets + subBucket + 1) << (exponent - 2)) - 1;
+}
+
+void LatencyHistogram::record(std::chrono::microseconds latency) {
+    auto micros = static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0));
+    buckets[getBucket(micros)].fetch_add(1, std::memory_order_relaxed);
+    if (count.fetch_add(1, std::memory_order_relaxed) + 1 == maxSamples) {
+        decay();
+    }
+}
+
+void LatencyHistogram::decay() {
+    uint64_t total = 0;
+    for (auto &bucket : buckets) {
+        // Concurrent updates may be lost, it is fine for an estimate.
+        uint64_t value = bucket.load(std::memory_order_relaxed) / 2;
+        bucket.store(value, std::memory_order_relaxed);
+        total += value;
+    }
+    count.store(total, std::memory_order_relaxed);
+}
+
+std::chrono::microseconds LatencyHistogram::getPercentile(double percentile) const {
+    uint64_t counts[kNumBuckets];
+    uint64_t total = 0;
+    for (int i = 0; i < kNumBuckets; i++) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return std::chrono::microseconds{0};
+    }
+    auto rank = static_cast<uint64_t>(std::clamp(percentile, 0.0, 1.0) * total);
+    uint64_t seen = 0;
+    for (int i = 0; i < kNumBuckets; i++) {
+        seen += counts[i];
+        if (seen > rank || seen == total) {
+            return std::chrono::microseconds{getBucketUpperBound(i)};
+        }
+    }
+    return std::chrono::microseconds{getBucketUpperBound(kNumBuckets - 1)};
+}
+
+} // namespace molecula
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace molecula {
+
+// Lock-free latency histogram with log-linear buckets: 4 buckets per power of 2 microseconds,
+// so percentiles are accurate within ~19%. Counts are halved once @maxSamples are recorded,
+// so old samples fade out and percentiles follow the current latency.
+class LatencyHistogram {
+public:
+    explicit LatencyHistogram(uint64_t maxSamples = 10'000) : maxSamples{maxSamples} {}
+
+    LatencyHistogram(const LatencyHistogram &) = delete;
+    LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+    void record(std::chrono::microseconds latency);
+
+    // Returns latency at @percentile in [0, 1], or zero if there are no samples.
+    std::chrono::microseconds getPercentile(double percentile) const;
+
+    uint64_t getCount() const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr int kSubBuckets = 4;
+    static constexpr int kNumBuckets = 40 * kSubBuckets;
+
+    static int getBucket(uint64_t micros);
+    static uint64_t getBucketUpperBound(int bucket);
+
+    void decay();
+
+    const uint64_t maxSamples{};
+    std::atomic<uint64_t> count{};
+    std::atomic<uint64_t> buckets[kNumBuckets]{};
+};
+
+} // namespace molecula
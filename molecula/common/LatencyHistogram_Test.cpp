@@ -0,0 +1,48 @@
+#include "molecula/common/LatencyHistogram.hpp"
+
+#include <gtest/gtest.h>
+
+namespace molecula {
+
+using std::chrono::microseconds;
+
+GTEST_TEST(LatencyHistogram, Empty) {
+    LatencyHistogram histogram;
+    EXPECT_EQ(histogram.getCount(), 0);
+    EXPECT_EQ(histogram.getPercentile(0.95), microseconds{0});
+}
+
+GTEST_TEST(LatencyHistogram, Percentiles) {
+    LatencyHistogram histogram;
+    for (int i = 1; i <= 1000; i++) {
+        histogram.record(microseconds{i * 100});
+    }
+    EXPECT_EQ(histogram.getCount(), 1000);
+
+    // Bucket upper bound is within 25% above the exact value.
+    auto p50 = histogram.getPercentile(0.5).count();
+    EXPECT_GE(p50, 50'000);
+    EXPECT_LE(p50, 62'500);
+    auto p95 = histogram.getPercentile(0.95).count();
+    EXPECT_GE(p95, 95'000);
+    EXPECT_LE(p95, 118'750);
+    auto p100 = histogram.getPercentile(1.0).count();
+    EXPECT_GE(p100, 100'000);
+}
+
+GTEST_TEST(LatencyHistogram, Decay) {
+    LatencyHistogram histogram{100};
+    for (int i = 0; i < 99; i++) {
+        histogram.record(microseconds{1'000});
+    }
+    histogram.record(microseconds{1'000});
+    EXPECT_EQ(histogram.getCount(), 50);
+
+    // New latency takes over after old samples fade out.
+    for (int i = 0; i < 500; i++) {
+        histogram.record(microseconds{100'000});
+    }
+    EXPECT_GE(histogram.getPercentile(0.5).count(), 100'000);
+}
+
+} // namespace molecula
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+
+namespace molecula {
+
+// Intrusive lock-free multi-producer single-consumer queue. Nodes are linked through the @Next
+// member, queue doesn't own them. Producers push one node at a time, the consumer takes all
+// queued nodes at once.
+template <typename T, T *T::*Next>
+class MpscQueue {
+public:
+    MpscQueue() = default;
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    // Returns true if the queue was empty. Only this producer needs to wake up the consumer.
+    bool push(T *node) {
+        T *first = head.load(std::memory_order_relaxed);
+        do {
+            node->*Next = first;
+        } while (!head.compare_exchange_weak(
+                first, node, std::memory_order_release, std::memory_order_relaxed));
+        return first == nullptr;
+    }
+
+    // Consumer only. Returns all queued nodes linked in push order, or null if empty.
+    T *popAll() {
+        T *node = head.exchange(nullptr, std::memory_order_acquire);
+        // Nodes are stacked in reverse order, restore FIFO.
+        T *result = nullptr;
+        while (node) {
+            T *next = node->*Next;
+            node->*Next = result;
+            result = node;
+            node = next;
+        }
+        return result;
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_relaxed) == nullptr;
+    }
+
+private:
+    std::atomic<T *> head{};
+};
+
+} // namespace molecula
@@ -0,0 +1,133 @@
+#include "molecula/common/MpscQueue.hpp"
+
+#include <gflags/gflags.h>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Request submission throughput: many producers, one consumer that wakes up on a file descriptor.
+// Compares mutex + std::queue + one pipe write per request with MpscQueue + eventfd that is
+// signalled only on the empty to non-empty transition.
+DEFINE_int32(producers, 16, "Number of producer threads");
+DEFINE_int32(submissions, 1'000'000, "Submissions per producer");
+
+namespace molecula {
+
+struct Request {
+    Request *next{};
+};
+
+class MutexPipeSubmitter {
+public:
+    MutexPipeSubmitter() {
+        ::pipe(fds);
+    }
+
+    ~MutexPipeSubmitter() {
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+
+    void submit(Request *request) {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            queue.push(request);
+        }
+        ::write(fds[1], "", 1);
+    }
+
+    // Returns number of requests taken.
+    long consume() {
+        char buf[1];
+        ::read(fds[0], buf, 1);
+        std::lock_guard<std::mutex> lock{mutex};
+        if (queue.empty()) {
+            return 0;
+        }
+        queue.pop();
+        return 1;
+    }
+
+private:
+    std::mutex mutex;
+    std::queue<Request *> queue;
+    int fds[2]{};
+};
+
+class MpscEventFdSubmitter {
+public:
+    MpscEventFdSubmitter() : fd{::eventfd(0, 0)} {}
+
+    ~MpscEventFdSubmitter() {
+        ::close(fd);
+    }
+
+    void submit(Request *request) {
+        if (queue.push(request)) {
+            uint64_t one = 1;
+            ::write(fd, &one, sizeof(one));
+        }
+    }
+
+    long consume() {
+        uint64_t value = 0;
+        ::read(fd, &value, sizeof(value));
+        long n = 0;
+        for (Request *request = queue.popAll(); request; request = request->next) {
+            n++;
+        }
+        return n;
+    }
+
+private:
+    MpscQueue<Request, &Request::next> queue;
+    int fd{};
+};
+
+template <typename Submitter>
+static void run(const char *name) {
+    Submitter submitter;
+    long total = long{FLAGS_producers} * FLAGS_submissions;
+    std::vector<Request> requests(total);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (int t = 0; t < FLAGS_producers; t++) {
+        producers.emplace_back([&, t] {
+            Request *first = &requests[long{t} * FLAGS_submissions];
+            for (int i = 0; i < FLAGS_submissions; i++) {
+                submitter.submit(first + i);
+            }
+        });
+    }
+    for (long consumed = 0; consumed < total;) {
+        consumed += submitter.consume();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    for (auto &producer : producers) {
+        producer.join();
+    }
+
+    std::printf(
+            "%-24s producers=%-3d %8.2f M submissions/s\n",
+            name,
+            FLAGS_producers,
+            total / elapsed.count() / 1e6);
+}
+
+} // namespace molecula
+
+int main(int argc, char **argv) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    molecula::run<molecula::MutexPipeSubmitter>("mutex+queue+pipe");
+    molecula::run<molecula::MpscEventFdSubmitter>("mpsc+eventfd");
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "molecula/common/MpscQueue.hpp"
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+namespace molecula {
+
+struct Node {
+    int value{};
+    Node *next{};
+};
+
+using NodeQueue = MpscQueue<Node, &Node::next>;
+
+GTEST_TEST(MpscQueue, PushPopAll) {
+    NodeQueue queue;
+    Node nodes[3]{{1}, {2}, {3}};
+
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(queue.popAll(), nullptr);
+
+    EXPECT_TRUE(queue.push(&nodes[0]));
+    EXPECT_FALSE(queue.push(&nodes[1]));
+    EXPECT_FALSE(queue.push(&nodes[2]));
+    EXPECT_FALSE(queue.empty());
+
+    Node *node = queue.popAll();
+    for (int expected = 1; expected <= 3; expected++) {
+        ASSERT_NE(node, nullptr);
+        EXPECT_EQ(node->value, expected);
+        node = node->next;
+    }
+    EXPECT_EQ(node, nullptr);
+    EXPECT_TRUE(queue.empty());
+
+    // Empty again, next push must report transition.
+    EXPECT_TRUE(queue.push(&nodes[0]));
+}
+
+GTEST_TEST(MpscQueue, ManyProducers) {
+    constexpr int kThreads = 8;
+    constexpr int kPerThread = 10'000;
+
+    NodeQueue queue;
+    std::vector<Node> nodes(kThreads * kPerThread);
+    std::vector<std::thread> producers;
+    for (int t = 0; t < kThreads; t++) {
+        producers.emplace_back([&, t] {
+            for (int i = 0; i < kPerThread; i++) {
+                auto &node = nodes[t * kPerThread + i];
+                node.value = i;
+                queue.push(&node);
+            }
+        });
+    }
+
+    // Per producer order must be preserved.
+    std::vector<int> last(kThreads, -1);
+    int count = 0;
+    while (count < kThreads * kPerThread) {
+        for (Node *node = queue.popAll(); node; node = node->next) {
+            int t = static_cast<int>((node - nodes.data()) / kPerThread);
+            EXPECT_EQ(node->value, last[t] + 1);
+            last[t] = node->value;
+            count++;
+        }
+    }
+    for (auto &producer : producers) {
+        producer.join();
+    }
+    EXPECT_TRUE(queue.empty());
+}
+
+} // namespace molecula
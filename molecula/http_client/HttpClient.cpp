@@ -1,14 +1,22 @@
 #include "molecula/http_client/HttpClient.hpp"
 
+#include "folly/coro/FutureUtil.h"
+
 #include <glog/logging.h>
 #include <algorithm>
 #include <cctype>
 #include <charconv>
+#include <cstring>
 
 namespace molecula {
 
 static const std::string_view kHeaderContentLength{"content-length"};
 
+folly::coro::Task<HttpResponse> HttpClient::co_makeRequest(HttpRequest request) {
+    // toTask raises cancellation of the task as an interrupt of the future.
+    co_return co_await folly::coro::toTask(makeRequest(std::move(request)).semi());
+}
+
 void lowerCaseHeader(std::string &header) {
     for (char &c : header) {
         if (c == ':') {
@@ -43,6 +51,24 @@ std::string_view getMethodName(HttpMethod method) {
     return "";
 }
 
+std::string_view getUrlHost(std::string_view url) {
+    size_t schemeEnd = url.find("://");
+    if (schemeEnd == std::string_view::npos) {
+        return {};
+    }
+    auto authority = url.substr(schemeEnd + 3);
+    authority = authority.substr(0, authority.find_first_of("/?#"));
+    size_t at = authority.rfind('@');
+    if (at != std::string_view::npos) {
+        authority = authority.substr(at + 1);
+    }
+    if (authority.starts_with('[')) {
+        // IPv6 literal
+        return authority.substr(0, authority.find(']') + 1);
+    }
+    return authority.substr(0, authority.find(':'));
+}
+
 void HttpHeaders::add(std::string header) {
     lowerCaseHeader(header);
     headers.push_back(std::move(header));
@@ -94,4 +120,113 @@ void HttpResponse::appendToBody(const char *data, size_t size) {
     body.append(data, size);
 }
 
+bool HttpResponse::appendToOutput(const char *data, size_t size) {
+    if (output.size() - outputSize < size) {
+        LOG(ERROR) << "HTTP response body exceeds output size " << output.size();
+        return false;
+    }
+    std::memcpy(output.data() + outputSize, data, size);
+    outputSize += size;
+    return true;
+}
+
+folly::Future<std::unique_ptr<folly::IOBuf>> HttpBodyStream::read() {
+    std::unique_lock<std::mutex> lock{mutex};
+    CHECK(!reader) << "Concurrent read from HTTP body stream";
+    if (!chunks.empty()) {
+        auto chunk = std::move(chunks.front());
+        chunks.pop_front();
+        bufferedBytes -= chunk->length();
+        if (paused && bufferedBytes <= maxBufferedBytes / 2) {
+            paused = false;
+            if (resumeCallback) {
+                resumeCallback();
+            }
+        }
+        return folly::makeFuture(std::move(chunk));
+    }
+    if (error) {
+        return folly::makeFuture<std::unique_ptr<folly::IOBuf>>(error);
+    }
+    if (done) {
+        return folly::makeFuture(std::unique_ptr<folly::IOBuf>{});
+    }
+    reader.emplace();
+    return reader->getFuture();
+}
+
+std::optional<folly::Promise<std::unique_ptr<folly::IOBuf>>> HttpBodyStream::takeReader() {
+    std::optional<folly::Promise<std::unique_ptr<folly::IOBuf>>> result;
+    result.swap(reader);
+    return result;
+}
+
+bool HttpBodyStream::push(const char *data, size_t size) {
+    std::optional<folly::Promise<std::unique_ptr<folly::IOBuf>>> promise;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        promise = takeReader();
+        if (!promise) {
+            // Always take at least one chunk, CURL chunk may be larger than the limit.
+            if (!chunks.empty() && bufferedBytes + size > maxBufferedBytes) {
+                paused = true;
+                return false;
+            }
+            chunks.push_back(folly::IOBuf::copyBuffer(data, size));
+            bufferedBytes += size;
+            return true;
+        }
+    }
+    // Consumer is waiting: hand the chunk over directly.
+    promise->setValue(folly::IOBuf::copyBuffer(data, size));
+    return true;
+}
+
+void HttpBodyStream::finish() {
+    std::optional<folly::Promise<std::unique_ptr<folly::IOBuf>>> promise;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        done = true;
+        resumeCallback = nullptr;
+        cancelCallback = nullptr;
+        promise = takeReader();
+    }
+    if (promise) {
+        promise->setValue(std::unique_ptr<folly::IOBuf>{});
+    }
+}
+
+void HttpBodyStream::fail(folly::exception_wrapper error) {
+    std::optional<folly::Promise<std::unique_ptr<folly::IOBuf>>> promise;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        done = true;
+        resumeCallback = nullptr;
+        cancelCallback = nullptr;
+        this->error = error;
+        promise = takeReader();
+    }
+    if (promise) {
+        promise->setException(std::move(error));
+    }
+}
+
+void HttpBodyStream::setResumeCallback(std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock{mutex};
+    resumeCallback = std::move(callback);
+}
+
+void HttpBodyStream::setCancelCallback(std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock{mutex};
+    cancelCallback = std::move(callback);
+}
+
+void HttpBodyStream::abandon() {
+    std::lock_guard<std::mutex> lock{mutex};
+    // Cleared when the transfer ends.
+    if (cancelCallback) {
+        cancelCallback();
+    }
+}
+
 } // namespace molecula
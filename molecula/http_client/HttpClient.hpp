@@ -1,11 +1,19 @@
 #pragma once
 
+#include "folly/Executor.h"
 #include "folly/Uri.h"
+#include "folly/coro/Task.h"
 #include "folly/futures/Future.h"
+#include "folly/io/IOBuf.h"
 
 #include "molecula/common/ByteBuffer.hpp"
 
+#include <chrono>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <span>
 #include <string>
 #include <string_view>
@@ -21,6 +29,27 @@ enum class HttpMethod {
     DELETE,
 };
 
+/// Transport level failure of a request. HTTP status is set if the headers arrived before the
+/// failure, the body is partial then.
+enum class HttpError {
+    None,
+    Timeout,
+    // Connect, DNS, TLS failure or connection reset
+    Connection,
+    Other,
+};
+
+/// Request class. When requests wait for an in-flight slot, higher priority (lower value) starts
+/// first: metadata and footers unblock query planning, prefetch is only speculative.
+enum class HttpPriority {
+    Metadata,
+    Footer,
+    Data,
+    Prefetch,
+};
+
+constexpr int kNumHttpPriorities = 4;
+
 class HttpHeaders {
 public:
     void add(std::string header);
@@ -46,36 +75,206 @@ class HttpRequest {
 public:
     std::string url;
     HttpMethod method{HttpMethod::GET};
+    HttpPriority priority{HttpPriority::Data};
     HttpHeaders headers;
-    ByteBuffer body;
+    // Sent as is, not copied: the data must stay valid until the request completes. Point it to
+    // @ownedBody if the request should own the data.
+    ByteSpan body;
+    ByteBuffer ownedBody;
+
+    // Optional destination of a successful (2xx) response body, e.g. a slice of a larger
+    // allocation. Must stay valid until the request completes. Larger body fails the transfer.
+    std::span<char> output;
+    // Optional pre-allocated buffer for the response body, becomes HttpResponse::body. With the
+    // exact capacity the body is copied once and never regrown.
+    ByteBuffer responseBody;
+
+    // Deadline for the whole request, zero for none.
+    std::chrono::milliseconds timeout{};
+    // Abort if the transfer is slower than @lowSpeedLimit bytes per second for @lowSpeedTime.
+    long lowSpeedLimit{};
+    std::chrono::seconds lowSpeedTime{};
 };
 
 class HttpResponse {
 public:
     long status{};
+    HttpError error{HttpError::None};
     HttpHeaders headers;
     ByteBuffer body;
+    // From the start of the transfer to the first response byte, zero if unknown.
+    std::chrono::microseconds firstByteLatency{};
+    // Request output and number of bytes written to it. Non-2xx body goes to @body instead.
+    std::span<char> output;
+    size_t outputSize{};
 
     void appendToBody(const char *data, size_t size);
+    // Returns false if the output is too small.
+    bool appendToOutput(const char *data, size_t size);
+};
+
+/// Response body delivered in chunks as it arrives. Has a single consumer calling @read. When
+/// more than @maxBufferedBytes are buffered and not read, the transfer is paused until the
+/// consumer catches up. Releasing the stream before the end of the body cancels the transfer.
+class HttpBodyStream {
+public:
+    explicit HttpBodyStream(size_t maxBufferedBytes) : maxBufferedBytes{maxBufferedBytes} {}
+
+    HttpBodyStream(const HttpBodyStream &) = delete;
+    HttpBodyStream &operator=(const HttpBodyStream &) = delete;
+
+    // Returns the next chunk, or null at the end of the body. Fails if the transfer failed.
+    // Call again only after the previous future completed.
+    folly::Future<std::unique_ptr<folly::IOBuf>> read();
+
+    // Producer side, called by the HTTP client.
+
+    // Returns false if the buffer is full. Chunk is not taken then, the transfer must pause and
+    // deliver it again after the resume callback is called.
+    bool push(const char *data, size_t size);
+    void finish();
+    void fail(folly::exception_wrapper error);
+    // Called (under the stream lock) when the consumer drained a paused stream.
+    void setResumeCallback(std::function<void()> callback);
+    // Called (under the stream lock) when the consumer abandons the stream before its end.
+    void setCancelCallback(std::function<void()> callback);
+    // Consumer released its last reference. A paused transfer would never resume otherwise.
+    void abandon();
+
+private:
+    // Returns promise to fulfill outside of the lock.
+    std::optional<folly::Promise<std::unique_ptr<folly::IOBuf>>> takeReader();
+
+    const size_t maxBufferedBytes{};
+    std::mutex mutex;
+    std::deque<std::unique_ptr<folly::IOBuf>> chunks;
+    size_t bufferedBytes{};
+    std::optional<folly::Promise<std::unique_ptr<folly::IOBuf>>> reader;
+    std::function<void()> resumeCallback;
+    std::function<void()> cancelCallback;
+    folly::exception_wrapper error;
+    bool paused{};
+    bool done{};
+};
+
+/// Response with the body streamed in chunks. Status and headers are complete.
+class HttpStreamResponse {
+public:
+    long status{};
+    HttpHeaders headers;
+    std::shared_ptr<HttpBodyStream> body;
+};
+
+/// Gauges and counters of one request priority.
+class HttpPriorityStats {
+public:
+    // Requests waiting for an in-flight slot and transfers running now.
+    long queued{};
+    long inFlight{};
+    // Requests started since the client creation and their total time in the queue.
+    long started{};
+    std::chrono::microseconds queueTime{};
 };
 
-/// Async HTTP client.
+/// HTTP client counters since the client creation.
+class HttpClientStats {
+public:
+    long requests{};
+    // Easy handles taken from the pool vs. created because the pool was empty.
+    long easyHandlesReused{};
+    long easyHandlesCreated{};
+    // Connections opened by transfers. Low number relative to requests means good reuse.
+    long newConnections{};
+    // Transfers that used HTTP/2.
+    long http2Transfers{};
+    HttpPriorityStats priorities[kNumHttpPriorities];
+    // Time event loops spent out of epoll_wait, and their lifetime, summed over the loops.
+    std::chrono::microseconds eventLoopBusyTime{};
+    std::chrono::microseconds eventLoopTime{};
+
+    double getPoolHitRate() const {
+        long total = easyHandlesReused + easyHandlesCreated;
+        return total == 0 ? 0.0 : static_cast<double>(easyHandlesReused) / total;
+    }
+
+    // Near one means the event loops are the bottleneck.
+    double getEventLoopUtilization() const {
+        return eventLoopTime.count() == 0
+                ? 0.0
+                : static_cast<double>(eventLoopBusyTime.count()) / eventLoopTime.count();
+    }
+};
+
+/// Async HTTP client. Cancelling a request future (folly::Future::cancel) aborts the transfer
+/// and fails the future with folly::FutureCancellation.
 class HttpClient {
 public:
     virtual ~HttpClient() = default;
     virtual folly::Future<HttpResponse> makeRequest(HttpRequest request) = 0;
+    // Completes when response headers are received. Body chunks are delivered as CURL receives
+    // them, with back pressure by pausing the transfer.
+    virtual folly::Future<HttpStreamResponse> makeStreamingRequest(HttpRequest request) = 0;
+    virtual HttpClientStats getStats() const = 0;
+
+    // Coroutine variant of makeRequest. Lazy: the request is sent when the task is awaited.
+    // Cancelling the awaiting task cancels the transfer.
+    folly::coro::Task<HttpResponse> co_makeRequest(HttpRequest request);
+};
+
+/// How HttpClientCurl picks an event loop for a new request.
+enum class HttpLoopBalancing {
+    // Loop with the least number of requests in flight.
+    LeastInFlight,
+    // Hash of the URL host. Keeps connections to one host on one loop, which helps reuse.
+    HostHash,
+};
+
+/// HTTP version HttpClientCurl asks for.
+enum class HttpVersion {
+    Http1,
+    // HTTP/2 over TLS, negotiated with ALPN. Plain http:// and servers without it use HTTP/1.1.
+    Http2,
+    // HTTP/2 without negotiation, also over plain http:// (h2c). Server must support it.
+    Http2PriorKnowledge,
 };
 
 /// HTTP client parameters.
 class HttpClientConfig {
 public:
     bool reserveContentLength{true};
+    // Each event loop has its own thread and CURL multi handle.
+    int numEventLoops{1};
+    HttpLoopBalancing loopBalancing{HttpLoopBalancing::LeastInFlight};
+    // Max number of idle easy handles kept for reuse by each event loop.
+    int maxPooledEasyHandles{256};
+    // Max body bytes buffered for a streaming response before the transfer is paused.
+    size_t maxStreamBufferedBytes{8 * 1024 * 1024};
+    // Max transfers running at once in each event loop, total and to a single host. Extra
+    // requests wait in priority order. Zero for no limit.
+    int maxInFlight{};
+    int maxInFlightPerHost{};
+    // With HTTP/2 concurrent transfers to a host are multiplexed as streams over few
+    // connections, saving TCP and TLS handshakes and file descriptors. Transfers wait for a
+    // connection to be confirmed as HTTP/2 rather than opening more.
+    HttpVersion httpVersion{HttpVersion::Http1};
+    // Max streams on one HTTP/2 connection. Transfers beyond it open another connection.
+    int maxConcurrentStreams{100};
+    // Max connections to one host per event loop. Extra transfers wait in CURL. Zero for no
+    // limit.
+    int maxHostConnections{};
+    // Runs continuations of request futures, so response decoding and whatever the caller chains
+    // never run on an event loop thread. Empty uses folly::getGlobalCPUExecutor().
+    folly::Executor::KeepAlive<> executor;
+    // Completes futures on the event loop thread instead. Only for trivial continuations.
+    bool inlineCompletions{false};
 };
 
 std::unique_ptr<HttpClient> createHttpClientCurl(const HttpClientConfig &config);
 std::string makeHeader(std::string_view name, std::string_view value);
 void lowerCaseHeader(std::string &header);
 std::string_view getMethodName(HttpMethod method);
+// Returns host part of the URL, without user info and port. Empty if URL has no host.
+std::string_view getUrlHost(std::string_view url);
 
 inline bool is1xx(long status) {
     return status >= 100 && status < 200;
@@ -3,49 +3,61 @@
 #include <glog/logging.h>
 
 #include <curl/curl.h>
-#include <unistd.h>
-#include <type_traits>
+#include <algorithm>
+#include <functional>
 
 namespace molecula {
 
-class HttpContext {
+std::unique_ptr<HttpClient> createHttpClientCurl(const HttpClientConfig &config) {
+    return HttpClientCurl::create(config);
+}
+
+// CURL share object with a lock per shared data kind. Event loops run on different threads.
+class HttpCurlShare {
 public:
-    explicit HttpContext(HttpRequest request) : request{std::move(request)} {}
+    HttpCurlShare() : handle{curl_share_init()} {
+        CHECK(handle) << "Failed to create CURL share";
+        curl_share_setopt(handle, CURLSHOPT_LOCKFUNC, &lock);
+        curl_share_setopt(handle, CURLSHOPT_UNLOCKFUNC, &unlock);
+        curl_share_setopt(handle, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(handle, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
 
-    long id{};
-    HttpRequest request;
-    curl_slist *headers{};
-    HttpResponse response;
-    folly::Promise<HttpResponse> promise;
-};
+    ~HttpCurlShare() {
+        curl_share_cleanup(handle);
+    }
 
-static_assert(std::is_move_constructible_v<HttpHeaders>);
-static_assert(std::is_move_constructible_v<HttpRequest>);
-static_assert(std::is_move_constructible_v<HttpResponse>);
-static_assert(std::is_move_constructible_v<HttpContext>);
+    CURLSH *get() const {
+        return handle;
+    }
 
-static size_t curlWriteCallback(char *buffer, size_t size, size_t nmemb, void *arg) {
-    size_t total = size * nmemb;
-    static_cast<HttpResponse *>(arg)->appendToBody(buffer, total);
-    // Must return number of bytes taken
-    return total;
-}
+private:
+    static void lock(CURL *, curl_lock_data data, curl_lock_access, void *arg) {
+        static_cast<HttpCurlShare *>(arg)->mutexes[data].lock();
+    }
 
-static size_t curlHeaderCallback(char *buffer, size_t size, size_t nmemb, void *arg) {
-    size_t total = size * nmemb;
-    static_cast<HttpResponse *>(arg)->headers.add(std::string{buffer, total});
-    // Must return number of bytes taken
-    return total;
-}
+    static void unlock(CURL *, curl_lock_data data, void *arg) {
+        static_cast<HttpCurlShare *>(arg)->mutexes[data].unlock();
+    }
 
-std::unique_ptr<HttpClient> createHttpClientCurl(const HttpClientConfig &config) {
-    return HttpClientCurl::create(config);
-}
+    CURLSH *handle{};
+    std::mutex mutexes[CURL_LOCK_DATA_LAST];
+};
 
 std::mutex HttpClientCurl::globalMutex;
 long HttpClientCurl::numClients{};
 
 std::unique_ptr<HttpClient> HttpClientCurl::create(const HttpClientConfig &config) {
+    CHECK(config.numEventLoops > 0) << "Invalid number of event loops: " << config.numEventLoops;
+    if (config.httpVersion != HttpVersion::Http1
+        && !(curl_version_info(CURLVERSION_NOW)->features & CURL_VERSION_HTTP2)) {
+        // Transfers would fail with CURLE_UNSUPPORTED_PROTOCOL.
+        LOG(WARNING) << "CURL is built without HTTP/2, using HTTP/1.1";
+        HttpClientConfig http1Config = config;
+        http1Config.httpVersion = HttpVersion::Http1;
+        return create(http1Config);
+    }
     {
         std::lock_guard<std::mutex> lock{globalMutex};
         if (numClients == 0) {
@@ -54,27 +66,36 @@ std::unique_ptr<HttpClient> HttpClientCurl::create(const HttpClientConfig &confi
         ++numClients;
     }
 
-    void *multiHandle = curl_multi_init();
-    if (!multiHandle) {
-        return nullptr;
+    std::vector<void *> multiHandles;
+    for (int i = 0; i < config.numEventLoops; i++) {
+        void *multiHandle = curl_multi_init();
+        if (!multiHandle) {
+            for (void *handle : multiHandles) {
+                curl_multi_cleanup(handle);
+            }
+            std::lock_guard<std::mutex> lock{globalMutex};
+            if (--numClients == 0) {
+                curl_global_cleanup();
+            }
+            return nullptr;
+        }
+        multiHandles.push_back(multiHandle);
     }
-    return std::make_unique<HttpClientCurl>(multiHandle, config);
+    return std::make_unique<HttpClientCurl>(std::move(multiHandles), config);
 }
 
-HttpClientCurl::HttpClientCurl(void *multiHandle, const HttpClientConfig &config) :
-    multiHandle{multiHandle}, eventThread{&HttpClientCurl::eventLoop, this}, config{config} {
-    ::pipe(pipe);
+HttpClientCurl::HttpClientCurl(std::vector<void *> multiHandles, const HttpClientConfig &config) :
+    share{std::make_unique<HttpCurlShare>()}, config{config} {
+    loops.reserve(multiHandles.size());
+    for (void *multiHandle : multiHandles) {
+        loops.push_back(std::make_unique<HttpEventLoop>(multiHandle, share->get(), config));
+    }
 }
 
 HttpClientCurl::~HttpClientCurl() {
-    running.store(false, std::memory_order_release);
-    ::write(pipe[1], "", 1);
-    if (eventThread.joinable()) {
-        eventThread.join();
-    }
-    curl_multi_cleanup(multiHandle);
-    ::close(pipe[0]);
-    ::close(pipe[1]);
+    // Stop and join all event loops before share and global cleanup.
+    loops.clear();
+    share.reset();
 
     {
         std::lock_guard<std::mutex> lock{globalMutex};
@@ -86,121 +107,37 @@ HttpClientCurl::~HttpClientCurl() {
 }
 
 folly::Future<HttpResponse> HttpClientCurl::makeRequest(HttpRequest request) {
-    auto *context = new HttpContext{std::move(request)};
-    // Take future before adding to the queue. Context will be deleted in the event loop. Thus,
-    // we need take future before adding to the queue (or under the lock).
-    auto future = context->promise.getFuture();
-    {
-        std::lock_guard<std::mutex> lock{mutex};
-        queue.emplace(context);
-    }
-    ::write(pipe[1], "", 1);
-    return future;
+    return selectLoop(request).submit(std::move(request));
 }
 
-void HttpClientCurl::eventLoop() {
-    char buf[16]{};
-
-    while (running.load(std::memory_order_acquire)) {
-        int stillRunning = 0;
-        while (curl_multi_perform(multiHandle, &stillRunning) == CURLM_CALL_MULTI_PERFORM) {
-            // Keep performing until no more actions are pending
-        }
-
-        // Handle completed transfers
-        CURLMsg *msg = nullptr;
-        int msgsLeft = 0;
-        while ((msg = curl_multi_info_read(multiHandle, &msgsLeft))) {
-            if (msg->msg == CURLMSG_DONE) {
-                void *easyHandle = msg->easy_handle;
-
-                HttpContext *context = nullptr;
-                curl_easy_getinfo(easyHandle, CURLINFO_PRIVATE, &context);
-                // LOG(INFO) << "HTTP request #" << context->id << ": Done";
-
-                long status = 0;
-                curl_easy_getinfo(easyHandle, CURLINFO_RESPONSE_CODE, &status);
-                context->response.status = status;
-
-                // Destroy easy handle and clean up
-                curl_multi_remove_handle(multiHandle, easyHandle);
-                curl_easy_cleanup(easyHandle);
-                if (context->headers) {
-                    curl_slist_free_all(context->headers);
-                    context->headers = nullptr;
-                }
-
-                context->promise.setValue(std::move(context->response));
-                delete context;
-            }
-        }
-
-        int numfds = 0;
-        curl_waitfd curl_fd{pipe[0], CURL_WAIT_POLLIN};
-        curl_multi_wait(multiHandle, &curl_fd, 1, 1000, &numfds);
-
-        // Add new requests from queue
-        HttpContext *context = nullptr;
-        while ((context = takeNextFromQueue())) {
-            // Every time we enqueue a new request, we write to the pipe. Read one byte back.
-            ::read(pipe[0], buf, 1);
-
-            curl_multi_add_handle(multiHandle, createEasyHandle(context));
-        }
-    }
+folly::Future<HttpStreamResponse> HttpClientCurl::makeStreamingRequest(HttpRequest request) {
+    return selectLoop(request).submitStreaming(std::move(request));
 }
 
-HttpContext *HttpClientCurl::takeNextFromQueue() {
-    std::unique_lock<std::mutex> lock(mutex);
-    if (queue.empty()) {
-        return nullptr;
-    } else {
-        auto *context = queue.front();
-        queue.pop();
-        return context;
+HttpClientStats HttpClientCurl::getStats() const {
+    HttpClientStats stats;
+    for (const auto &loop : loops) {
+        loop->addStats(stats);
     }
+    return stats;
 }
 
-void *HttpClientCurl::createEasyHandle(HttpContext *context) {
-    context->id = counter++;
-    // LOG(INFO) << "HTTP request #" << context->id << ": Create";
-
-    void *easyHandle = curl_easy_init();
-    curl_easy_setopt(easyHandle, CURLOPT_URL, context->request.url.c_str());
-    curl_easy_setopt(easyHandle, CURLOPT_PRIVATE, context);
-    curl_easy_setopt(easyHandle, CURLOPT_WRITEFUNCTION, &curlWriteCallback);
-    curl_easy_setopt(easyHandle, CURLOPT_WRITEDATA, &context->response);
-    curl_easy_setopt(easyHandle, CURLOPT_HEADERFUNCTION, &curlHeaderCallback);
-    curl_easy_setopt(easyHandle, CURLOPT_HEADERDATA, &context->response);
-    switch (context->request.method) {
-    case HttpMethod::GET:
-        // curl_easy_setopt(easyHandle, CURLOPT_HTTPGET, 1L);
-        break;
-    case HttpMethod::HEAD:
-        curl_easy_setopt(easyHandle, CURLOPT_NOBODY, 1L);
-        break;
-    case HttpMethod::POST:
-        curl_easy_setopt(easyHandle, CURLOPT_POST, 1L);
-        curl_easy_setopt(easyHandle, CURLOPT_POSTFIELDS, context->request.body.data());
-        curl_easy_setopt(easyHandle, CURLOPT_POSTFIELDSIZE, context->request.body.size());
-        break;
-    case HttpMethod::PUT:
-        curl_easy_setopt(easyHandle, CURLOPT_CUSTOMREQUEST, "PUT");
-        curl_easy_setopt(easyHandle, CURLOPT_POSTFIELDS, context->request.body.data());
-        curl_easy_setopt(easyHandle, CURLOPT_POSTFIELDSIZE, context->request.body.size());
-        break;
-    case HttpMethod::DELETE:
-        curl_easy_setopt(easyHandle, CURLOPT_CUSTOMREQUEST, "DELETE");
+HttpEventLoop &HttpClientCurl::selectLoop(const HttpRequest &request) const {
+    if (loops.size() == 1) {
+        return *loops[0];
+    }
+    switch (config.loopBalancing) {
+    case HttpLoopBalancing::LeastInFlight:
         break;
+    case HttpLoopBalancing::HostHash: {
+        size_t hash = std::hash<std::string_view>{}(getUrlHost(request.url));
+        return *loops[hash % loops.size()];
     }
-
-    // Add headers
-    for (const std::string &header : context->request.headers.span()) {
-        context->headers = curl_slist_append(context->headers, header.c_str());
     }
-    curl_easy_setopt(easyHandle, CURLOPT_HTTPHEADER, context->headers);
-
-    return easyHandle;
+    auto it = std::min_element(loops.begin(), loops.end(), [](const auto &a, const auto &b) {
+        return a->getInFlight() < b->getInFlight();
+    });
+    return **it;
 }
 
 } // namespace molecula
@@ -1,40 +1,37 @@
 #pragma once
 
 #include "molecula/http_client/HttpClient.hpp"
+#include "molecula/http_client/HttpEventLoop.hpp"
 
-#include <atomic>
+#include <memory>
 #include <mutex>
-#include <queue>
-#include <thread>
+#include <vector>
 
 namespace molecula {
 
-class HttpContext;
+class HttpCurlShare;
 
-/// Async HTTP client based on CURL.
+/// Async HTTP client based on CURL. Requests are spread over several event loops, each running
+/// its own thread.
 class HttpClientCurl final : public HttpClient {
 public:
     static std::unique_ptr<HttpClient> create(const HttpClientConfig &config);
 
-    HttpClientCurl(void *multiHandle, const HttpClientConfig &config);
+    HttpClientCurl(std::vector<void *> multiHandles, const HttpClientConfig &config);
     ~HttpClientCurl() override;
     folly::Future<HttpResponse> makeRequest(HttpRequest request) override;
+    folly::Future<HttpStreamResponse> makeStreamingRequest(HttpRequest request) override;
+    HttpClientStats getStats() const override;
 
 private:
-    void eventLoop();
-    HttpContext *takeNextFromQueue();
-    void *createEasyHandle(HttpContext *context);
+    HttpEventLoop &selectLoop(const HttpRequest &request) const;
 
     static std::mutex globalMutex;
     static long numClients;
 
-    void *multiHandle{};
-    std::mutex mutex;
-    long counter{1'000};
-    std::queue<HttpContext *> queue;
-    int pipe[2]{}; // Pipe for signaling
-    std::atomic<bool> running{true};
-    std::thread eventThread;
+    // DNS cache and TLS sessions shared by all event loops. Must outlive the loops.
+    std::unique_ptr<HttpCurlShare> share;
+    std::vector<std::unique_ptr<HttpEventLoop>> loops;
     HttpClientConfig config;
 };
 
@@ -0,0 +1,71 @@
+#include "folly/init/Init.h"
+#include "molecula/http_client/HttpClient.hpp"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// Measures aggregate download throughput depending on the number of event loops. Run against a
+// local server that serves a large file, e.g. test_data/http_server.sh and a file created with
+// "head -c 64M /dev/urandom > test_data/64m.bin".
+DEFINE_string(url, "http://localhost:8080/64m.bin", "URL to download");
+DEFINE_int32(concurrency, 64, "Number of requests in flight");
+DEFINE_int32(requests, 512, "Total number of requests per run");
+DEFINE_int32(max_loops, 8, "Max number of event loops to try (powers of 2)");
+DEFINE_bool(inline_completions, false, "Complete futures on the event loop threads");
+
+namespace molecula {
+
+static void runBenchmark(int numLoops) {
+    HttpClientConfig config;
+    config.numEventLoops = numLoops;
+    config.inlineCompletions = FLAGS_inline_completions;
+    auto client = createHttpClientCurl(config);
+    CHECK(client) << "Failed to create HTTP client";
+
+    size_t bytes = 0;
+    long failed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int sent = 0; sent < FLAGS_requests;) {
+        std::vector<folly::Future<HttpResponse>> futures;
+        for (int i = 0; i < FLAGS_concurrency && sent < FLAGS_requests; i++, sent++) {
+            HttpRequest request;
+            request.url = FLAGS_url;
+            futures.push_back(client->makeRequest(std::move(request)));
+        }
+        for (auto &future : futures) {
+            auto response = std::move(future).get();
+            if (is2xx(response.status)) {
+                bytes += response.body.size();
+            } else {
+                failed++;
+            }
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    auto stats = client->getStats();
+    std::printf(
+            "loops=%-3d requests=%-6d failed=%-4ld %8.3f GB/s  pool hit=%.2f connections=%ld "
+            "loop busy=%.2f\n",
+            numLoops,
+            FLAGS_requests,
+            failed,
+            bytes / elapsed.count() / 1e9,
+            stats.getPoolHitRate(),
+            stats.newConnections,
+            stats.getEventLoopUtilization());
+}
+
+} // namespace molecula
+
+int main(int argc, char **argv) {
+    folly::Init init(&argc, &argv);
+    for (int numLoops = 1; numLoops <= FLAGS_max_loops; numLoops *= 2) {
+        molecula::runBenchmark(numLoops);
+    }
+    return 0;
+}
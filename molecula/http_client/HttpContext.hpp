@@ -0,0 +1,48 @@
+#pragma once
+
+#include "molecula/http_client/HttpClient.hpp"
+
+#include <curl/curl.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace molecula {
+
+// State of a request inside HttpClientCurl.
+class HttpContext {
+public:
+    explicit HttpContext(HttpRequest request) : request{std::move(request)} {}
+
+    long id{};
+    HttpRequest request;
+    std::string host;
+    std::chrono::steady_clock::time_point queuedAt;
+    curl_slist *headers{};
+    void *easyHandle{};
+    HttpResponse response;
+    folly::Promise<HttpResponse> promise;
+    HttpContext *next{}; // Submission queue link
+
+    // Streaming response only. Response promise is fulfilled when body starts or transfer ends.
+    std::shared_ptr<HttpBodyStream> stream;
+    folly::Promise<HttpStreamResponse> streamPromise;
+    bool headersDelivered{};
+    // Context is in the queue to resume the paused transfer. Deleted when taken from the queue.
+    std::atomic<bool> resumeQueued{};
+    bool completed{};
+    bool cancelled{};
+
+    void deliverHeaders();
+};
+
+// Request to abort a transfer, queued by the future interrupt handler.
+class HttpCancel {
+public:
+    long id{};
+    HttpCancel *next{};
+};
+
+} // namespace molecula
@@ -0,0 +1,603 @@
+#include "molecula/http_client/HttpEventLoop.hpp"
+
+#include "folly/executors/GlobalExecutor.h"
+
+#include <glog/logging.h>
+
+#include <curl/curl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+namespace molecula {
+
+static_assert(std::is_move_constructible_v<HttpHeaders>);
+static_assert(std::is_move_constructible_v<HttpRequest>);
+static_assert(std::is_move_constructible_v<HttpResponse>);
+
+static size_t curlWriteCallback(char *buffer, size_t size, size_t nmemb, void *arg) {
+    size_t total = size * nmemb;
+    auto *context = static_cast<HttpContext *>(arg);
+    if (context->stream) {
+        context->deliverHeaders();
+        if (!context->stream->push(buffer, total)) {
+            // CURL keeps the data and delivers it again after unpause.
+            return CURL_WRITEFUNC_PAUSE;
+        }
+    } else if (context->response.output.empty()) {
+        context->response.appendToBody(buffer, total);
+    } else {
+        if (context->response.status == 0) {
+            curl_easy_getinfo(
+                    context->easyHandle, CURLINFO_RESPONSE_CODE, &context->response.status);
+        }
+        if (!is2xx(context->response.status)) {
+            // Keep error document out of the caller's buffer.
+            context->response.appendToBody(buffer, total);
+        } else if (!context->response.appendToOutput(buffer, total)) {
+            // Fails the transfer with CURLE_WRITE_ERROR.
+            return 0;
+        }
+    }
+    // Must return number of bytes taken
+    return total;
+}
+
+// CURL sends the body from the request memory, without copying.
+static void setBody(void *easyHandle, HttpContext *context) {
+    ByteSpan body = context->request.body;
+    // Null body makes CURL read stdin.
+    curl_easy_setopt(easyHandle, CURLOPT_POSTFIELDS, body.empty() ? "" : body.data());
+    curl_easy_setopt(easyHandle, CURLOPT_POSTFIELDSIZE_LARGE, curl_off_t(body.size()));
+    // No "Expect: 100-continue" round trip before large bodies.
+    context->headers = curl_slist_append(context->headers, "Expect:");
+}
+
+static size_t curlHeaderCallback(char *buffer, size_t size, size_t nmemb, void *arg) {
+    size_t total = size * nmemb;
+    // Lines end with CRLF, values are used as they are (e.g. ETag in If-Match).
+    size_t length = total;
+    while (length > 0 && (buffer[length - 1] == '\r' || buffer[length - 1] == '\n')) {
+        length--;
+    }
+    static_cast<HttpResponse *>(arg)->headers.add(std::string{buffer, length});
+    // Must return number of bytes taken
+    return total;
+}
+
+void HttpContext::deliverHeaders() {
+    if (headersDelivered) {
+        return;
+    }
+    headersDelivered = true;
+    HttpStreamResponse streamResponse;
+    curl_easy_getinfo(easyHandle, CURLINFO_RESPONSE_CODE, &streamResponse.status);
+    streamResponse.headers = std::move(response.headers);
+    // Consumer holds its own reference to the stream: releasing it before the body ends cancels
+    // the transfer, which may be paused waiting for reads that will never come.
+    streamResponse.body = std::shared_ptr<HttpBodyStream>{
+            stream.get(), [stream = stream](HttpBodyStream *) { stream->abandon(); }};
+    streamPromise.setValue(std::move(streamResponse));
+}
+
+HttpEventLoop::HttpEventLoop(void *multiHandle, void *shareHandle, const HttpClientConfig &config) :
+    multiHandle{multiHandle},
+    shareHandle{shareHandle},
+    config{config},
+    scheduler{config.maxInFlight, config.maxInFlightPerHost},
+    eventFd{::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)} {
+    easyHandlePool.reserve(config.maxPooledEasyHandles);
+    if (!config.inlineCompletions && !config.executor) {
+        this->config.executor = folly::getGlobalCPUExecutor();
+    }
+    PCHECK(eventFd >= 0) << "Failed to create eventfd";
+    epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    PCHECK(epollFd >= 0) << "Failed to create epoll";
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = eventFd;
+    ::epoll_ctl(epollFd, EPOLL_CTL_ADD, eventFd, &event);
+
+    // CURL tells which sockets to watch and when to call it on timeout.
+    curl_multi_setopt(multiHandle, CURLMOPT_SOCKETFUNCTION, &curlSocketCallback);
+    curl_multi_setopt(multiHandle, CURLMOPT_SOCKETDATA, this);
+    curl_multi_setopt(multiHandle, CURLMOPT_TIMERFUNCTION, &curlTimerCallback);
+    curl_multi_setopt(multiHandle, CURLMOPT_TIMERDATA, this);
+    if (config.httpVersion != HttpVersion::Http1) {
+        curl_multi_setopt(multiHandle, CURLMOPT_PIPELINING, long{CURLPIPE_MULTIPLEX});
+        curl_multi_setopt(
+                multiHandle, CURLMOPT_MAX_CONCURRENT_STREAMS, long{config.maxConcurrentStreams});
+    }
+    if (config.maxHostConnections > 0) {
+        curl_multi_setopt(
+                multiHandle, CURLMOPT_MAX_HOST_CONNECTIONS, long{config.maxHostConnections});
+    }
+    // Event fd must exist before the thread starts waiting on it.
+    eventThread = std::thread{&HttpEventLoop::run, this};
+}
+
+HttpEventLoop::~HttpEventLoop() {
+    running.store(false, std::memory_order_release);
+    wakeUp();
+    if (eventThread.joinable()) {
+        eventThread.join();
+    }
+    cancelAll();
+    for (void *easyHandle : easyHandlePool) {
+        curl_easy_cleanup(easyHandle);
+    }
+    curl_multi_cleanup(multiHandle);
+    ::close(epollFd);
+    ::close(eventFd);
+}
+
+void HttpEventLoop::addStats(HttpClientStats &stats) const {
+    stats.requests += numRequests.load(std::memory_order_relaxed);
+    stats.easyHandlesReused += easyHandlesReused.load(std::memory_order_relaxed);
+    stats.easyHandlesCreated += easyHandlesCreated.load(std::memory_order_relaxed);
+    stats.newConnections += newConnections.load(std::memory_order_relaxed);
+    stats.http2Transfers += http2Transfers.load(std::memory_order_relaxed);
+    stats.eventLoopBusyTime +=
+            std::chrono::microseconds{busyMicros.load(std::memory_order_relaxed)};
+    stats.eventLoopTime += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - startTime);
+    scheduler.addStats(stats);
+}
+
+void HttpEventLoop::wakeUp() {
+    uint64_t one = 1;
+    ::write(eventFd, &one, sizeof(one));
+}
+
+folly::Future<HttpResponse> HttpEventLoop::submit(HttpRequest request) {
+    auto *context = new HttpContext{std::move(request)};
+    context->id = counter.fetch_add(1, std::memory_order_relaxed);
+    context->response.body = std::move(context->request.responseBody);
+    context->response.output = context->request.output;
+    // Handler must not touch the context: it may run after the context is deleted.
+    context->promise.setInterruptHandler(
+            [this, id = context->id](const folly::exception_wrapper &) { cancel(id); });
+    // Take future before adding to the queue. Context will be deleted in the event loop. Thus,
+    // we need take future before adding to the queue.
+    auto future = context->promise.getFuture();
+    enqueue(context);
+    return completeOnExecutor(std::move(future));
+}
+
+folly::Future<HttpStreamResponse> HttpEventLoop::submitStreaming(HttpRequest request) {
+    auto *context = new HttpContext{std::move(request)};
+    context->id = counter.fetch_add(1, std::memory_order_relaxed);
+    context->stream = std::make_shared<HttpBodyStream>(config.maxStreamBufferedBytes);
+    context->stream->setResumeCallback([this, context] { resume(context); });
+    context->stream->setCancelCallback([this, id = context->id] { cancel(id); });
+    context->streamPromise.setInterruptHandler(
+            [this, id = context->id](const folly::exception_wrapper &) { cancel(id); });
+    auto future = context->streamPromise.getFuture();
+    enqueue(context);
+    return completeOnExecutor(std::move(future));
+}
+
+template <typename T>
+folly::Future<T> HttpEventLoop::completeOnExecutor(folly::Future<T> future) const {
+    if (config.inlineCompletions) {
+        return future;
+    }
+    // Promise is still fulfilled on the event loop, callbacks are scheduled on the executor.
+    // Interrupts reach the promise through the shared core, so cancel still works.
+    return std::move(future).via(config.executor);
+}
+
+void HttpEventLoop::cancel(long id) {
+    if (cancelQueue.push(new HttpCancel{id})) {
+        wakeUp();
+    }
+}
+
+void HttpEventLoop::enqueue(HttpContext *context) {
+    inFlight.fetch_add(1, std::memory_order_relaxed);
+    // Event loop drains the whole queue on wake up. Signal only if the queue was empty, otherwise
+    // wake up is already pending.
+    if (queue.push(context)) {
+        wakeUp();
+    }
+}
+
+void HttpEventLoop::resume(HttpContext *context) {
+    // Runs under the stream lock, so the transfer can't complete and clear the callback
+    // concurrently. Once queued, the event loop owns deletion of a completed context.
+    context->resumeQueued.store(true, std::memory_order_release);
+    if (queue.push(context)) {
+        wakeUp();
+    }
+}
+
+void HttpEventLoop::run() {
+    constexpr int kMaxEvents = 256;
+    epoll_event events[kMaxEvents];
+
+    while (running.load(std::memory_order_acquire)) {
+        int numEvents = ::epoll_wait(epollFd, events, kMaxEvents, getTimeoutMs());
+        auto busyStart = std::chrono::steady_clock::now();
+        bool wakeUpEvent = false;
+        for (int i = 0; i < numEvents; i++) {
+            int fd = events[i].data.fd;
+            if (fd == eventFd) {
+                wakeUpEvent = true;
+                continue;
+            }
+            int flags = 0;
+            if (events[i].events & EPOLLIN) {
+                flags |= CURL_CSELECT_IN;
+            }
+            if (events[i].events & EPOLLOUT) {
+                flags |= CURL_CSELECT_OUT;
+            }
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                flags |= CURL_CSELECT_ERR;
+            }
+            int stillRunning = 0;
+            curl_multi_socket_action(multiHandle, fd, flags, &stillRunning);
+        }
+
+        if (timerDeadline && std::chrono::steady_clock::now() >= *timerDeadline) {
+            timerDeadline.reset();
+            int stillRunning = 0;
+            curl_multi_socket_action(multiHandle, CURL_SOCKET_TIMEOUT, 0, &stillRunning);
+        }
+
+        processCompleted();
+
+        if (wakeUpEvent) {
+            // New handles set the CURL timer to 0, they start on the next iteration.
+            addQueuedRequests();
+        } else if (scheduler.hasQueued()) {
+            // Completed transfers freed in-flight slots.
+            startRequests();
+        }
+        busyMicros.fetch_add(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - busyStart)
+                        .count(),
+                std::memory_order_relaxed);
+    }
+}
+
+void HttpEventLoop::processCompleted() {
+    CURLMsg *msg = nullptr;
+    int msgsLeft = 0;
+    while ((msg = curl_multi_info_read(multiHandle, &msgsLeft))) {
+        if (msg->msg == CURLMSG_DONE) {
+            HttpContext *context = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &context);
+            // LOG(INFO) << "HTTP request #" << context->id << ": Done";
+            complete(context, msg->data.result);
+        }
+    }
+}
+
+static HttpError getHttpError(CURLcode result) {
+    switch (result) {
+    case CURLE_OK:
+        return HttpError::None;
+    case CURLE_OPERATION_TIMEDOUT:
+        return HttpError::Timeout;
+    case CURLE_COULDNT_RESOLVE_HOST:
+    case CURLE_COULDNT_CONNECT:
+    case CURLE_SSL_CONNECT_ERROR:
+    case CURLE_SEND_ERROR:
+    case CURLE_RECV_ERROR:
+    case CURLE_GOT_NOTHING:
+    case CURLE_PARTIAL_FILE:
+        return HttpError::Connection;
+    default:
+        return HttpError::Other;
+    }
+}
+
+void HttpEventLoop::complete(HttpContext *context, CURLcode result) {
+    // Null if the request is cancelled while waiting in the scheduler.
+    void *easyHandle = context->easyHandle;
+    activeTransfers.erase(context->id);
+    context->response.error = getHttpError(result);
+
+    if (easyHandle) {
+        long status = 0;
+        curl_easy_getinfo(easyHandle, CURLINFO_RESPONSE_CODE, &status);
+        context->response.status = status;
+
+        curl_off_t firstByteMicros = 0;
+        curl_easy_getinfo(easyHandle, CURLINFO_STARTTRANSFER_TIME_T, &firstByteMicros);
+        context->response.firstByteLatency = std::chrono::microseconds{firstByteMicros};
+
+        long numConnects = 0;
+        curl_easy_getinfo(easyHandle, CURLINFO_NUM_CONNECTS, &numConnects);
+        newConnections.fetch_add(numConnects, std::memory_order_relaxed);
+
+        long httpVersion = 0;
+        curl_easy_getinfo(easyHandle, CURLINFO_HTTP_VERSION, &httpVersion);
+        if (httpVersion == CURL_HTTP_VERSION_2_0) {
+            http2Transfers.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (context->stream) {
+        if (context->cancelled && !context->headersDelivered) {
+            context->headersDelivered = true;
+            context->streamPromise.setException(folly::FutureCancellation{});
+        }
+        context->deliverHeaders();
+    }
+
+    // Return easy handle to the pool and clean up
+    if (easyHandle) {
+        curl_multi_remove_handle(multiHandle, easyHandle);
+        releaseEasyHandle(easyHandle);
+        context->easyHandle = nullptr;
+        scheduler.finish(context);
+    }
+    if (context->headers) {
+        curl_slist_free_all(context->headers);
+        context->headers = nullptr;
+    }
+
+    inFlight.fetch_sub(1, std::memory_order_relaxed);
+    if (context->stream) {
+        // Clears the resume callback: no resume can be queued after this point.
+        if (context->cancelled) {
+            context->stream->fail(folly::FutureCancellation{});
+        } else if (result == CURLE_OK) {
+            context->stream->finish();
+        } else {
+            context->stream->fail(std::runtime_error{curl_easy_strerror(result)});
+        }
+        if (context->resumeQueued.load(std::memory_order_acquire)) {
+            // Still linked in the queue, addQueuedRequests deletes it.
+            context->completed = true;
+            return;
+        }
+    } else if (context->cancelled) {
+        context->promise.setException(folly::FutureCancellation{});
+    } else {
+        if (result != CURLE_OK) {
+            LOG(WARNING) << "HTTP request #" << context->id << " failed: "
+                         << curl_easy_strerror(result);
+        }
+        context->promise.setValue(std::move(context->response));
+    }
+    delete context;
+}
+
+int HttpEventLoop::getTimeoutMs() const {
+    if (!timerDeadline) {
+        // Nothing to time out. Sockets and the event fd wake us up.
+        return -1;
+    }
+    auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+            *timerDeadline - std::chrono::steady_clock::now());
+    return static_cast<int>(std::max<long>(remaining.count(), 0));
+}
+
+int HttpEventLoop::curlSocketCallback(
+        CURL *easyHandle,
+        curl_socket_t fd,
+        int what,
+        void *arg,
+        void *socketArg) {
+    auto *loop = static_cast<HttpEventLoop *>(arg);
+    if (what == CURL_POLL_REMOVE) {
+        ::epoll_ctl(loop->epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        return 0;
+    }
+
+    epoll_event event{};
+    event.data.fd = fd;
+    if (what & CURL_POLL_IN) {
+        event.events |= EPOLLIN;
+    }
+    if (what & CURL_POLL_OUT) {
+        event.events |= EPOLLOUT;
+    }
+    // Socket pointer is set once the socket is registered in epoll.
+    if (socketArg) {
+        ::epoll_ctl(loop->epollFd, EPOLL_CTL_MOD, fd, &event);
+    } else {
+        ::epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, fd, &event);
+        curl_multi_assign(loop->multiHandle, fd, loop);
+    }
+    return 0;
+}
+
+int HttpEventLoop::curlTimerCallback(CURLM *multiHandle, long timeoutMs, void *arg) {
+    auto *loop = static_cast<HttpEventLoop *>(arg);
+    if (timeoutMs < 0) {
+        loop->timerDeadline.reset();
+    } else {
+        loop->timerDeadline = std::chrono::steady_clock::now()
+                + std::chrono::milliseconds{timeoutMs};
+    }
+    return 0;
+}
+
+void HttpEventLoop::addQueuedRequests() {
+    // Reset the event fd before draining: a producer that pushes after this point sees the queue
+    // empty (or not yet drained) and its request is picked up now or on the next wake up.
+    uint64_t value = 0;
+    ::read(eventFd, &value, sizeof(value));
+
+    // Take cancels before requests: a cancel is queued after its request, so the request is
+    // already added when the cancel is applied.
+    HttpCancel *cancels = cancelQueue.popAll();
+
+    HttpContext *context = queue.popAll();
+    while (context) {
+        // Easy handle references the context, unlink it first.
+        HttpContext *next = context->next;
+        context->next = nullptr;
+        if (context->resumeQueued.exchange(false, std::memory_order_acq_rel)) {
+            if (context->completed) {
+                delete context;
+            } else {
+                curl_easy_pause(context->easyHandle, CURLPAUSE_CONT);
+            }
+        } else {
+            context->host = getUrlHost(context->request.url);
+            activeTransfers.emplace(context->id, context);
+            scheduler.add(context);
+        }
+        context = next;
+    }
+
+    // Cancel before starting: a cancelled request doesn't take an in-flight slot.
+    cancelQueued(cancels);
+    startRequests();
+}
+
+void HttpEventLoop::startRequests() {
+    while (HttpContext *context = scheduler.next()) {
+        curl_multi_add_handle(multiHandle, createEasyHandle(context));
+    }
+}
+
+void HttpEventLoop::cancelQueued(HttpCancel *cancels) {
+    while (cancels) {
+        HttpCancel *next = cancels->next;
+        auto it = activeTransfers.find(cancels->id);
+        // Not found if the request already completed.
+        if (it != activeTransfers.end()) {
+            HttpContext *context = it->second;
+            if (!context->easyHandle) {
+                scheduler.remove(context);
+            }
+            context->cancelled = true;
+            complete(context, CURLE_ABORTED_BY_CALLBACK);
+        }
+        delete cancels;
+        cancels = next;
+    }
+}
+
+void HttpEventLoop::cancelAll() {
+    HttpCancel *cancels = cancelQueue.popAll();
+    while (cancels) {
+        HttpCancel *next = cancels->next;
+        delete cancels;
+        cancels = next;
+    }
+    HttpContext *context = queue.popAll();
+    while (context) {
+        HttpContext *next = context->next;
+        context->next = nullptr;
+        if (context->resumeQueued.exchange(false, std::memory_order_acq_rel)) {
+            // Not completed yet: still in active transfers and cancelled below.
+            if (context->completed) {
+                delete context;
+            }
+        } else {
+            activeTransfers.emplace(context->id, context);
+        }
+        context = next;
+    }
+    // Fail the futures, otherwise their callers wait forever and the contexts leak.
+    while (!activeTransfers.empty()) {
+        context = activeTransfers.begin()->second;
+        if (!context->easyHandle) {
+            scheduler.remove(context);
+        }
+        context->cancelled = true;
+        complete(context, CURLE_ABORTED_BY_CALLBACK);
+    }
+}
+
+void *HttpEventLoop::createEasyHandle(HttpContext *context) {
+    // LOG(INFO) << "HTTP request #" << context->id << ": Create";
+    numRequests.fetch_add(1, std::memory_order_relaxed);
+
+    void *easyHandle = takeEasyHandle();
+    context->easyHandle = easyHandle;
+    curl_easy_setopt(easyHandle, CURLOPT_URL, context->request.url.c_str());
+    curl_easy_setopt(easyHandle, CURLOPT_PRIVATE, context);
+    curl_easy_setopt(easyHandle, CURLOPT_WRITEFUNCTION, &curlWriteCallback);
+    curl_easy_setopt(easyHandle, CURLOPT_WRITEDATA, context);
+    curl_easy_setopt(easyHandle, CURLOPT_HEADERFUNCTION, &curlHeaderCallback);
+    curl_easy_setopt(easyHandle, CURLOPT_HEADERDATA, &context->response);
+    if (context->request.timeout.count() > 0) {
+        curl_easy_setopt(easyHandle, CURLOPT_TIMEOUT_MS, long{context->request.timeout.count()});
+    }
+    if (context->request.lowSpeedLimit > 0) {
+        curl_easy_setopt(easyHandle, CURLOPT_LOW_SPEED_LIMIT, context->request.lowSpeedLimit);
+        curl_easy_setopt(
+                easyHandle, CURLOPT_LOW_SPEED_TIME, long{context->request.lowSpeedTime.count()});
+    }
+    switch (config.httpVersion) {
+    case HttpVersion::Http1:
+        // CURL defaults to HTTP/2 over TLS when built with it.
+        curl_easy_setopt(easyHandle, CURLOPT_HTTP_VERSION, long{CURL_HTTP_VERSION_1_1});
+        break;
+    case HttpVersion::Http2:
+        curl_easy_setopt(easyHandle, CURLOPT_HTTP_VERSION, long{CURL_HTTP_VERSION_2TLS});
+        curl_easy_setopt(easyHandle, CURLOPT_PIPEWAIT, 1L);
+        break;
+    case HttpVersion::Http2PriorKnowledge:
+        curl_easy_setopt(
+                easyHandle, CURLOPT_HTTP_VERSION, long{CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE});
+        curl_easy_setopt(easyHandle, CURLOPT_PIPEWAIT, 1L);
+        break;
+    }
+    switch (context->request.method) {
+    case HttpMethod::GET:
+        // curl_easy_setopt(easyHandle, CURLOPT_HTTPGET, 1L);
+        break;
+    case HttpMethod::HEAD:
+        curl_easy_setopt(easyHandle, CURLOPT_NOBODY, 1L);
+        break;
+    case HttpMethod::POST:
+        curl_easy_setopt(easyHandle, CURLOPT_POST, 1L);
+        setBody(easyHandle, context);
+        break;
+    case HttpMethod::PUT:
+        curl_easy_setopt(easyHandle, CURLOPT_CUSTOMREQUEST, "PUT");
+        setBody(easyHandle, context);
+        break;
+    case HttpMethod::DELETE:
+        curl_easy_setopt(easyHandle, CURLOPT_CUSTOMREQUEST, "DELETE");
+        break;
+    }
+
+    // Add headers
+    for (const std::string &header : context->request.headers.span()) {
+        context->headers = curl_slist_append(context->headers, header.c_str());
+    }
+    curl_easy_setopt(easyHandle, CURLOPT_HTTPHEADER, context->headers);
+
+    return easyHandle;
+}
+
+void *HttpEventLoop::takeEasyHandle() {
+    if (!easyHandlePool.empty()) {
+        void *easyHandle = easyHandlePool.back();
+        easyHandlePool.pop_back();
+        easyHandlesReused.fetch_add(1, std::memory_order_relaxed);
+        return easyHandle;
+    }
+    void *easyHandle = curl_easy_init();
+    curl_easy_setopt(easyHandle, CURLOPT_SHARE, shareHandle);
+    easyHandlesCreated.fetch_add(1, std::memory_order_relaxed);
+    return easyHandle;
+}
+
+void HttpEventLoop::releaseEasyHandle(void *easyHandle) {
+    if (easyHandlePool.size() < static_cast<size_t>(config.maxPooledEasyHandles)) {
+        // Reset clears options, but keeps connections, DNS and TLS session caches.
+        curl_easy_reset(easyHandle);
+        curl_easy_setopt(easyHandle, CURLOPT_SHARE, shareHandle);
+        easyHandlePool.push_back(easyHandle);
+    } else {
+        curl_easy_cleanup(easyHandle);
+    }
+}
+
+} // namespace molecula
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "molecula/common/MpscQueue.hpp"
+#include "molecula/http_client/HttpClient.hpp"
+#include "molecula/http_client/HttpContext.hpp"
+#include "molecula/http_client/HttpScheduler.hpp"
+
+#include <curl/curl.h>
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace molecula {
+
+// CURL multi handle driven by its own thread. HttpClientCurl spreads requests over several loops.
+// Loop waits in epoll on the sockets CURL asks for and calls curl_multi_socket_action only for
+// ready sockets, so a wake up costs O(ready sockets), not O(transfers).
+class HttpEventLoop {
+public:
+    HttpEventLoop(void *multiHandle, void *shareHandle, const HttpClientConfig &config);
+    ~HttpEventLoop();
+
+    HttpEventLoop(const HttpEventLoop &) = delete;
+    HttpEventLoop &operator=(const HttpEventLoop &) = delete;
+
+    folly::Future<HttpResponse> submit(HttpRequest request);
+    folly::Future<HttpStreamResponse> submitStreaming(HttpRequest request);
+
+    // Number of requests submitted and not completed yet.
+    long getInFlight() const {
+        return inFlight.load(std::memory_order_relaxed);
+    }
+
+    // Adds counters of this loop to @stats.
+    void addStats(HttpClientStats &stats) const;
+
+private:
+    static int curlSocketCallback(
+            CURL *easyHandle,
+            curl_socket_t fd,
+            int what,
+            void *arg,
+            void *socketArg);
+    static int curlTimerCallback(CURLM *multiHandle, long timeoutMs, void *arg);
+
+    // Moves continuations of @future off the event loop, unless completions are inline.
+    template <typename T>
+    folly::Future<T> completeOnExecutor(folly::Future<T> future) const;
+    void enqueue(HttpContext *context);
+    // Called by the future interrupt handler on any thread.
+    void cancel(long id);
+    void cancelQueued(HttpCancel *cancels);
+    // Called after the event loop stopped: cancels every queued and active request.
+    void cancelAll();
+    // Called by the stream consumer: schedules unpause of the transfer on the event loop.
+    void resume(HttpContext *context);
+    void run();
+    void processCompleted();
+    void complete(HttpContext *context, CURLcode result);
+    int getTimeoutMs() const;
+    void wakeUp();
+    void addQueuedRequests();
+    // Adds to the multi handle the requests the scheduler allows to start.
+    void startRequests();
+    void *createEasyHandle(HttpContext *context);
+    void *takeEasyHandle();
+    void releaseEasyHandle(void *easyHandle);
+
+    void *multiHandle{};
+    void *shareHandle{};
+    HttpClientConfig config;
+    // Idle easy handles. Reused handles keep their connection and TLS state. Event loop only.
+    std::vector<void *> easyHandlePool;
+    HttpScheduler scheduler;
+    std::atomic<long> counter{1'000};
+    MpscQueue<HttpContext, &HttpContext::next> queue;
+    MpscQueue<HttpCancel, &HttpCancel::next> cancelQueue;
+    // Requests taken from the queue and not completed, by id. Event loop only.
+    std::unordered_map<long, HttpContext *> activeTransfers;
+    int eventFd{-1}; // Signaled when the queue becomes non-empty
+    int epollFd{-1};
+    // When CURL wants to be called with CURL_SOCKET_TIMEOUT. Event loop only.
+    std::optional<std::chrono::steady_clock::time_point> timerDeadline;
+    std::atomic<long> inFlight{};
+    std::atomic<long> numRequests{};
+    std::atomic<long> easyHandlesReused{};
+    std::atomic<long> easyHandlesCreated{};
+    std::atomic<long> newConnections{};
+    std::atomic<long> http2Transfers{};
+    // Time spent handling events, between epoll waits.
+    std::atomic<long> busyMicros{};
+    const std::chrono::steady_clock::time_point startTime{std::chrono::steady_clock::now()};
+    std::atomic<bool> running{true};
+    std::thread eventThread;
+};
+
+} // namespace molecula
@@ -0,0 +1,102 @@
+#include "molecula/http_client/HttpScheduler.hpp"
+
+#include <glog/logging.h>
+#include <algorithm>
+
+namespace molecula {
+
+namespace {
+int getPriorityIndex(const HttpContext *context) {
+    return static_cast<int>(context->request.priority);
+}
+
+void addRelaxed(std::atomic<long> &counter, long value) {
+    // Single writer: load and store are enough.
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+} // namespace
+
+HttpScheduler::HttpScheduler(int maxInFlight, int maxInFlightPerHost) :
+    maxInFlight{maxInFlight}, maxInFlightPerHost{maxInFlightPerHost} {}
+
+void HttpScheduler::add(HttpContext *context) {
+    int priority = getPriorityIndex(context);
+    context->queuedAt = std::chrono::steady_clock::now();
+    hosts[context->host].pending[priority].push_back(context);
+    numQueued++;
+    addRelaxed(counters[priority].queued, 1);
+}
+
+HttpContext *HttpScheduler::next() {
+    if (numQueued == 0 || (maxInFlight > 0 && numInFlight >= maxInFlight)) {
+        return nullptr;
+    }
+    for (int priority = 0; priority < kNumHttpPriorities; priority++) {
+        HostQueue *best = nullptr;
+        for (auto &[host, queue] : hosts) {
+            if (queue.pending[priority].empty() || isHostFull(queue)) {
+                continue;
+            }
+            // Ids grow, lower id was submitted earlier
+            if (best == nullptr
+                || queue.pending[priority].front()->id < best->pending[priority].front()->id) {
+                best = &queue;
+            }
+        }
+        if (best == nullptr) {
+            continue;
+        }
+        HttpContext *context = best->pending[priority].front();
+        best->pending[priority].pop_front();
+        best->inFlight++;
+        numQueued--;
+        numInFlight++;
+        auto queueTime = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - context->queuedAt);
+        PriorityCounters &c = counters[priority];
+        addRelaxed(c.queued, -1);
+        addRelaxed(c.inFlight, 1);
+        addRelaxed(c.started, 1);
+        addRelaxed(c.queueMicros, queueTime.count());
+        return context;
+    }
+    return nullptr;
+}
+
+void HttpScheduler::finish(HttpContext *context) {
+    auto it = hosts.find(context->host);
+    CHECK(it != hosts.end());
+    it->second.inFlight--;
+    numInFlight--;
+    addRelaxed(counters[getPriorityIndex(context)].inFlight, -1);
+}
+
+bool HttpScheduler::remove(HttpContext *context) {
+    auto it = hosts.find(context->host);
+    if (it == hosts.end()) {
+        return false;
+    }
+    int priority = getPriorityIndex(context);
+    auto &pending = it->second.pending[priority];
+    auto pos = std::find(pending.begin(), pending.end(), context);
+    if (pos == pending.end()) {
+        return false;
+    }
+    pending.erase(pos);
+    numQueued--;
+    addRelaxed(counters[priority].queued, -1);
+    return true;
+}
+
+void HttpScheduler::addStats(HttpClientStats &stats) const {
+    for (int i = 0; i < kNumHttpPriorities; i++) {
+        const PriorityCounters &c = counters[i];
+        HttpPriorityStats &s = stats.priorities[i];
+        s.queued += c.queued.load(std::memory_order_relaxed);
+        s.inFlight += c.inFlight.load(std::memory_order_relaxed);
+        s.started += c.started.load(std::memory_order_relaxed);
+        s.queueTime += std::chrono::microseconds{c.queueMicros.load(std::memory_order_relaxed)};
+    }
+}
+
+} // namespace molecula
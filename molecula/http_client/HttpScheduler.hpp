@@ -0,0 +1,62 @@
+#pragma once
+
+#include "molecula/http_client/HttpClient.hpp"
+#include "molecula/http_client/HttpContext.hpp"
+
+#include <atomic>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+namespace molecula {
+
+// Queue of requests waiting to start, with the total and per host in-flight limits. Picks the
+// highest priority request of a host under its limit, oldest first within a priority. Used by
+// the event loop thread only, stats can be read by any thread.
+class HttpScheduler {
+public:
+    HttpScheduler(int maxInFlight, int maxInFlightPerHost);
+
+    HttpScheduler(const HttpScheduler &) = delete;
+    HttpScheduler &operator=(const HttpScheduler &) = delete;
+
+    void add(HttpContext *context);
+    // Returns the next request allowed to start and counts it in flight, or null.
+    HttpContext *next();
+    // Started request completed.
+    void finish(HttpContext *context);
+    // Removes a request that didn't start. Returns false if it's not queued.
+    bool remove(HttpContext *context);
+
+    bool hasQueued() const {
+        return numQueued > 0;
+    }
+
+    void addStats(HttpClientStats &stats) const;
+
+private:
+    struct HostQueue {
+        int inFlight{};
+        std::deque<HttpContext *> pending[kNumHttpPriorities];
+    };
+
+    struct PriorityCounters {
+        std::atomic<long> queued{};
+        std::atomic<long> inFlight{};
+        std::atomic<long> started{};
+        std::atomic<long> queueMicros{};
+    };
+
+    bool isHostFull(const HostQueue &queue) const {
+        return maxInFlightPerHost > 0 && queue.inFlight >= maxInFlightPerHost;
+    }
+
+    const int maxInFlight{};
+    const int maxInFlightPerHost{};
+    std::unordered_map<std::string, HostQueue> hosts;
+    long numQueued{};
+    long numInFlight{};
+    PriorityCounters counters[kNumHttpPriorities];
+};
+
+} // namespace molecula
@@ -0,0 +1,101 @@
+#include "molecula/http_client/HttpScheduler.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+namespace molecula {
+
+namespace {
+std::unique_ptr<HttpContext> createContext(long id, std::string host, HttpPriority priority) {
+    HttpRequest request;
+    request.priority = priority;
+    auto context = std::make_unique<HttpContext>(std::move(request));
+    context->id = id;
+    context->host = std::move(host);
+    return context;
+}
+} // namespace
+
+GTEST_TEST(HttpScheduler, Priority) {
+    HttpScheduler scheduler{1, 0};
+    auto prefetch = createContext(1, "a", HttpPriority::Prefetch);
+    auto data = createContext(2, "a", HttpPriority::Data);
+    auto metadata = createContext(3, "b", HttpPriority::Metadata);
+    scheduler.add(prefetch.get());
+    scheduler.add(data.get());
+    scheduler.add(metadata.get());
+
+    EXPECT_EQ(scheduler.next(), metadata.get());
+    // Total limit reached
+    EXPECT_EQ(scheduler.next(), nullptr);
+    scheduler.finish(metadata.get());
+    EXPECT_EQ(scheduler.next(), data.get());
+    scheduler.finish(data.get());
+    EXPECT_EQ(scheduler.next(), prefetch.get());
+    scheduler.finish(prefetch.get());
+    EXPECT_EQ(scheduler.next(), nullptr);
+    EXPECT_FALSE(scheduler.hasQueued());
+
+    HttpClientStats stats;
+    scheduler.addStats(stats);
+    EXPECT_EQ(stats.priorities[int(HttpPriority::Metadata)].started, 1);
+    EXPECT_EQ(stats.priorities[int(HttpPriority::Prefetch)].started, 1);
+    EXPECT_EQ(stats.priorities[int(HttpPriority::Data)].inFlight, 0);
+}
+
+GTEST_TEST(HttpScheduler, PerHostLimit) {
+    HttpScheduler scheduler{0, 1};
+    auto a1 = createContext(1, "a", HttpPriority::Data);
+    auto a2 = createContext(2, "a", HttpPriority::Data);
+    auto b1 = createContext(3, "b", HttpPriority::Prefetch);
+    scheduler.add(a1.get());
+    scheduler.add(a2.get());
+    scheduler.add(b1.get());
+
+    EXPECT_EQ(scheduler.next(), a1.get());
+    // Host "a" is full, lower priority request to "b" can start.
+    EXPECT_EQ(scheduler.next(), b1.get());
+    EXPECT_EQ(scheduler.next(), nullptr);
+
+    HttpClientStats stats;
+    scheduler.addStats(stats);
+    EXPECT_EQ(stats.priorities[int(HttpPriority::Data)].queued, 1);
+    EXPECT_EQ(stats.priorities[int(HttpPriority::Data)].inFlight, 1);
+
+    scheduler.finish(a1.get());
+    EXPECT_EQ(scheduler.next(), a2.get());
+}
+
+GTEST_TEST(HttpScheduler, FifoWithinPriority) {
+    HttpScheduler scheduler{0, 0};
+    std::vector<std::unique_ptr<HttpContext>> contexts;
+    contexts.push_back(createContext(1, "b", HttpPriority::Data));
+    contexts.push_back(createContext(2, "a", HttpPriority::Data));
+    contexts.push_back(createContext(3, "b", HttpPriority::Data));
+    for (auto &context : contexts) {
+        scheduler.add(context.get());
+    }
+    for (auto &context : contexts) {
+        EXPECT_EQ(scheduler.next(), context.get());
+    }
+}
+
+GTEST_TEST(HttpScheduler, Remove) {
+    HttpScheduler scheduler{1, 0};
+    auto first = createContext(1, "a", HttpPriority::Data);
+    auto second = createContext(2, "a", HttpPriority::Data);
+    scheduler.add(first.get());
+    scheduler.add(second.get());
+
+    EXPECT_EQ(scheduler.next(), first.get());
+    // Started request is not queued.
+    EXPECT_FALSE(scheduler.remove(first.get()));
+    EXPECT_TRUE(scheduler.remove(second.get()));
+    EXPECT_FALSE(scheduler.hasQueued());
+    scheduler.finish(first.get());
+    EXPECT_EQ(scheduler.next(), nullptr);
+}
+
+} // namespace molecula
@@ -11,6 +11,7 @@
 #include <glog/logging.h>
 
 #include <stdexcept>
+#include <utility>
 
 namespace velox = facebook::velox;
 
@@ -197,7 +198,11 @@ std::unique_ptr<Metadata> Metadata::fromJson(std::string_view data, size_t capac
 }
 
 Snapshot *Metadata::findCurrentSnapshot() {
-    for (auto &snapshot : snapshots) {
+    return const_cast<Snapshot *>(std::as_const(*this).findCurrentSnapshot());
+}
+
+const Snapshot *Metadata::findCurrentSnapshot() const {
+    for (const auto &snapshot : snapshots) {
         if (snapshot.id == currentSnapshotId) {
             return &snapshot;
         }
@@ -63,6 +63,14 @@ public:
     // Throws if error
     static std::unique_ptr<Manifest> fromAvro(std::string_view data);
 
+    ManifestContent getContent() const {
+        return content;
+    }
+
+    std::span<const ManifestEntry> getDataFiles() const {
+        return std::span{dataFiles};
+    }
+
 private:
     PropertyMap properties;
     ManifestContent content{};
@@ -107,6 +115,7 @@ public:
     }
 
     Snapshot *findCurrentSnapshot();
+    const Snapshot *findCurrentSnapshot() const;
 
 private:
     std::string uuid;
@@ -0,0 +1,200 @@
+#include "molecula/iceberg/IcebergMetadataCache.hpp"
+
+#include <glog/logging.h>
+
+#include <cctype>
+#include <stdexcept>
+#include <vector>
+
+namespace molecula::iceberg {
+
+namespace {
+// Pointer of a Hadoop table to its current metadata file, vN.metadata.json in its directory.
+constexpr std::string_view kVersionHint{"version-hint.text"};
+
+std::shared_ptr<const Metadata> parseMetadata(const std::string &uri, const S3GetObject &get) {
+    if (!is2xx(get.status)) {
+        throw std::runtime_error(
+                "Failed to load Iceberg metadata " + uri + ", status "
+                + std::to_string(get.status));
+    }
+    return Metadata::fromJson(get.data.view(), get.data.capacity());
+}
+
+// Metadata files are never rewritten, a new version gets a new file. Only the pointer of a
+// Hadoop table changes. A check without a validator can't be conditional: served by a cache
+// that drops validators, it would read and parse the file every time.
+bool isPolled(const std::string &uri, std::string_view etag, std::time_t lastModified) {
+    return uri.ends_with(kVersionHint) && (!etag.empty() || lastModified > 0);
+}
+
+std::string_view trimWhitespace(std::string_view text) {
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+} // namespace
+
+MetadataCache::MetadataCache(S3Client *client, const MetadataCacheConfig &config) :
+    client{client}, config{config} {
+    if (config.refreshInterval.count() > 0) {
+        refresher = std::thread{&MetadataCache::runRefresher, this};
+    }
+}
+
+MetadataCache::~MetadataCache() {
+    {
+        std::lock_guard lock{mutex};
+        stopping = true;
+    }
+    stopped.notify_all();
+    if (refresher.joinable()) {
+        refresher.join();
+    }
+}
+
+folly::Future<std::shared_ptr<const Metadata>> MetadataCache::get(std::string_view uri) {
+    std::string key{uri};
+    {
+        std::lock_guard lock{mutex};
+        if (auto it = tables.find(key); it != tables.end()) {
+            numHits++;
+            return folly::makeFuture(it->second->metadata);
+        }
+    }
+    numLoads++;
+    return load(key, nullptr).thenValue([this, key](std::shared_ptr<const Table> table) {
+        std::lock_guard lock{mutex};
+        // A concurrent load of the same table may have won, both are current.
+        tables.emplace(key, table);
+        return table->metadata;
+    });
+}
+
+folly::Future<folly::Unit> MetadataCache::refresh() {
+    std::vector<std::pair<std::string, std::shared_ptr<const Table>>> current;
+    {
+        std::lock_guard lock{mutex};
+        current.assign(tables.begin(), tables.end());
+    }
+    std::vector<folly::Future<folly::Unit>> checks;
+    checks.reserve(current.size());
+    for (auto &[uri, table] : current) {
+        if (!isPolled(uri, table->etag, table->lastModified)) {
+            continue;
+        }
+        auto finish = [this, uri = uri, previous = table](
+                              folly::Try<std::shared_ptr<const Table>> result) {
+            if (result.hasException()) {
+                numFailedRefreshes++;
+                LOG(WARNING) << "Failed to refresh Iceberg metadata " << uri << ": "
+                             << result.exception().what();
+                return;
+            }
+            std::shared_ptr<const Table> &table = result.value();
+            if (table == previous) {
+                numNotModified++;
+                return;
+            }
+            if (table->metadata != previous->metadata) {
+                numChanged++;
+            }
+            std::lock_guard lock{mutex};
+            tables[uri] = std::move(table);
+        };
+        checks.push_back(load(uri, table).thenTry(std::move(finish)));
+    }
+    return folly::collectAllUnsafe(checks).thenValue(
+            [](std::vector<folly::Try<folly::Unit>>) { return folly::Unit{}; });
+}
+
+MetadataCacheStats MetadataCache::getStats() const {
+    MetadataCacheStats stats;
+    stats.hits = numHits.load();
+    stats.loads = numLoads.load();
+    stats.notModified = numNotModified.load();
+    stats.changed = numChanged.load();
+    stats.failedRefreshes = numFailedRefreshes.load();
+    return stats;
+}
+
+folly::Future<std::shared_ptr<const MetadataCache::Table>> MetadataCache::load(
+        const std::string &uri,
+        std::shared_ptr<const Table> previous) {
+    S3Id id = S3Id::fromString(uri);
+    if (id.empty()) {
+        return folly::makeFuture<std::shared_ptr<const Table>>(
+                std::invalid_argument("Invalid Iceberg metadata URI: " + uri));
+    }
+    S3GetObjectRequest req{id.bucket(), id.key()};
+    if (previous && !previous->etag.empty()) {
+        req.ifNoneMatch = previous->etag;
+    } else if (previous) {
+        req.ifModifiedSince = previous->lastModified;
+    }
+    return client->getObject(req).thenValue(
+            [this, uri, id, previous = std::move(previous)](
+                    S3GetObject get) -> folly::Future<std::shared_ptr<const Table>> {
+                if (get.status == 304 && previous) {
+                    return folly::makeFuture(previous);
+                }
+                bool isPointer = id.key().ends_with(kVersionHint);
+                if (!isPointer) {
+                    auto table = std::make_shared<Table>();
+                    table->metadata = parseMetadata(uri, get);
+                    table->etag = std::move(get.etag);
+                    table->lastModified = get.lastModified;
+                    return folly::makeFuture(std::shared_ptr<const Table>{std::move(table)});
+                }
+                if (!is2xx(get.status)) {
+                    throw std::runtime_error(
+                            "Failed to load Iceberg version hint " + uri + ", status "
+                            + std::to_string(get.status));
+                }
+                auto table = std::make_shared<Table>();
+                table->etag = std::move(get.etag);
+                table->lastModified = get.lastModified;
+                if (!previous && !isPolled(uri, table->etag, table->lastModified)) {
+                    LOG(WARNING) << "No ETag or Last-Modified for " << uri
+                                 << ", the table is not refreshed";
+                }
+                std::string_view key = id.key();
+                table->metadataUri = std::string{id.schema()} + "://" + std::string{id.bucket()}
+                        + "/" + std::string{key.substr(0, key.size() - kVersionHint.size())}
+                        + "v" + std::string{trimWhitespace(get.data.view())} + ".metadata.json";
+                if (previous && previous->metadataUri == table->metadataUri) {
+                    // Pointer rewritten with the same version.
+                    table->metadata = previous->metadata;
+                    return folly::makeFuture(std::shared_ptr<const Table>{std::move(table)});
+                }
+                return loadMetadata(table->metadataUri)
+                        .thenValue([table](std::shared_ptr<const Metadata> metadata) {
+                            table->metadata = std::move(metadata);
+                            return std::shared_ptr<const Table>{table};
+                        });
+            });
+}
+
+folly::Future<std::shared_ptr<const Metadata>> MetadataCache::loadMetadata(
+        const std::string &uri) {
+    S3Id id = S3Id::fromString(uri);
+    S3GetObjectRequest req{id.bucket(), id.key()};
+    return client->getObject(req).thenValue([uri](S3GetObject get) {
+        return parseMetadata(uri, get);
+    });
+}
+
+void MetadataCache::runRefresher() {
+    std::unique_lock lock{mutex};
+    while (!stopped.wait_for(lock, config.refreshInterval, [this] { return stopping; })) {
+        lock.unlock();
+        refresh().get();
+        lock.lock();
+    }
+}
+
+} // namespace molecula::iceberg
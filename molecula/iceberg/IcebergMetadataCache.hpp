@@ -0,0 +1,90 @@
+#pragma once
+
+#include "folly/futures/Future.h"
+#include "molecula/iceberg/Iceberg.hpp"
+#include "molecula/s3/S3Client.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+namespace molecula::iceberg {
+
+class MetadataCacheConfig {
+public:
+    // Period of the background check of cached tables, zero disables it.
+    std::chrono::milliseconds refreshInterval{1'000};
+};
+
+class MetadataCacheStats {
+public:
+    long hits{};
+    long loads{};
+    // Checks answered 304 Not Modified, and checks that found a new version.
+    long notModified{};
+    long changed{};
+    long failedRefreshes{};
+};
+
+// Parsed table metadata for the query path, kept fresh in the background. A table is given by
+// the S3 URI of its metadata file, which never changes and is loaded once, or of the
+// version-hint.text pointer of a Hadoop table to follow its new versions. Each refresh checks
+// the pointers with a conditional GET (If-None-Match with the last ETag, or If-Modified-Since),
+// so an unchanged table costs a 304 and no parse. A pointer read without validators is not
+// refreshed. On a failed refresh the last metadata is kept. Thread safe.
+class MetadataCache {
+public:
+    MetadataCache(S3Client *client, const MetadataCacheConfig &config);
+    ~MetadataCache();
+
+    MetadataCache(const MetadataCache &) = delete;
+    MetadataCache &operator=(const MetadataCache &) = delete;
+
+    // Cached metadata, loaded by the first call for the table. Fails if the load fails.
+    folly::Future<std::shared_ptr<const Metadata>> get(std::string_view uri);
+    // Checks all cached tables once.
+    folly::Future<folly::Unit> refresh();
+
+    MetadataCacheStats getStats() const;
+
+private:
+    struct Table {
+        // Validators of the polled object
+        std::string etag;
+        std::time_t lastModified{};
+        // Metadata file the pointer refers to, empty if the object is the metadata file.
+        std::string metadataUri;
+        std::shared_ptr<const Metadata> metadata;
+    };
+
+    // Loads the table, or checks if it changed since @previous.
+    folly::Future<std::shared_ptr<const Table>> load(
+            const std::string &uri,
+            std::shared_ptr<const Table> previous);
+    folly::Future<std::shared_ptr<const Metadata>> loadMetadata(const std::string &uri);
+    void runRefresher();
+
+    S3Client *client{};
+    const MetadataCacheConfig config;
+
+    mutable std::mutex mutex;
+    std::condition_variable stopped;
+    bool stopping{};
+    std::unordered_map<std::string, std::shared_ptr<const Table>> tables;
+    std::thread refresher;
+
+    std::atomic<long> numHits{};
+    std::atomic<long> numLoads{};
+    std::atomic<long> numNotModified{};
+    std::atomic<long> numChanged{};
+    std::atomic<long> numFailedRefreshes{};
+};
+
+} // namespace molecula::iceberg
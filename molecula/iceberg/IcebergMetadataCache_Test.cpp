@@ -0,0 +1,138 @@
+#include "molecula/iceberg/IcebergMetadataCache.hpp"
+
+#include "molecula/s3/S3CachingClient.hpp"
+#include "molecula/s3/S3TestServer.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+namespace molecula::iceberg {
+
+namespace {
+std::string makeMetadataJson(std::string_view uuid) {
+    return R"({"format-version": 2, "table-uuid": ")" + std::string{uuid}
+            + R"(", "location": "s3://bucket/table", "current-snapshot-id": -1})";
+}
+
+// Metadata cache over an S3 client connected to a test server.
+class TestCache : public S3TestFixture {
+public:
+    explicit TestCache(std::chrono::milliseconds refreshInterval = {}) :
+        cache{std::make_unique<MetadataCache>(s3.get(), MetadataCacheConfig{refreshInterval})} {}
+
+    std::unique_ptr<MetadataCache> cache;
+};
+
+constexpr std::string_view kMetadataUri{"s3://bucket/table/metadata/v1.metadata.json"};
+constexpr std::string_view kHintUri{"s3://bucket/table/metadata/version-hint.text"};
+
+// Writes metadata version @version of the table and points the version hint to it.
+void putTable(S3TestServer &server, int version, std::string_view uuid) {
+    server.putObject(
+            "bucket",
+            "table/metadata/v" + std::to_string(version) + ".metadata.json",
+            makeMetadataJson(uuid));
+    server.putObject("bucket", "table/metadata/version-hint.text", std::to_string(version) + "\n");
+}
+} // namespace
+
+GTEST_TEST(IcebergMetadataCache, LoadOnce) {
+    TestCache test;
+    test.server.putObject("bucket", "table/metadata/v1.metadata.json", makeMetadataJson("a"));
+    auto metadata = test.cache->get(kMetadataUri).get();
+    EXPECT_EQ(metadata->getUuid(), "a");
+    EXPECT_EQ(test.cache->get(kMetadataUri).get(), metadata);
+    EXPECT_EQ(test.server.getStats().requests, 1);
+    EXPECT_EQ(test.cache->getStats().loads, 1);
+    EXPECT_EQ(test.cache->getStats().hits, 1);
+
+    EXPECT_THROW(test.cache->get("s3://bucket/missing.metadata.json").get(), std::runtime_error);
+}
+
+GTEST_TEST(IcebergMetadataCache, MetadataFileNotPolled) {
+    TestCache test;
+    test.server.putObject("bucket", "table/metadata/v1.metadata.json", makeMetadataJson("a"));
+    auto metadata = test.cache->get(kMetadataUri).get();
+    test.cache->refresh().get();
+    EXPECT_EQ(test.server.getStats().requests, 1);
+    EXPECT_EQ(test.cache->get(kMetadataUri).get(), metadata);
+}
+
+GTEST_TEST(IcebergMetadataCache, Refresh) {
+    TestCache test;
+    putTable(test.server, 1, "a");
+    auto metadata = test.cache->get(kHintUri).get();
+    EXPECT_EQ(metadata->getUuid(), "a");
+
+    test.cache->refresh().get();
+    EXPECT_EQ(test.cache->getStats().notModified, 1);
+    EXPECT_EQ(test.cache->get(kHintUri).get(), metadata);
+
+    // Pointer rewritten with the same version
+    test.server.putObject("bucket", "table/metadata/version-hint.text", "1");
+    test.cache->refresh().get();
+    EXPECT_EQ(test.cache->getStats().changed, 0);
+    EXPECT_EQ(test.cache->get(kHintUri).get(), metadata);
+
+    putTable(test.server, 2, "b");
+    test.cache->refresh().get();
+    EXPECT_EQ(test.cache->getStats().changed, 1);
+    EXPECT_EQ(test.cache->get(kHintUri).get()->getUuid(), "b");
+}
+
+GTEST_TEST(IcebergMetadataCache, FailedRefreshKeepsMetadata) {
+    TestCache test;
+    putTable(test.server, 1, "a");
+    auto metadata = test.cache->get(kHintUri).get();
+    test.server.failRequests(1, 500);
+    test.cache->refresh().get();
+    EXPECT_EQ(test.cache->getStats().failedRefreshes, 1);
+    EXPECT_EQ(test.cache->get(kHintUri).get(), metadata);
+}
+
+GTEST_TEST(IcebergMetadataCache, BackgroundRefresh) {
+    TestCache test{std::chrono::milliseconds{10}};
+    putTable(test.server, 1, "a");
+    EXPECT_EQ(test.cache->get(kHintUri).get()->getUuid(), "a");
+    putTable(test.server, 2, "b");
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+    while (test.cache->get(kHintUri).get()->getUuid() != "b"
+           && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds{5});
+    }
+    EXPECT_EQ(test.cache->get(kHintUri).get()->getUuid(), "b");
+    EXPECT_GE(test.cache->getStats().changed, 1);
+}
+
+// Metadata files are served by the block cache, which drops validators, the pointer is checked
+// in S3.
+GTEST_TEST(IcebergMetadataCache, CachingClient) {
+    TestCache test;
+    S3CachingClientConfig cacheConfig;
+    cacheConfig.cache.capacity = 1024 * 1024;
+    cacheConfig.cache.blockSize = 4 * 1024;
+    cacheConfig.isImmutable = [](std::string_view, std::string_view key) {
+        return !key.ends_with("version-hint.text");
+    };
+    S3CachingClient cachingClient{std::move(test.s3), cacheConfig};
+    MetadataCache cache{&cachingClient, MetadataCacheConfig{{}}};
+    putTable(test.server, 1, "a");
+    EXPECT_EQ(cache.get(kHintUri).get()->getUuid(), "a");
+    EXPECT_EQ(cache.get(kMetadataUri).get()->getUuid(), "a");
+    long requests = test.server.getStats().requests;
+
+    cache.refresh().get();
+    EXPECT_EQ(cache.getStats().notModified, 1);
+    EXPECT_EQ(cache.getStats().changed, 0);
+    // Only the conditional GET of the pointer
+    EXPECT_EQ(test.server.getStats().requests, requests + 1);
+
+    putTable(test.server, 2, "b");
+    cache.refresh().get();
+    EXPECT_EQ(cache.getStats().changed, 1);
+    EXPECT_EQ(cache.get(kHintUri).get()->getUuid(), "b");
+}
+
+} // namespace molecula::iceberg
@@ -0,0 +1,56 @@
+#include "molecula/iceberg/IcebergTableLoader.hpp"
+
+#include "folly/coro/Collect.h"
+#include "folly/coro/FutureUtil.h"
+
+#include <stdexcept>
+
+namespace molecula::iceberg {
+
+TableLoader::TableLoader(
+        S3Client *client,
+        MetadataCache *metadataCache,
+        const TableLoaderConfig &config) :
+    client{client}, metadataCache{metadataCache}, config{config} {}
+
+folly::coro::Task<LoadedTable> TableLoader::load(std::string metadataUri) {
+    LoadedTable table;
+    table.metadata = co_await folly::coro::toTask(metadataCache->get(metadataUri).semi());
+    const Snapshot *snapshot = table.metadata->findCurrentSnapshot();
+    if (!snapshot) {
+        co_return table;
+    }
+    S3GetObject manifestList = co_await readObject(snapshot->getManifestList());
+    table.manifestList = ManifestList::fromAvro(manifestList.data.view());
+
+    // Tasks are lazy, the window starts them. Paths live in the manifest list.
+    std::vector<folly::coro::Task<std::unique_ptr<Manifest>>> reads;
+    for (const ManifestListEntry &entry : table.manifestList->getManifests()) {
+        reads.push_back(readManifest(entry.manifestPath));
+    }
+    table.manifests = co_await folly::coro::collectAllWindowed(
+            std::move(reads), static_cast<size_t>(config.maxConcurrentReads));
+    co_return table;
+}
+
+folly::coro::Task<S3GetObject> TableLoader::readObject(std::string_view uri) {
+    S3Id id = S3Id::fromStringView(uri);
+    if (id.empty()) {
+        throw std::invalid_argument("Invalid Iceberg file URI: " + std::string{uri});
+    }
+    // Request refers to the bucket and key in @id, which stays in the frame until it completes.
+    S3GetObject get = co_await client->co_getObject(S3GetObjectRequest{id.bucket(), id.key()});
+    if (!is2xx(get.status)) {
+        throw std::runtime_error(
+                "Failed to read Iceberg file " + std::string{uri} + ", status "
+                + std::to_string(get.status));
+    }
+    co_return get;
+}
+
+folly::coro::Task<std::unique_ptr<Manifest>> TableLoader::readManifest(std::string_view uri) {
+    S3GetObject get = co_await readObject(uri);
+    co_return Manifest::fromAvro(get.data.view());
+}
+
+} // namespace molecula::iceberg
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "folly/coro/Task.h"
+#include "molecula/iceberg/Iceberg.hpp"
+#include "molecula/iceberg/IcebergMetadataCache.hpp"
+#include "molecula/s3/S3Client.hpp"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace molecula::iceberg {
+
+class TableLoaderConfig {
+public:
+    // Max manifest reads in flight for one table.
+    int maxConcurrentReads{64};
+};
+
+// Current snapshot of a table with its manifests.
+class LoadedTable {
+public:
+    std::shared_ptr<const Metadata> metadata;
+    // Null if the table has no snapshot yet.
+    std::unique_ptr<ManifestList> manifestList;
+    // In the manifest list order.
+    std::vector<std::unique_ptr<Manifest>> manifests;
+};
+
+// Loads the current snapshot of a table: metadata from the cache, then the manifest list, then
+// its manifests concurrently, at most maxConcurrentReads at once. Written with coroutines, so no
+// thread waits for the reads and Avro is parsed on the executor of the awaiting task.
+class TableLoader {
+public:
+    TableLoader(S3Client *client, MetadataCache *metadataCache, const TableLoaderConfig &config);
+
+    // Fails if any read fails. Reads still in flight are cancelled then.
+    folly::coro::Task<LoadedTable> load(std::string metadataUri);
+
+private:
+    // Whole object, fails on a non-2xx status.
+    folly::coro::Task<S3GetObject> readObject(std::string_view uri);
+    folly::coro::Task<std::unique_ptr<Manifest>> readManifest(std::string_view uri);
+
+    S3Client *client{};
+    MetadataCache *metadataCache{};
+    const TableLoaderConfig config;
+};
+
+} // namespace molecula::iceberg
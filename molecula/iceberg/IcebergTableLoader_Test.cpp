@@ -0,0 +1,175 @@
+#include "molecula/iceberg/IcebergTableLoader.hpp"
+
+#include "molecula/s3/S3TestServer.hpp"
+
+#include "folly/coro/BlockingWait.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace molecula::iceberg {
+
+namespace {
+// Table loader over an S3 client connected to a test server.
+class TestLoader : public S3TestFixture {
+public:
+    explicit TestLoader(
+            const S3TestServerConfig &serverConfig = {},
+            const TableLoaderConfig &loaderConfig = {}) :
+        S3TestFixture{serverConfig},
+        cache{std::make_unique<MetadataCache>(s3.get(), MetadataCacheConfig{{}})},
+        loader{std::make_unique<TableLoader>(s3.get(), cache.get(), loaderConfig)} {}
+
+    std::unique_ptr<MetadataCache> cache;
+    std::unique_ptr<TableLoader> loader;
+};
+
+constexpr std::string_view kMetadataUri{"s3://bucket/table/metadata/v1.metadata.json"};
+
+// Avro long: zigzag varint.
+void appendAvroLong(std::string &output, int64_t value) {
+    auto v = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    for (; v >= 0x80; v >>= 7) {
+        output.push_back(static_cast<char>(v | 0x80));
+    }
+    output.push_back(static_cast<char>(v));
+}
+
+void appendAvroString(std::string &output, std::string_view value) {
+    appendAvroLong(output, static_cast<int64_t>(value.size()));
+    output.append(value);
+}
+
+// Object container file with one uncompressed block.
+std::string makeAvroFile(std::string_view schema, int64_t numRecords, std::string_view records) {
+    std::string file{"Obj\x01"};
+    appendAvroLong(file, 2);
+    appendAvroString(file, "avro.schema");
+    appendAvroString(file, schema);
+    appendAvroString(file, "avro.codec");
+    appendAvroString(file, "null");
+    appendAvroLong(file, 0);
+    std::string sync(16, 'S');
+    file.append(sync);
+    appendAvroLong(file, numRecords);
+    appendAvroString(file, records);
+    file.append(sync);
+    return file;
+}
+
+std::string makeManifestList(const std::vector<std::string> &manifestPaths) {
+    std::string records;
+    for (size_t i = 0; i < manifestPaths.size(); i++) {
+        appendAvroString(records, manifestPaths[i]);
+        appendAvroLong(records, 1'000); // manifest_length
+        appendAvroLong(records, 0); // partition_spec_id
+        appendAvroLong(records, 0); // content: data
+        appendAvroLong(records, static_cast<int64_t>(i + 1)); // sequence_number
+        // min_sequence_number, added_snapshot_id, and the file and row counts
+        for (int j = 0; j < 8; j++) {
+            appendAvroLong(records, 0);
+        }
+        appendAvroLong(records, 1); // partitions: array
+        appendAvroLong(records, 0); // of no blocks
+        appendAvroLong(records, 0); // key_metadata: null
+    }
+    return makeAvroFile(
+            R"({"type": "record", "name": "manifest_file", "fields": []})",
+            static_cast<int64_t>(manifestPaths.size()),
+            records);
+}
+
+// Manifest of one data file.
+std::string makeManifest(std::string_view dataFilePath) {
+    std::string records;
+    appendAvroLong(records, 1); // status: added
+    appendAvroLong(records, 0); // snapshot_id: null
+    appendAvroLong(records, 1); // sequence_number
+    appendAvroLong(records, 1); // file_sequence_number
+    appendAvroLong(records, 0); // content: data
+    appendAvroString(records, dataFilePath);
+    appendAvroString(records, "PARQUET");
+    appendAvroLong(records, 100); // record_count
+    appendAvroLong(records, 10'000); // file_size_in_bytes
+    // Column stats, key_metadata, split_offsets, equality_ids and sort_order_id: null
+    for (int i = 0; i < 10; i++) {
+        appendAvroLong(records, 0);
+    }
+    return makeAvroFile(
+            R"({"type": "record", "name": "manifest_entry", "fields": []})", 1, records);
+}
+} // namespace
+
+GTEST_TEST(IcebergTableLoader, NoSnapshot) {
+    TestLoader test;
+    test.server.putObject(
+            "bucket",
+            "table/metadata/v1.metadata.json",
+            R"({"format-version": 2, "table-uuid": "a", "current-snapshot-id": -1})");
+    LoadedTable table = folly::coro::blockingWait(test.loader->load(std::string{kMetadataUri}));
+    EXPECT_EQ(table.metadata->getUuid(), "a");
+    EXPECT_FALSE(table.manifestList);
+    EXPECT_TRUE(table.manifests.empty());
+}
+
+GTEST_TEST(IcebergTableLoader, MissingManifestList) {
+    TestLoader test;
+    test.server.putObject(
+            "bucket",
+            "table/metadata/v1.metadata.json",
+            R"({"format-version": 2, "table-uuid": "a", "current-snapshot-id": 1, "snapshots": [)"
+            R"({"snapshot-id": 1, "manifest-list": "s3://bucket/table/metadata/snap-1.avro"}]})");
+    EXPECT_THROW(
+            folly::coro::blockingWait(test.loader->load(std::string{kMetadataUri})),
+            std::runtime_error);
+    EXPECT_THROW(
+            folly::coro::blockingWait(test.loader->load("s3://bucket/missing.metadata.json")),
+            std::runtime_error);
+}
+
+GTEST_TEST(IcebergTableLoader, Manifests) {
+    S3TestServerConfig serverConfig;
+    serverConfig.latency.median = std::chrono::milliseconds{20};
+    serverConfig.latency.p99 = std::chrono::milliseconds{20};
+    TableLoaderConfig loaderConfig;
+    loaderConfig.maxConcurrentReads = 2;
+    TestLoader test{serverConfig, loaderConfig};
+    test.server.putObject(
+            "bucket",
+            "table/metadata/v1.metadata.json",
+            R"({"format-version": 2, "table-uuid": "a", "current-snapshot-id": 1, "snapshots": [)"
+            R"({"snapshot-id": 1, "manifest-list": "s3://bucket/table/metadata/snap-1.avro"}]})");
+    // Listed in the reverse order of their keys.
+    std::vector<std::string> manifestPaths;
+    for (int i = 0; i < 6; i++) {
+        std::string key = "table/metadata/m" + std::to_string(5 - i) + ".avro";
+        test.server.putObject(
+                "bucket", key, makeManifest("s3://bucket/table/data/" + std::to_string(i)));
+        manifestPaths.push_back("s3://bucket/" + key);
+    }
+    test.server.putObject("bucket", "table/metadata/snap-1.avro", makeManifestList(manifestPaths));
+
+    auto start = std::chrono::steady_clock::now();
+    LoadedTable table = folly::coro::blockingWait(test.loader->load(std::string{kMetadataUri}));
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    ASSERT_TRUE(table.manifestList);
+    ASSERT_EQ(table.manifests.size(), 6);
+    for (int i = 0; i < 6; i++) {
+        EXPECT_EQ(table.manifestList->getManifests()[i].manifestPath, manifestPaths[i]);
+        ASSERT_EQ(table.manifests[i]->getDataFiles().size(), 1);
+        EXPECT_EQ(
+                table.manifests[i]->getDataFiles()[0].filePath,
+                "s3://bucket/table/data/" + std::to_string(i));
+    }
+    // Metadata and manifest list, then 6 manifests 2 at a time: one connection per read in
+    // flight, and 5 rounds of latency.
+    EXPECT_EQ(test.server.getStats().requests, 8);
+    EXPECT_LE(test.server.getStats().connections, 2);
+    EXPECT_GE(elapsed.count(), 0.1);
+}
+
+} // namespace molecula::iceberg
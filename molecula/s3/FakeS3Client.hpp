@@ -0,0 +1,162 @@
+#pragma once
+
+#include "molecula/s3/S3Client.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <stdexcept>
+#include <string>
+
+namespace molecula {
+
+// Test client serving GETs of one object from memory and counting them. Other requests fail.
+class FakeS3Client final : public S3Client {
+public:
+    explicit FakeS3Client(std::string data) : data{std::move(data)} {}
+
+    folly::Future<S3GetObject> getObject(const S3GetObjectRequest &req) override {
+        numGets++;
+        if (!deferGets) {
+            return folly::makeFuture(
+                    S3GetObject{makeResponse(req.range, req.hasRange(), req.output)});
+        }
+        auto &get = deferred.emplace_back();
+        get.range[0] = req.range[0];
+        get.range[1] = req.range[1];
+        get.hasRange = req.hasRange();
+        get.output = req.output;
+        return get.promise.getFuture();
+    }
+
+    // Completes the first deferred GET. Returns false if there is none.
+    bool completeGet() {
+        if (deferred.empty()) {
+            return false;
+        }
+        DeferredGet get = std::move(deferred.front());
+        deferred.pop_front();
+        get.promise.setValue(S3GetObject{makeResponse(get.range, get.hasRange, get.output)});
+        return true;
+    }
+
+    folly::Future<S3GetObjectInfo> getObjectInfo(const S3GetObjectInfoRequest &) override {
+        HttpResponse response;
+        response.status = 200;
+        response.headers.add(makeHeader("content-length", std::to_string(data.size())));
+        return folly::makeFuture(S3GetObjectInfo{std::move(response)});
+    }
+    folly::Future<S3GetObject> getObjectParallel(const S3GetObjectParallelRequest &) override {
+        return notImplemented<S3GetObject>();
+    }
+    folly::Future<S3GetRanges> getRanges(const S3GetRangesRequest &) override {
+        return notImplemented<S3GetRanges>();
+    }
+    folly::Future<S3GetObjectStream> getObjectStream(const S3GetObjectRequest &) override {
+        return notImplemented<S3GetObjectStream>();
+    }
+    folly::Future<S3ListObjects> listObjectsPage(const S3ListObjectsRequest &) override {
+        return notImplemented<S3ListObjects>();
+    }
+    folly::Future<S3ListObjectsResult> listObjects(
+            const S3ListObjectsRequest &,
+            S3ListObjectsCallback) override {
+        return notImplemented<S3ListObjectsResult>();
+    }
+    folly::Future<S3ListObjectsResult> listObjectsParallel(
+            const S3ListObjectsRequest &,
+            S3ListObjectsCallback) override {
+        return notImplemented<S3ListObjectsResult>();
+    }
+    folly::Future<S3PutObject> putObject(const S3PutObjectRequest &) override {
+        return notImplemented<S3PutObject>();
+    }
+    folly::Future<S3PutObject> uploadObject(const S3UploadObjectRequest &) override {
+        return notImplemented<S3PutObject>();
+    }
+    folly::Future<S3CreateMultipartUpload> createMultipartUpload(
+            const S3PutObjectRequest &) override {
+        return notImplemented<S3CreateMultipartUpload>();
+    }
+    folly::Future<S3PutObject> uploadPart(const S3UploadPartRequest &) override {
+        return notImplemented<S3PutObject>();
+    }
+    folly::Future<S3PutObject> completeMultipartUpload(
+            const S3CompleteMultipartUploadRequest &) override {
+        return notImplemented<S3PutObject>();
+    }
+    folly::Future<S3AbortMultipartUpload> abortMultipartUpload(
+            std::string_view,
+            std::string_view,
+            std::string_view) override {
+        return notImplemented<S3AbortMultipartUpload>();
+    }
+    folly::Future<S3DeleteObjects> deleteObjects(const S3DeleteObjectsRequest &) override {
+        return notImplemented<S3DeleteObjects>();
+    }
+    S3ClientStats getStats() const override {
+        return S3ClientStats{};
+    }
+
+    std::string data;
+    int numGets{};
+    // GETs wait for completeGet.
+    bool deferGets{};
+    // Next range GETs answered one byte short, with the full Content-Range.
+    int shortGets{};
+
+private:
+    struct DeferredGet {
+        long range[2]{};
+        bool hasRange{};
+        std::span<char> output;
+        folly::Promise<S3GetObject> promise;
+    };
+
+    HttpResponse makeResponse(const long (&range)[2], bool hasRange, std::span<char> output) {
+        HttpResponse response;
+        long size = static_cast<long>(data.size());
+        std::string_view body = data;
+        if (!hasRange) {
+            response.status = 200;
+        } else if (range[0] >= size) {
+            response.status = 416;
+            return response;
+        } else {
+            long end = std::min(range[1], size - 1);
+            response.status = 206;
+            body = body.substr(range[0], end - range[0] + 1);
+            if (shortGets > 0) {
+                shortGets--;
+                body.remove_suffix(1);
+            }
+            response.headers.add(makeHeader(
+                    "content-range",
+                    "bytes " + std::to_string(range[0]) + "-" + std::to_string(end) + "/"
+                            + std::to_string(size)));
+        }
+        if (output.empty()) {
+            response.body.append(body);
+        } else {
+            response.output = output;
+            response.appendToOutput(body.data(), body.size());
+        }
+        return response;
+    }
+
+    std::deque<DeferredGet> deferred;
+
+    template <typename T>
+    static folly::Future<T> notImplemented() {
+        return folly::makeFuture<T>(std::logic_error{"Not implemented"});
+    }
+};
+
+inline std::string makeData(size_t size) {
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; i++) {
+        data[i] = static_cast<char>('a' + i % 26);
+    }
+    return data;
+}
+
+} // namespace molecula
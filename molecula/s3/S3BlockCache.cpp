@@ -0,0 +1,154 @@
+#include "molecula/s3/S3BlockCache.hpp"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <functional>
+
+namespace molecula {
+
+S3BlockCache::S3BlockCache(const S3BlockCacheConfig &config) : config{config} {
+    CHECK(config.capacity > 0 && config.blockSize > 0 && config.numShards > 0);
+    shardCapacity = std::max(config.capacity / config.numShards, 1L);
+    maxProbationBytes = static_cast<long>(shardCapacity * config.probationRatio);
+    maxGhosts = static_cast<size_t>(
+            static_cast<double>(shardCapacity) / config.blockSize * config.ghostRatio);
+    shards.reserve(config.numShards);
+    for (int i = 0; i < config.numShards; i++) {
+        shards.push_back(std::make_unique<Shard>());
+    }
+}
+
+std::string S3BlockCache::getKey(std::string_view object, long block) {
+    // Block number follows the last '@', so keys of different objects don't collide.
+    std::string key;
+    key.reserve(object.size() + 21);
+    key.append(object).append("@").append(std::to_string(block));
+    return key;
+}
+
+S3BlockCache::Shard &S3BlockCache::getShard(std::string_view key) {
+    return *shards[std::hash<std::string_view>{}(key) % shards.size()];
+}
+
+S3BlockLookup S3BlockCache::lookup(const std::string &key) {
+    Shard &shard = getShard(key);
+    std::lock_guard lock{shard.mutex};
+    if (auto it = shard.entries.find(key); it != shard.entries.end()) {
+        numHits.fetch_add(1, std::memory_order_relaxed);
+        // Blocks in probation stay in place, so a burst of reads doesn't promote a block.
+        if (it->second->queue == Queue::Main) {
+            shard.main.splice(shard.main.begin(), shard.main, it->second);
+        }
+        return S3BlockLookup{folly::makeFuture(it->second->block), false};
+    }
+    if (auto it = shard.loading.find(key); it != shard.loading.end()) {
+        numJoins.fetch_add(1, std::memory_order_relaxed);
+        return S3BlockLookup{it->second->getFuture(), false};
+    }
+    numMisses.fetch_add(1, std::memory_order_relaxed);
+    auto promise = std::make_shared<folly::SharedPromise<S3CachedBlock>>();
+    shard.loading.emplace(key, promise);
+    return S3BlockLookup{promise->getFuture(), true};
+}
+
+void S3BlockCache::finishLoad(const std::string &key, S3CachedBlock block) {
+    Shard &shard = getShard(key);
+    std::shared_ptr<folly::SharedPromise<S3CachedBlock>> promise;
+    {
+        std::lock_guard lock{shard.mutex};
+        auto it = shard.loading.find(key);
+        CHECK(it != shard.loading.end()) << "Block is not loading: " << key;
+        promise = std::move(it->second);
+        shard.loading.erase(it);
+        if (block.status >= 200 && block.status < 300 && block.data) {
+            insert(shard, key, block);
+        }
+    }
+    // Waiters continue outside of the lock.
+    promise->setValue(std::move(block));
+}
+
+void S3BlockCache::failLoad(const std::string &key, folly::exception_wrapper error) {
+    Shard &shard = getShard(key);
+    std::shared_ptr<folly::SharedPromise<S3CachedBlock>> promise;
+    {
+        std::lock_guard lock{shard.mutex};
+        auto it = shard.loading.find(key);
+        CHECK(it != shard.loading.end()) << "Block is not loading: " << key;
+        promise = std::move(it->second);
+        shard.loading.erase(it);
+    }
+    promise->setException(std::move(error));
+}
+
+void S3BlockCache::insert(Shard &shard, const std::string &key, S3CachedBlock block) {
+    if (shard.entries.contains(key)) {
+        return;
+    }
+    long size = static_cast<long>(block.data->size());
+    std::list<Entry>::iterator it;
+    if (auto ghost = shard.ghostKeys.find(key); ghost != shard.ghostKeys.end()) {
+        // Read again after leaving probation: the block is hot.
+        auto ghostIt = ghost->second;
+        shard.ghostKeys.erase(ghost);
+        shard.ghosts.erase(ghostIt);
+        shard.main.push_front(Entry{key, std::move(block), Queue::Main});
+        it = shard.main.begin();
+    } else {
+        shard.probation.push_front(Entry{key, std::move(block), Queue::Probation});
+        it = shard.probation.begin();
+        shard.probationBytes += size;
+    }
+    shard.entries.emplace(it->key, it);
+    shard.bytes += size;
+    evict(shard);
+}
+
+void S3BlockCache::evict(Shard &shard) {
+    while (shard.bytes > shardCapacity) {
+        bool fromProbation = !shard.probation.empty()
+                && (shard.probationBytes > maxProbationBytes || shard.main.empty());
+        std::list<Entry> &queue = fromProbation ? shard.probation : shard.main;
+        if (queue.empty()) {
+            break;
+        }
+        Entry &victim = queue.back();
+        long size = static_cast<long>(victim.block.data->size());
+        shard.entries.erase(victim.key);
+        shard.bytes -= size;
+        if (fromProbation) {
+            shard.probationBytes -= size;
+            addGhost(shard, std::move(victim.key));
+        }
+        queue.pop_back();
+        numEvictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void S3BlockCache::addGhost(Shard &shard, std::string key) {
+    if (maxGhosts == 0) {
+        return;
+    }
+    shard.ghosts.push_back(std::move(key));
+    shard.ghostKeys.emplace(shard.ghosts.back(), std::prev(shard.ghosts.end()));
+    if (shard.ghosts.size() > maxGhosts) {
+        shard.ghostKeys.erase(shard.ghosts.front());
+        shard.ghosts.pop_front();
+    }
+}
+
+S3BlockCacheStats S3BlockCache::getStats() const {
+    S3BlockCacheStats stats;
+    stats.hits = numHits.load(std::memory_order_relaxed);
+    stats.misses = numMisses.load(std::memory_order_relaxed);
+    stats.joins = numJoins.load(std::memory_order_relaxed);
+    stats.evictions = numEvictions.load(std::memory_order_relaxed);
+    for (const auto &shard : shards) {
+        std::lock_guard lock{shard->mutex};
+        stats.numBlocks += static_cast<long>(shard->entries.size());
+        stats.bytes += shard->bytes;
+    }
+    return stats;
+}
+
+} // namespace molecula
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "folly/futures/Future.h"
+#include "folly/futures/SharedPromise.h"
+#include "molecula/common/ByteBuffer.hpp"
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace molecula {
+
+class S3BlockCacheConfig {
+public:
+    // Memory budget of cached block data.
+    long capacity{1024L * 1024 * 1024};
+    long blockSize{1024 * 1024};
+    // Each shard has its own lock and a share of the capacity.
+    int numShards{16};
+    // 2Q: share of the capacity for blocks read once, and ghost keys of blocks evicted from it
+    // as a share of the blocks fitting in the capacity.
+    double probationRatio{0.25};
+    double ghostRatio{0.5};
+};
+
+class S3BlockCacheStats {
+public:
+    long hits{};
+    long misses{};
+    // Misses waiting for a block already being loaded.
+    long joins{};
+    long evictions{};
+    long numBlocks{};
+    long bytes{};
+};
+
+// Block data, or the status of a failed load. Failed loads are not cached.
+class S3CachedBlock {
+public:
+    long status{};
+    // Size of the whole object the block belongs to.
+    long objectSize{};
+    std::shared_ptr<const ByteBuffer> data;
+};
+
+class S3BlockLookup {
+public:
+    // Ready on a hit.
+    folly::Future<S3CachedBlock> block;
+    // Miss with no load in progress: the caller loads the block and calls
+    // S3BlockCache::finishLoad.
+    bool load{};
+};
+
+// Sharded cache of fixed size object blocks with 2Q eviction: a block read once enters a FIFO
+// probation queue, and only a block read again after it left the queue (found in the ghost
+// keys) enters the main LRU queue. A scan of cold data cycles through the probation queue
+// without evicting the hot blocks. Concurrent misses of one block wait for a single load.
+// Thread safe.
+class S3BlockCache {
+public:
+    explicit S3BlockCache(const S3BlockCacheConfig &config);
+
+    S3BlockCache(const S3BlockCache &) = delete;
+    S3BlockCache &operator=(const S3BlockCache &) = delete;
+
+    const S3BlockCacheConfig &getConfig() const {
+        return config;
+    }
+
+    // @object identifies immutable data, e.g. the path or the path and ETag.
+    static std::string getKey(std::string_view object, long block);
+
+    S3BlockLookup lookup(const std::string &key);
+    // Completes a load started by @lookup. Caches the block if its status is 2xx.
+    void finishLoad(const std::string &key, S3CachedBlock block);
+    void failLoad(const std::string &key, folly::exception_wrapper error);
+
+    S3BlockCacheStats getStats() const;
+
+private:
+    enum class Queue { Probation, Main };
+
+    struct Entry {
+        std::string key;
+        S3CachedBlock block;
+        Queue queue{};
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<Entry> probation;
+        std::list<Entry> main;
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> entries;
+        // Keys evicted from probation, oldest first.
+        std::list<std::string> ghosts;
+        std::unordered_map<std::string_view, std::list<std::string>::iterator> ghostKeys;
+        std::unordered_map<std::string, std::shared_ptr<folly::SharedPromise<S3CachedBlock>>>
+                loading;
+        long probationBytes{};
+        long bytes{};
+    };
+
+    Shard &getShard(std::string_view key);
+    void insert(Shard &shard, const std::string &key, S3CachedBlock block);
+    void evict(Shard &shard);
+    void addGhost(Shard &shard, std::string key);
+
+    S3BlockCacheConfig config;
+    long shardCapacity{};
+    long maxProbationBytes{};
+    size_t maxGhosts{};
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<long> numHits{};
+    std::atomic<long> numMisses{};
+    std::atomic<long> numJoins{};
+    std::atomic<long> numEvictions{};
+};
+
+} // namespace molecula
@@ -0,0 +1,118 @@
+#include "molecula/s3/S3BlockCache.hpp"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+
+namespace molecula {
+
+namespace {
+S3CachedBlock makeBlock(long size) {
+    auto data = std::make_shared<ByteBuffer>(size);
+    data->append(std::string(size, 'x'));
+    return S3CachedBlock{200, size, std::move(data)};
+}
+
+// Reads a block, loading it on a miss. Returns true on a hit.
+bool read(S3BlockCache &cache, const std::string &key) {
+    S3BlockLookup lookup = cache.lookup(key);
+    if (lookup.load) {
+        cache.finishLoad(key, makeBlock(cache.getConfig().blockSize));
+    }
+    return !lookup.load;
+}
+} // namespace
+
+GTEST_TEST(S3BlockCache, getKey) {
+    EXPECT_EQ(S3BlockCache::getKey("bucket/a@1", 2), "bucket/a@1@2");
+}
+
+GTEST_TEST(S3BlockCache, Hit) {
+    S3BlockCache cache{S3BlockCacheConfig{}};
+    S3BlockLookup miss = cache.lookup("a@0");
+    ASSERT_TRUE(miss.load);
+    cache.finishLoad("a@0", makeBlock(100));
+    ASSERT_TRUE(miss.block.isReady());
+    EXPECT_EQ(std::move(miss.block).value().data->size(), 100);
+
+    S3BlockLookup hit = cache.lookup("a@0");
+    EXPECT_FALSE(hit.load);
+    ASSERT_TRUE(hit.block.isReady());
+    EXPECT_EQ(std::move(hit.block).value().objectSize, 100);
+
+    S3BlockCacheStats stats = cache.getStats();
+    EXPECT_EQ(stats.hits, 1);
+    EXPECT_EQ(stats.misses, 1);
+    EXPECT_EQ(stats.numBlocks, 1);
+    EXPECT_EQ(stats.bytes, 100);
+}
+
+GTEST_TEST(S3BlockCache, ConcurrentMisses) {
+    S3BlockCache cache{S3BlockCacheConfig{}};
+    S3BlockLookup first = cache.lookup("a@0");
+    S3BlockLookup second = cache.lookup("a@0");
+    EXPECT_TRUE(first.load);
+    EXPECT_FALSE(second.load);
+    EXPECT_FALSE(second.block.isReady());
+
+    cache.finishLoad("a@0", makeBlock(100));
+    ASSERT_TRUE(second.block.isReady());
+    EXPECT_EQ(std::move(first.block).value().data, std::move(second.block).value().data);
+    EXPECT_EQ(cache.getStats().joins, 1);
+}
+
+GTEST_TEST(S3BlockCache, FailedLoad) {
+    S3BlockCache cache{S3BlockCacheConfig{}};
+    S3BlockLookup first = cache.lookup("a@0");
+    S3BlockLookup second = cache.lookup("a@0");
+    EXPECT_TRUE(first.load);
+    cache.finishLoad("a@0", S3CachedBlock{503, -1, nullptr});
+    EXPECT_EQ(std::move(second.block).value().status, 503);
+    // Not cached
+    EXPECT_TRUE(cache.lookup("a@0").load);
+
+    S3BlockLookup waiter = cache.lookup("a@0");
+    cache.failLoad("a@0", folly::exception_wrapper{std::runtime_error{"reset"}});
+    EXPECT_THROW(std::move(waiter.block).value(), std::runtime_error);
+}
+
+GTEST_TEST(S3BlockCache, Capacity) {
+    S3BlockCacheConfig config;
+    config.capacity = 1000;
+    config.blockSize = 100;
+    config.numShards = 1;
+    S3BlockCache cache{config};
+    for (int i = 0; i < 25; i++) {
+        read(cache, S3BlockCache::getKey("a", i));
+    }
+    S3BlockCacheStats stats = cache.getStats();
+    EXPECT_EQ(stats.bytes, 1000);
+    EXPECT_EQ(stats.numBlocks, 10);
+    EXPECT_EQ(stats.evictions, 15);
+}
+
+GTEST_TEST(S3BlockCache, ScanResistance) {
+    S3BlockCacheConfig config;
+    config.capacity = 1000;
+    config.blockSize = 100;
+    config.numShards = 1;
+    S3BlockCache cache{config};
+    // Hot blocks are read once, pushed out of probation and read again.
+    read(cache, "hot@0");
+    read(cache, "hot@1");
+    for (int i = 0; i < 10; i++) {
+        read(cache, S3BlockCache::getKey("warm", i));
+    }
+    EXPECT_FALSE(read(cache, "hot@0"));
+    EXPECT_FALSE(read(cache, "hot@1"));
+
+    // A scan larger than the cache doesn't evict them.
+    for (int i = 0; i < 100; i++) {
+        EXPECT_FALSE(read(cache, S3BlockCache::getKey("scan", i)));
+    }
+    EXPECT_TRUE(read(cache, "hot@0"));
+    EXPECT_TRUE(read(cache, "hot@1"));
+}
+
+} // namespace molecula
@@ -0,0 +1,389 @@
+#include "molecula/s3/S3CachingClient.hpp"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace molecula {
+
+namespace {
+std::string getObjectName(std::string_view bucket, std::string_view key) {
+    std::string object;
+    object.reserve(bucket.size() + key.size() + 1);
+    object.append(bucket).append("/").append(key);
+    return object;
+}
+} // namespace
+
+S3CachingClient::S3CachingClient(
+        std::unique_ptr<S3Client> client,
+        const S3CachingClientConfig &config) :
+    client{std::move(client)},
+    config{config},
+    cache{config.cache},
+    blockSize{config.cache.blockSize} {
+    if (!config.disk.directory.empty()) {
+        CHECK_EQ(config.disk.blockSize, blockSize) << "Disk and memory cache block sizes differ";
+        diskCache = std::make_unique<S3DiskCache>(config.disk);
+    }
+}
+
+bool S3CachingClient::isCached(std::string_view bucket, std::string_view key) const {
+    return config.isImmutable && config.isImmutable(bucket, key);
+}
+
+folly::Future<S3GetObject> S3CachingClient::getObject(const S3GetObjectRequest &req) {
+    // Conditional GETs check the object in S3.
+    if (!isCached(req.bucket, req.key) || req.isConditional()) {
+        return client->getObject(req);
+    }
+    if (req.hasRange()) {
+        long begin = req.range[0];
+        long end = req.range[1];
+        std::vector<long> indexes;
+        for (long index = begin / blockSize; index <= end / blockSize; index++) {
+            indexes.push_back(index);
+        }
+        return getBlocks(req.bucket, req.key, std::move(indexes))
+                .thenValue([this, begin, end, output = req.output](
+                                   std::vector<S3CachedBlock> blocks) {
+                    return copyRange(blocks, begin, end, 206, output);
+                });
+    }
+    // Whole object: the first block tells the object size.
+    return getBlocks(req.bucket, req.key, {0}).thenValue(
+            [this,
+             bucket = std::string{req.bucket},
+             key = std::string{req.key},
+             output = req.output](std::vector<S3CachedBlock> blocks) -> folly::Future<S3GetObject> {
+                const S3CachedBlock &first = blocks.front();
+                if (first.status == 416 || (is2xx(first.status) && first.objectSize < 0)) {
+                    // Empty object has no block, or the size is unknown.
+                    S3GetObjectRequest get{bucket, key};
+                    get.output = output;
+                    return client->getObject(get);
+                }
+                long objectSize = first.objectSize;
+                if (!is2xx(first.status) || objectSize <= blockSize) {
+                    return copyRange(blocks, 0, objectSize - 1, 200, output);
+                }
+                std::vector<long> indexes;
+                for (long index = 1; index <= (objectSize - 1) / blockSize; index++) {
+                    indexes.push_back(index);
+                }
+                return getBlocks(bucket, key, std::move(indexes))
+                        .thenValue([this, first, objectSize, output](
+                                           std::vector<S3CachedBlock> rest) {
+                            rest.insert(rest.begin(), first);
+                            return copyRange(rest, 0, objectSize - 1, 200, output);
+                        });
+            });
+}
+
+folly::Future<S3GetRanges> S3CachingClient::getRanges(const S3GetRangesRequest &req) {
+    if (!isCached(req.bucket, req.key)) {
+        return client->getRanges(req);
+    }
+    std::vector<long> indexes;
+    for (const S3Range &range : req.ranges) {
+        for (long index = range.offset / blockSize;
+             range.size > 0 && index <= (range.offset + range.size - 1) / blockSize;
+             index++) {
+            indexes.push_back(index);
+        }
+    }
+    std::sort(indexes.begin(), indexes.end());
+    indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+
+    return getBlocks(req.bucket, req.key, indexes)
+            .thenValue([this, indexes, ranges = req.ranges](std::vector<S3CachedBlock> blocks) {
+                S3GetRanges result;
+                result.status = 200;
+                // Empty ranges keep empty views.
+                result.ranges.resize(ranges.size());
+                result.buffers.reserve(ranges.size());
+                for (size_t i = 0; i < ranges.size(); i++) {
+                    const S3Range &range = ranges[i];
+                    if (range.size <= 0) {
+                        continue;
+                    }
+                    ByteBuffer &buffer = result.buffers.emplace_back(range.size);
+                    long end = range.offset + range.size;
+                    for (long offset = range.offset; offset < end;) {
+                        auto it = std::lower_bound(
+                                indexes.begin(), indexes.end(), offset / blockSize);
+                        const S3CachedBlock &block = blocks[it - indexes.begin()];
+                        if (!is2xx(block.status)) {
+                            result.status = block.status;
+                            return result;
+                        }
+                        long inBlock = offset % blockSize;
+                        long size = std::min(end - offset, blockSize - inBlock);
+                        if (inBlock + size > static_cast<long>(block.data->size())) {
+                            LOG(ERROR) << "Range at " << range.offset << " size " << range.size
+                                       << " past the object end " << block.objectSize;
+                            result.status = 416;
+                            return result;
+                        }
+                        buffer.append(block.data->view().data() + inBlock, size);
+                        offset += size;
+                    }
+                    result.ranges[i] = buffer.view();
+                }
+                return result;
+            });
+}
+
+folly::Future<std::vector<S3CachedBlock>> S3CachingClient::getBlocks(
+        std::string_view bucket,
+        std::string_view key,
+        std::vector<long> indexes) {
+    std::string object = getObjectName(bucket, key);
+    std::vector<folly::Future<S3CachedBlock>> blocks;
+    blocks.reserve(indexes.size());
+    std::vector<long> missing;
+    for (long index : indexes) {
+        S3BlockLookup lookup = cache.lookup(S3BlockCache::getKey(object, index));
+        blocks.push_back(std::move(lookup.block));
+        if (lookup.load) {
+            missing.push_back(index);
+        }
+    }
+    if (!missing.empty()) {
+        loadMissing(bucket, key, std::move(missing));
+    }
+    return folly::collectAllUnsafe(blocks).thenValue(
+            [](std::vector<folly::Try<S3CachedBlock>> results) {
+                std::vector<S3CachedBlock> blocks;
+                blocks.reserve(results.size());
+                for (auto &result : results) {
+                    // Rethrows the first failure
+                    blocks.push_back(std::move(result.value()));
+                }
+                return blocks;
+            });
+}
+
+void S3CachingClient::loadMissing(
+        std::string_view bucket,
+        std::string_view key,
+        std::vector<long> missing) {
+    if (!diskCache) {
+        loadRuns(bucket, key, missing);
+        return;
+    }
+    std::string object = getObjectName(bucket, key);
+    std::vector<folly::Future<std::optional<S3CachedBlock>>> reads;
+    reads.reserve(missing.size());
+    for (long index : missing) {
+        reads.push_back(diskCache->get(S3BlockCache::getKey(object, index)));
+    }
+    folly::collectAllUnsafe(reads).thenValue(
+            [this,
+             bucket = std::string{bucket},
+             key = std::string{key},
+             object = std::move(object),
+             missing = std::move(missing)](
+                    std::vector<folly::Try<std::optional<S3CachedBlock>>> results) {
+                std::vector<long> remaining;
+                for (size_t i = 0; i < missing.size(); i++) {
+                    // Blocks written before sizes were checked may be short.
+                    if (results[i].hasValue() && results[i].value()
+                        && isComplete(missing[i], *results[i].value())) {
+                        cache.finishLoad(
+                                S3BlockCache::getKey(object, missing[i]),
+                                std::move(*results[i].value()));
+                    } else {
+                        remaining.push_back(missing[i]);
+                    }
+                }
+                loadRuns(bucket, key, remaining);
+            });
+}
+
+void S3CachingClient::loadRuns(
+        std::string_view bucket,
+        std::string_view key,
+        const std::vector<long> &missing) {
+    // Consecutive missing blocks are read together, up to the request size.
+    size_t maxBlocks = std::max(config.maxRequestSize / blockSize, 1L);
+    for (size_t i = 0; i < missing.size();) {
+        size_t j = i + 1;
+        while (j < missing.size() && missing[j] == missing[j - 1] + 1 && j - i < maxBlocks) {
+            j++;
+        }
+        loadBlocks(bucket, key, missing[i], missing[j - 1]);
+        i = j;
+    }
+}
+
+void S3CachingClient::loadBlocks(
+        std::string_view bucket,
+        std::string_view key,
+        long first,
+        long last) {
+    S3GetObjectRequest get{bucket, key};
+    get.setRange(first * blockSize, (last + 1) * blockSize - 1);
+    // Callers wait for the blocks in the cache.
+    client->getObject(get).thenTry([this, object = getObjectName(bucket, key), first, last](
+                                           folly::Try<S3GetObject> result) {
+        for (long index = first; index <= last; index++) {
+            std::string blockKey = S3BlockCache::getKey(object, index);
+            if (result.hasException()) {
+                cache.failLoad(blockKey, result.exception());
+                continue;
+            }
+            S3GetObject &get = result.value();
+            S3CachedBlock block{get.status, get.objectSize, nullptr};
+            long offset = (index - first) * blockSize;
+            if (is2xx(get.status)) {
+                long expectedSize = getBlockSize(index, get.objectSize);
+                long size = std::clamp<long>(
+                        static_cast<long>(get.data.size()) - offset, 0, blockSize);
+                if (expectedSize == 0) {
+                    // Past the object end
+                    block.status = 416;
+                } else if (size != expectedSize) {
+                    // Truncated response: not cached, the next read loads the block again.
+                    LOG(ERROR) << "Block " << blockKey << " size " << size << ", expected "
+                               << expectedSize;
+                    cache.failLoad(blockKey, std::runtime_error{"Incomplete S3 block " + blockKey});
+                    continue;
+                } else if (first == last && size == static_cast<long>(get.data.size())) {
+                    block.data = std::make_shared<const ByteBuffer>(std::move(get.data));
+                } else {
+                    auto data = std::make_shared<ByteBuffer>(size);
+                    data->append(get.data.view().data() + offset, size);
+                    block.data = std::move(data);
+                }
+            }
+            if (diskCache && block.data && isComplete(index, block)) {
+                diskCache->put(blockKey, block);
+            }
+            cache.finishLoad(blockKey, std::move(block));
+        }
+    });
+}
+
+long S3CachingClient::getBlockSize(long index, long objectSize) const {
+    if (objectSize < 0) {
+        return blockSize;
+    }
+    return std::clamp(objectSize - index * blockSize, 0L, blockSize);
+}
+
+bool S3CachingClient::isComplete(long index, const S3CachedBlock &block) const {
+    return block.data
+            && static_cast<long>(block.data->size()) == getBlockSize(index, block.objectSize);
+}
+
+folly::Future<S3GetObject> S3CachingClient::copyRange(
+        const std::vector<S3CachedBlock> &blocks,
+        long begin,
+        long end,
+        long status,
+        std::span<char> output) const {
+    HttpResponse response;
+    const S3CachedBlock &first = blocks.front();
+    if (!is2xx(first.status)) {
+        response.status = first.status;
+        return folly::makeFuture(S3GetObject{std::move(response)});
+    }
+    // Range past the end is cut like S3 does.
+    long objectSize = first.objectSize;
+    end = std::min(end, objectSize - 1);
+    response.status = status;
+    response.output = output;
+    if (output.empty()) {
+        response.body.reserve(std::max(end - begin + 1, 0L));
+    }
+    long firstIndex = begin / blockSize;
+    for (long offset = begin; offset <= end;) {
+        const S3CachedBlock &block = blocks[offset / blockSize - firstIndex];
+        if (!is2xx(block.status)) {
+            response.status = block.status;
+            return folly::makeFuture(S3GetObject{std::move(response)});
+        }
+        long inBlock = offset % blockSize;
+        long size = std::min(end + 1 - offset, blockSize - inBlock);
+        const char *data = block.data->view().data() + inBlock;
+        if (output.empty()) {
+            response.body.append(data, size);
+        } else if (!response.appendToOutput(data, size)) {
+            return folly::makeFuture<S3GetObject>(
+                    std::length_error("Object data exceeds the output size"));
+        }
+        offset += size;
+    }
+    S3GetObject result{std::move(response)};
+    result.objectSize = objectSize;
+    return folly::makeFuture(std::move(result));
+}
+
+folly::Future<S3GetObjectInfo> S3CachingClient::getObjectInfo(const S3GetObjectInfoRequest &req) {
+    return client->getObjectInfo(req);
+}
+
+folly::Future<S3GetObject> S3CachingClient::getObjectParallel(
+        const S3GetObjectParallelRequest &req) {
+    return client->getObjectParallel(req);
+}
+
+folly::Future<S3GetObjectStream> S3CachingClient::getObjectStream(const S3GetObjectRequest &req) {
+    return client->getObjectStream(req);
+}
+
+folly::Future<S3ListObjects> S3CachingClient::listObjectsPage(const S3ListObjectsRequest &req) {
+    return client->listObjectsPage(req);
+}
+
+folly::Future<S3ListObjectsResult> S3CachingClient::listObjects(
+        const S3ListObjectsRequest &req,
+        S3ListObjectsCallback onPage) {
+    return client->listObjects(req, std::move(onPage));
+}
+
+folly::Future<S3ListObjectsResult> S3CachingClient::listObjectsParallel(
+        const S3ListObjectsRequest &req,
+        S3ListObjectsCallback onPage) {
+    return client->listObjectsParallel(req, std::move(onPage));
+}
+
+folly::Future<S3PutObject> S3CachingClient::putObject(const S3PutObjectRequest &req) {
+    return client->putObject(req);
+}
+
+folly::Future<S3PutObject> S3CachingClient::uploadObject(const S3UploadObjectRequest &req) {
+    return client->uploadObject(req);
+}
+
+folly::Future<S3CreateMultipartUpload> S3CachingClient::createMultipartUpload(
+        const S3PutObjectRequest &req) {
+    return client->createMultipartUpload(req);
+}
+
+folly::Future<S3PutObject> S3CachingClient::uploadPart(const S3UploadPartRequest &req) {
+    return client->uploadPart(req);
+}
+
+folly::Future<S3PutObject> S3CachingClient::completeMultipartUpload(
+        const S3CompleteMultipartUploadRequest &req) {
+    return client->completeMultipartUpload(req);
+}
+
+folly::Future<S3AbortMultipartUpload> S3CachingClient::abortMultipartUpload(
+        std::string_view bucket,
+        std::string_view key,
+        std::string_view uploadId) {
+    return client->abortMultipartUpload(bucket, key, uploadId);
+}
+
+folly::Future<S3DeleteObjects> S3CachingClient::deleteObjects(const S3DeleteObjectsRequest &req) {
+    return client->deleteObjects(req);
+}
+
+S3ClientStats S3CachingClient::getStats() const {
+    return client->getStats();
+}
+
+} // namespace molecula
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "molecula/s3/S3BlockCache.hpp"
+#include "molecula/s3/S3Client.hpp"
+#include "molecula/s3/S3DiskCache.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace molecula {
+
+class S3CachingClientConfig {
+public:
+    S3BlockCacheConfig cache;
+    // Disk tier under the memory cache, enabled by a directory. Block sizes must be equal.
+    S3DiskCacheConfig disk;
+    // Missing consecutive blocks are read with one GET up to this size.
+    long maxRequestSize{8 * 1024 * 1024};
+    // Objects that never change under their path, e.g. Iceberg data and manifest files. Others
+    // bypass the cache: block keys carry no ETag, so a changed object would be served stale.
+    // Null bypasses the cache for all objects.
+    std::function<bool(std::string_view bucket, std::string_view key)> isImmutable;
+};
+
+// S3 client decorator serving GETs from a block cache. Reads are split into aligned blocks of
+// the cache block size; missing blocks are read from the disk cache if enabled, then from @client,
+// consecutive ones with a single GET. Concurrent reads of a missing block wait for one load, and
+// blocks read from S3 are written to the disk cache. Other requests pass through.
+class S3CachingClient final : public S3Client {
+public:
+    S3CachingClient(std::unique_ptr<S3Client> client, const S3CachingClientConfig &config);
+    ~S3CachingClient() override = default;
+
+    folly::Future<S3GetObjectInfo> getObjectInfo(const S3GetObjectInfoRequest &req) override;
+    folly::Future<S3GetObject> getObject(const S3GetObjectRequest &req) override;
+    folly::Future<S3GetObject> getObjectParallel(const S3GetObjectParallelRequest &req) override;
+    folly::Future<S3GetRanges> getRanges(const S3GetRangesRequest &req) override;
+    folly::Future<S3GetObjectStream> getObjectStream(const S3GetObjectRequest &req) override;
+    folly::Future<S3ListObjects> listObjectsPage(const S3ListObjectsRequest &req) override;
+    folly::Future<S3ListObjectsResult> listObjects(
+            const S3ListObjectsRequest &req,
+            S3ListObjectsCallback onPage) override;
+    folly::Future<S3ListObjectsResult> listObjectsParallel(
+            const S3ListObjectsRequest &req,
+            S3ListObjectsCallback onPage) override;
+    folly::Future<S3PutObject> putObject(const S3PutObjectRequest &req) override;
+    folly::Future<S3PutObject> uploadObject(const S3UploadObjectRequest &req) override;
+    folly::Future<S3CreateMultipartUpload> createMultipartUpload(
+            const S3PutObjectRequest &req) override;
+    folly::Future<S3PutObject> uploadPart(const S3UploadPartRequest &req) override;
+    folly::Future<S3PutObject> completeMultipartUpload(
+            const S3CompleteMultipartUploadRequest &req) override;
+    folly::Future<S3AbortMultipartUpload> abortMultipartUpload(
+            std::string_view bucket,
+            std::string_view key,
+            std::string_view uploadId) override;
+    folly::Future<S3DeleteObjects> deleteObjects(const S3DeleteObjectsRequest &req) override;
+    S3ClientStats getStats() const override;
+
+    S3BlockCacheStats getCacheStats() const {
+        return cache.getStats();
+    }
+
+    // Empty if the disk cache is disabled.
+    S3DiskCacheStats getDiskCacheStats() const {
+        return diskCache ? diskCache->getStats() : S3DiskCacheStats{};
+    }
+
+private:
+    bool isCached(std::string_view bucket, std::string_view key) const;
+    // Blocks with the given indexes, in the same order.
+    folly::Future<std::vector<S3CachedBlock>> getBlocks(
+            std::string_view bucket,
+            std::string_view key,
+            std::vector<long> indexes);
+    // Loads the @missing blocks from the disk cache, then the rest from S3.
+    void loadMissing(std::string_view bucket, std::string_view key, std::vector<long> missing);
+    // Reads consecutive runs of @missing blocks from S3.
+    void loadRuns(std::string_view bucket, std::string_view key, const std::vector<long> &missing);
+    // Reads blocks [@first, @last] with one GET and completes their loads.
+    void loadBlocks(std::string_view bucket, std::string_view key, long first, long last);
+    // Data size of block @index: full but the last block of the object, zero past its end.
+    // Blocks of an object of unknown (negative) size must be full.
+    long getBlockSize(long index, long objectSize) const;
+    // Whether @block has the data size of block @index.
+    bool isComplete(long index, const S3CachedBlock &block) const;
+    // Range [@begin, @end] of the object from consecutive @blocks starting at @begin.
+    folly::Future<S3GetObject> copyRange(
+            const std::vector<S3CachedBlock> &blocks,
+            long begin,
+            long end,
+            long status,
+            std::span<char> output) const;
+
+    std::unique_ptr<S3Client> client;
+    S3CachingClientConfig config;
+    S3BlockCache cache;
+    // Null if disabled.
+    std::unique_ptr<S3DiskCache> diskCache;
+    long blockSize{};
+};
+
+} // namespace molecula
@@ -0,0 +1,187 @@
+#include "molecula/s3/S3CachingClient.hpp"
+
+#include "molecula/s3/FakeS3Client.hpp"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+
+namespace molecula {
+
+namespace {
+struct CachingClient {
+    // Disk tier in @directory if not empty.
+    explicit CachingClient(size_t size, std::string directory = {})
+            : CachingClient{size, makeConfig(std::move(directory))} {}
+
+    CachingClient(size_t size, const S3CachingClientConfig &config) {
+        auto fake = std::make_unique<FakeS3Client>(makeData(size));
+        s3 = fake.get();
+        client = std::make_unique<S3CachingClient>(std::move(fake), config);
+    }
+
+    static S3CachingClientConfig makeConfig(std::string directory) {
+        S3CachingClientConfig config;
+        config.cache.blockSize = 1000;
+        config.maxRequestSize = 4000;
+        config.disk = makeDiskConfig(std::move(directory));
+        config.isImmutable = [](std::string_view, std::string_view) { return true; };
+        return config;
+    }
+
+    static S3DiskCacheConfig makeDiskConfig(std::string directory) {
+        S3DiskCacheConfig config;
+        config.directory = std::move(directory);
+        config.blockSize = 1000;
+        config.capacity = 10'000;
+        config.ioThreads = 2;
+        return config;
+    }
+
+    FakeS3Client *s3{};
+    std::unique_ptr<S3CachingClient> client;
+};
+
+std::string makeDirectory(std::string_view name) {
+    auto directory = std::filesystem::path{::testing::TempDir()} / name;
+    std::filesystem::remove_all(directory);
+    return directory;
+}
+} // namespace
+
+GTEST_TEST(S3CachingClient, Range) {
+    CachingClient c{2500};
+    S3GetObjectRequest req{"bucket", "key"};
+    req.setRange(900, 2100);
+    S3GetObject get = c.client->getObject(req).get();
+    EXPECT_EQ(get.status, 206);
+    EXPECT_EQ(get.objectSize, 2500);
+    EXPECT_EQ(get.data.view(), c.s3->data.substr(900, 1201));
+    // Blocks 0-2 with one GET
+    EXPECT_EQ(c.s3->numGets, 1);
+
+    req.setRange(1000, 1999);
+    get = c.client->getObject(req).get();
+    EXPECT_EQ(get.data.view(), c.s3->data.substr(1000, 1000));
+    EXPECT_EQ(c.s3->numGets, 1);
+
+    // Cut at the object end
+    req.setRange(2000, 5000);
+    get = c.client->getObject(req).get();
+    EXPECT_EQ(get.status, 206);
+    EXPECT_EQ(get.data.view(), c.s3->data.substr(2000));
+
+    req.setRange(3000, 3999);
+    EXPECT_EQ(c.client->getObject(req).get().status, 416);
+}
+
+GTEST_TEST(S3CachingClient, WholeObject) {
+    CachingClient c{9500};
+    S3GetObject get = c.client->getObject(S3GetObjectRequest{"bucket", "key"}).get();
+    EXPECT_EQ(get.status, 200);
+    EXPECT_EQ(get.data.view(), c.s3->data);
+    // First block, then blocks 1-4 and 5-8 and block 9.
+    EXPECT_EQ(c.s3->numGets, 4);
+
+    std::string output(9500, '\0');
+    S3GetObjectRequest req{"bucket", "key"};
+    req.output = output;
+    get = c.client->getObject(req).get();
+    EXPECT_EQ(get.size, 9500);
+    EXPECT_EQ(output, c.s3->data);
+    EXPECT_EQ(c.s3->numGets, 4);
+    EXPECT_EQ(c.client->getCacheStats().bytes, 9500);
+}
+
+GTEST_TEST(S3CachingClient, Mutable) {
+    S3CachingClientConfig config = CachingClient::makeConfig({});
+    config.isImmutable = [](std::string_view, std::string_view key) { return key == "data"; };
+    CachingClient c{2500, config};
+    S3GetObjectRequest req{"bucket", "key"};
+    req.setRange(0, 999);
+    EXPECT_EQ(c.client->getObject(req).get().data.view(), c.s3->data.substr(0, 1000));
+    EXPECT_EQ(c.client->getObject(req).get().data.view(), c.s3->data.substr(0, 1000));
+    EXPECT_EQ(c.s3->numGets, 2);
+
+    // No predicate: nothing is known to be immutable.
+    config.isImmutable = nullptr;
+    CachingClient uncached{2500, config};
+    uncached.client->getObject(req).get();
+    uncached.client->getObject(req).get();
+    EXPECT_EQ(uncached.s3->numGets, 2);
+}
+
+GTEST_TEST(S3CachingClient, GetRanges) {
+    CachingClient c{2500};
+    S3GetRangesRequest req{"bucket", "key"};
+    req.ranges = {{2400, 100}, {10, 5}, {0, 0}};
+    S3GetRanges get = c.client->getRanges(req).get();
+    EXPECT_EQ(get.status, 200);
+    ASSERT_EQ(get.ranges.size(), 3);
+    EXPECT_EQ(get.ranges[0], c.s3->data.substr(2400, 100));
+    EXPECT_EQ(get.ranges[1], c.s3->data.substr(10, 5));
+    EXPECT_TRUE(get.ranges[2].empty());
+    EXPECT_EQ(c.s3->numGets, 2);
+
+    req.ranges = {{2400, 200}};
+    EXPECT_EQ(c.client->getRanges(req).get().status, 416);
+}
+
+GTEST_TEST(S3CachingClient, ShortResponse) {
+    CachingClient c{2500};
+    c.s3->shortGets = 1;
+    S3GetObjectRequest req{"bucket", "key"};
+    req.setRange(0, 2499);
+    // Blocks 0 and 1 are complete, block 2 is short and not cached.
+    EXPECT_THROW(c.client->getObject(req).get(), std::runtime_error);
+    EXPECT_EQ(c.client->getCacheStats().bytes, 2000);
+
+    S3GetObject get = c.client->getObject(req).get();
+    EXPECT_EQ(get.status, 206);
+    EXPECT_EQ(get.data.view(), c.s3->data);
+    EXPECT_EQ(c.s3->numGets, 2);
+
+    // Short middle block
+    CachingClient middle{2500};
+    middle.s3->shortGets = 1;
+    req.setRange(1000, 1999);
+    EXPECT_THROW(middle.client->getObject(req).get(), std::runtime_error);
+    EXPECT_EQ(middle.client->getObject(req).get().data.view(), middle.s3->data.substr(1000, 1000));
+}
+
+GTEST_TEST(S3CachingClient, ShortResponseOnDisk) {
+    std::string directory = makeDirectory("S3CachingClient_ShortResponseOnDisk");
+    S3GetObjectRequest req{"bucket", "key"};
+    req.setRange(0, 2499);
+    {
+        CachingClient c{2500, directory};
+        c.s3->shortGets = 1;
+        EXPECT_THROW(c.client->getObject(req).get(), std::runtime_error);
+    }
+
+    // Restart: blocks 0 and 1 are on disk, block 2 is read from S3.
+    CachingClient c{2500, directory};
+    S3GetObject get = c.client->getObject(req).get();
+    EXPECT_EQ(get.data.view(), c.s3->data);
+    EXPECT_EQ(c.s3->numGets, 1);
+    EXPECT_EQ(c.client->getDiskCacheStats().hits, 2);
+}
+
+GTEST_TEST(S3CachingClient, ShortBlockOnDisk) {
+    std::string directory = makeDirectory("S3CachingClient_ShortBlockOnDisk");
+    {
+        S3DiskCache disk{CachingClient::makeDiskConfig(directory)};
+        auto data = std::make_shared<ByteBuffer>(500);
+        data->append(std::string(500, 'x'));
+        disk.put(S3BlockCache::getKey("bucket/key", 1), S3CachedBlock{206, 2500, std::move(data)});
+    }
+
+    CachingClient c{2500, directory};
+    S3GetObjectRequest req{"bucket", "key"};
+    req.setRange(1000, 1999);
+    EXPECT_EQ(c.client->getObject(req).get().data.view(), c.s3->data.substr(1000, 1000));
+    EXPECT_EQ(c.s3->numGets, 1);
+}
+
+} // namespace molecula
@@ -1,12 +1,28 @@
 #include "molecula/s3/S3Client.hpp"
 
+#include "molecula/s3/S3Request.hpp"
+#include "molecula/s3/S3Xml.hpp"
+
+#include "folly/coro/FutureUtil.h"
+
 #include <glog/logging.h>
+#include <algorithm>
+#include <charconv>
 #include <ctime>
+#include <numeric>
 #include <iomanip>
 #include <sstream>
 
 namespace molecula {
 
+folly::coro::Task<S3GetObjectInfo> S3Client::co_getObjectInfo(S3GetObjectInfoRequest req) {
+    co_return co_await folly::coro::toTask(getObjectInfo(req).semi());
+}
+
+folly::coro::Task<S3GetObject> S3Client::co_getObject(S3GetObjectRequest req) {
+    co_return co_await folly::coro::toTask(getObject(req).semi());
+}
+
 std::time_t parseS3Time(std::string_view timeStr) {
     std::tm tm{};
     std::istringstream ss{std::string{timeStr}};
@@ -14,6 +30,56 @@ std::time_t parseS3Time(std::string_view timeStr) {
     return ::timegm(&tm);
 }
 
+std::string formatS3Time(std::time_t time) {
+    std::tm tm{};
+    ::gmtime_r(&time, &tm);
+    char buffer[32];
+    size_t n = std::strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return std::string(buffer, n);
+}
+
+std::time_t parseS3IsoTime(std::string_view timeStr) {
+    std::tm tm{};
+    std::istringstream ss{std::string{timeStr}};
+    ss >> std::get_time(&tm, "%Y-%m-%dT%H:%M:%S");
+    return ::timegm(&tm);
+}
+
+std::vector<S3CoalescedRange> coalesceS3Ranges(
+        std::span<const S3Range> ranges,
+        long maxGap,
+        long maxSize) {
+    std::vector<size_t> order(ranges.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&ranges](size_t a, size_t b) {
+        return ranges[a].offset < ranges[b].offset;
+    });
+
+    std::vector<S3CoalescedRange> merged;
+    long end = 0;
+    for (size_t i : order) {
+        const S3Range &r = ranges[i];
+        if (r.size <= 0) {
+            continue;
+        }
+        long rangeEnd = r.offset + r.size;
+        if (!merged.empty()) {
+            S3CoalescedRange &last = merged.back();
+            long newEnd = std::max(end, rangeEnd);
+            if (r.offset - end <= maxGap && newEnd - last.range.offset <= maxSize) {
+                last.gapBytes += std::max(r.offset - end, 0L);
+                last.range.size = newEnd - last.range.offset;
+                last.parts.push_back(i);
+                end = newEnd;
+                continue;
+            }
+        }
+        merged.push_back(S3CoalescedRange{r, {i}, 0});
+        end = rangeEnd;
+    }
+    return merged;
+}
+
 S3Id S3Id::fromString(std::string uri) {
     size_t colonPos = uri.find(':');
     if (colonPos == std::string::npos) {
@@ -45,7 +111,11 @@ S3Id S3Id::fromPieces(std::string_view bucket, std::string_view key) {
     return S3Id{std::move(uri), 5, 5 + bucket.size()};
 }
 
-S3GetObjectInfo::S3GetObjectInfo(HttpResponse response) : status{response.status} {
+long getS3Status(const HttpResponse &response) {
+    return response.error == HttpError::None ? response.status : 0;
+}
+
+S3GetObjectInfo::S3GetObjectInfo(HttpResponse response) : status{getS3Status(response)} {
     if (is2xx(status)) {
         etag = response.headers.get("etag");
         size = response.headers.getContentLength();
@@ -59,18 +129,160 @@ S3GetObjectInfo::S3GetObjectInfo(HttpResponse response) : status{response.status
     }
 }
 
-S3GetObject::S3GetObject(HttpResponse response) : status{response.status} {
+S3GetObject::S3GetObject(HttpResponse response) : status{getS3Status(response)} {
     if (is2xx(status)) {
-        data = std::move(response.body);
-    } else {
+        if (response.output.empty()) {
+            data = std::move(response.body);
+            size = static_cast<long>(data.size());
+        } else {
+            size = static_cast<long>(response.outputSize);
+        }
+        objectSize = size;
+        etag = response.headers.get("etag");
+        std::string_view lastModifiedStr = response.headers.get("last-modified");
+        if (!lastModifiedStr.empty()) {
+            lastModified = parseS3Time(lastModifiedStr);
+        }
+        // "bytes 0-1023/4096"
+        std::string_view contentRange = response.headers.get("content-range");
+        if (size_t slash = contentRange.rfind('/'); slash != std::string_view::npos) {
+            objectSize = -1;
+            std::from_chars(
+                    contentRange.data() + slash + 1,
+                    contentRange.data() + contentRange.size(),
+                    objectSize);
+        }
+    } else if (status != 304) {
         LOG(ERROR) << "Failed GetObject: " << status << "\n" << response.body.view();
     }
 }
 
+std::string S3ListObjectsRequest::getQuery() const {
+    std::string query;
+    auto add = [&query](std::string_view name, std::string_view value) {
+        if (!query.empty()) {
+            query.append("&");
+        }
+        query.append(name).append("=").append(encodeS3Uri(value, true));
+    };
+    if (!continuationToken.empty()) {
+        add("continuation-token", continuationToken);
+    }
+    if (!delimiter.empty()) {
+        add("delimiter", delimiter);
+    }
+    add("list-type", "2");
+    add("max-keys", std::to_string(maxKeys));
+    if (!prefix.empty()) {
+        add("prefix", prefix);
+    }
+    return query;
+}
+
+S3ListObjects::S3ListObjects(HttpResponse response) : status{getS3Status(response)} {
+    std::string_view body = response.body.view();
+    if (!is2xx(status)) {
+        LOG(ERROR) << "Failed ListObjects: " << status << "\n" << body;
+        return;
+    }
+    S3XmlScanner contents{body};
+    while (auto element = contents.next("Contents")) {
+        S3Object &object = objects.emplace_back();
+        object.key = unescapeXml(getXmlElement(*element, "Key"));
+        object.etag = unescapeXml(getXmlElement(*element, "ETag"));
+        std::string_view size = getXmlElement(*element, "Size");
+        std::from_chars(size.data(), size.data() + size.size(), object.size);
+        std::string_view lastModified = getXmlElement(*element, "LastModified");
+        if (!lastModified.empty()) {
+            object.lastModified = parseS3IsoTime(lastModified);
+        }
+    }
+    S3XmlScanner prefixes{body};
+    while (auto element = prefixes.next("CommonPrefixes")) {
+        commonPrefixes.push_back(unescapeXml(getXmlElement(*element, "Prefix")));
+    }
+    if (getXmlElement(body, "IsTruncated") == "true") {
+        nextContinuationToken = unescapeXml(getXmlElement(body, "NextContinuationToken"));
+    }
+}
+
+S3PutObject::S3PutObject(HttpResponse response) : status{getS3Status(response)} {
+    std::string_view body = response.body.view();
+    // CompleteMultipartUpload may fail after sending 200, the error is in the body.
+    if (is2xx(status) && body.find("<Error>") != std::string_view::npos) {
+        status = 500;
+    }
+    if (is2xx(status)) {
+        etag = response.headers.get("etag");
+        if (etag.empty()) {
+            etag = unescapeXml(getXmlElement(body, "ETag"));
+        }
+    } else {
+        LOG(ERROR) << "Failed PutObject: " << status << "\n" << body;
+    }
+}
+
+S3CreateMultipartUpload::S3CreateMultipartUpload(HttpResponse response) :
+    status{getS3Status(response)} {
+    if (is2xx(status)) {
+        uploadId = unescapeXml(getXmlElement(response.body.view(), "UploadId"));
+    } else {
+        LOG(ERROR) << "Failed CreateMultipartUpload: " << status << "\n" << response.body.view();
+    }
+}
+
+S3AbortMultipartUpload::S3AbortMultipartUpload(HttpResponse response) :
+    status{getS3Status(response)} {
+    if (!is2xx(status)) {
+        LOG(ERROR) << "Failed AbortMultipartUpload: " << status << "\n" << response.body.view();
+    }
+}
+
+std::string getS3DeleteXml(std::span<const std::string> keys) {
+    std::string xml{"<Delete><Quiet>true</Quiet>"};
+    for (const std::string &key : keys) {
+        xml.append("<Object><Key>");
+        appendXmlEscaped(xml, key);
+        xml.append("</Key></Object>");
+    }
+    xml.append("</Delete>");
+    return xml;
+}
+
+S3DeleteObjectsBatch::S3DeleteObjectsBatch(HttpResponse response) :
+    status{getS3Status(response)} {
+    std::string_view body = response.body.view();
+    if (!is2xx(status)) {
+        LOG(ERROR) << "Failed DeleteObjects: " << status << "\n" << body;
+        errors.push_back(S3DeleteError{
+                "",
+                unescapeXml(getXmlElement(body, "Code")),
+                unescapeXml(getXmlElement(body, "Message"))});
+        return;
+    }
+    S3XmlScanner scanner{body};
+    while (auto element = scanner.next("Error")) {
+        errors.push_back(S3DeleteError{
+                unescapeXml(getXmlElement(*element, "Key")),
+                unescapeXml(getXmlElement(*element, "Code")),
+                unescapeXml(getXmlElement(*element, "Message"))});
+    }
+}
+
+S3GetObjectStream::S3GetObjectStream(HttpStreamResponse response) :
+    status{response.status},
+    size{static_cast<long>(response.headers.getContentLength())},
+    body{std::move(response.body)} {
+    if (!is2xx(status)) {
+        LOG(ERROR) << "Failed GetObject: " << status;
+    }
+}
+
 void S3GetObjectRequest::setRange(long begin, long end) {
     CHECK(begin >= 0 && end >= begin) << "Invalid range: [" << begin << ", " << end << "]";
     range[0] = begin;
     range[1] = end;
+    ranged = true;
 }
 
 std::string S3GetObjectRequest::getRangeHeader() const {
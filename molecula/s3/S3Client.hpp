@@ -1,8 +1,12 @@
 #pragma once
 
+#include "folly/coro/Task.h"
 #include "folly/futures/Future.h"
 #include "molecula/http_client/HttpClient.hpp"
 
+#include <chrono>
+#include <functional>
+#include <optional>
 #include <span>
 #include <string>
 #include <string_view>
@@ -10,6 +14,50 @@
 
 namespace molecula {
 
+// Hedged GETs: if a GET hasn't completed by the given latency percentile, send a duplicate and
+// take the first response. Trades a few percent more requests for a shorter tail.
+class S3HedgingConfig {
+public:
+    bool enabled{false};
+    double percentile{0.95};
+    // Lower bound for the hedge delay.
+    std::chrono::milliseconds minDelay{10};
+    // Latency samples needed before hedging starts.
+    long minSamples{100};
+};
+
+// Retries of throttled (429, 503 SlowDown), failed (500, 502, 504), timed out and reset requests.
+// Delay is random in [0, min(maxDelay, baseDelay * 2^attempt)] ("full jitter"). Each request
+// adds @budgetRatio to the retry budget of @budgetCapacity tokens, each retry takes one token:
+// when S3 is overloaded, retries stop at about @budgetRatio of the requests.
+class S3RetryConfig {
+public:
+    // Including the first attempt. One disables retries.
+    int maxAttempts{4};
+    std::chrono::milliseconds baseDelay{50};
+    std::chrono::milliseconds maxDelay{5'000};
+    double budgetRatio{0.1};
+    long budgetCapacity{100};
+};
+
+// Adaptive (AIMD) limit of requests in flight per bucket and key prefix. After each round of
+// limit requests, the limit grows by one if it was used, first byte latency was stable and the
+// round moved more bytes per second than the round before. It is multiplied by
+// @decreaseFactor on 429/503 or when first byte latency exceeds @latencyTolerance times the
+// baseline. First byte latency doesn't grow with the response size, so large and small GETs
+// can share a partition. Extra requests wait for a slot without blocking a thread.
+class S3ConcurrencyConfig {
+public:
+    bool enabled{false};
+    int initialLimit{16};
+    int minLimit{1};
+    int maxLimit{1'024};
+    double decreaseFactor{0.7};
+    double latencyTolerance{3.0};
+    // Key path components in the partition, S3 scales request rate per prefix.
+    int prefixDepth{1};
+};
+
 class S3ClientConfig {
 public:
     std::string_view endpoint;
@@ -17,6 +65,36 @@ public:
     std::string_view secretKey;
     std::string_view region;
     bool pathStyle{true};
+    // Per request deadline, zero for none.
+    std::chrono::milliseconds requestTimeout{};
+    // Abort transfers slower than @lowSpeedLimit bytes per second for @lowSpeedTime.
+    long lowSpeedLimit{};
+    std::chrono::seconds lowSpeedTime{};
+    S3HedgingConfig hedging;
+    S3RetryConfig retry;
+    S3ConcurrencyConfig concurrency;
+    // Don't hash uploaded data, sign UNSIGNED-PAYLOAD instead. Use only over HTTPS.
+    bool unsignedPayload{false};
+};
+
+// S3 client counters since the client creation.
+class S3ClientStats {
+public:
+    long getRequests{};
+    // Duplicate GETs sent and how many of them completed first.
+    long hedgedRequests{};
+    long hedgeWins{};
+    // Attempts repeated, and retryable failures returned because the budget was empty.
+    long retries{};
+    long retryBudgetExhausted{};
+    // Ranges asked by getRanges, GETs saved by merging them and gap bytes read in between.
+    long rangesRequested{};
+    long rangeRequestsSaved{};
+    long rangeExtraBytes{};
+
+    double getHedgeRate() const {
+        return getRequests == 0 ? 0.0 : static_cast<double>(hedgedRequests) / getRequests;
+    }
 };
 
 // S3 object identifier. Stores as a full string for less allocations and better cache locality.
@@ -58,9 +136,13 @@ private:
     size_t bucketEnd{};
 };
 
+// Status of a complete response. A transfer that timed out or lost its connection has status 0,
+// also after a 2xx header arrived: its body is partial.
+long getS3Status(const HttpResponse &response);
+
 class S3GetObjectInfoRequest {
 public:
-    S3GetObjectInfoRequest(S3Id id) : bucket{id.bucket()}, key{id.key()} {}
+    S3GetObjectInfoRequest(const S3Id &id) : bucket{id.bucket()}, key{id.key()} {}
     S3GetObjectInfoRequest(std::string_view bucket, std::string_view key) :
         bucket{bucket}, key{key} {}
 
@@ -80,39 +162,358 @@ public:
 
 class S3GetObjectRequest {
 public:
-    S3GetObjectRequest(S3Id id) : bucket{id.bucket()}, key{id.key()} {}
+    S3GetObjectRequest(const S3Id &id) : bucket{id.bucket()}, key{id.key()} {}
     S3GetObjectRequest(std::string_view bucket, std::string_view key) : bucket{bucket}, key{key} {}
 
     std::string_view bucket;
     std::string_view key;
     long range[2]{};
+    // Set by setRange: range [0, 0] is the first byte, not the whole object.
+    bool ranged{};
+    // Optional destination for the object data, S3GetObject::data stays empty then. Must stay
+    // valid until the request completes.
+    std::span<char> output;
+    // Conditional GET: status 304 without data if the object still has this ETag, or, without
+    // an ETag, if it wasn't modified since this time.
+    std::string_view ifNoneMatch;
+    std::time_t ifModifiedSince{};
+    // Status 412 unless the object has this ETag, e.g. to read parts of one object version.
+    std::string_view ifMatch;
 
     void setRange(long begin, long end);
 
+    bool isConditional() const {
+        return !ifNoneMatch.empty() || ifModifiedSince > 0 || !ifMatch.empty();
+    }
+
     bool hasRange() const {
-        return range[0] > 0 || range[1] > 0;
+        return ranged;
+    }
+
+    long getRangeSize() const {
+        return range[1] - range[0] + 1;
     }
 
     std::string getRangeHeader() const;
 };
 
+// Whole object read with concurrent range GETs of @partSize, so one object uses many
+// connections. Parts are written directly into one buffer of the object size.
+class S3GetObjectParallelRequest {
+public:
+    S3GetObjectParallelRequest(const S3Id &id) : bucket{id.bucket()}, key{id.key()} {}
+    S3GetObjectParallelRequest(std::string_view bucket, std::string_view key) :
+        bucket{bucket}, key{key} {}
+
+    std::string_view bucket;
+    std::string_view key;
+    // Object size if known, otherwise it is taken from getObjectInfo.
+    std::optional<long> size;
+    // ETag of the object of @size if known. All parts are read with If-Match of the ETag, so
+    // they are of one object version; without it, the first part is read before the others to
+    // get the ETag.
+    std::string_view etag;
+    long partSize{8 * 1024 * 1024};
+};
+
+class S3Range {
+public:
+    long offset{};
+    long size{};
+};
+
+// Requested ranges merged into one GET.
+class S3CoalescedRange {
+public:
+    S3Range range;
+    // Indexes of the requested ranges inside.
+    std::vector<size_t> parts;
+    // Bytes between the requested ranges, read only to save a request.
+    long gapBytes{};
+};
+
+// Merges ranges separated by at most @maxGap bytes, as long as the merged range is not larger
+// than @maxSize. Ranges may be unsorted and overlap. Empty ranges are skipped.
+std::vector<S3CoalescedRange> coalesceS3Ranges(
+        std::span<const S3Range> ranges,
+        long maxGap,
+        long maxSize);
+
+// Scattered reads of one object. Nearby ranges are merged and merged GETs are sent concurrently.
+class S3GetRangesRequest {
+public:
+    S3GetRangesRequest(const S3Id &id) : bucket{id.bucket()}, key{id.key()} {}
+    S3GetRangesRequest(std::string_view bucket, std::string_view key) : bucket{bucket}, key{key} {}
+
+    std::string_view bucket;
+    std::string_view key;
+    std::vector<S3Range> ranges;
+    // Reading a gap this small is cheaper than the first byte latency of another GET.
+    long maxGap{1024 * 1024};
+    long maxMergedSize{16 * 1024 * 1024};
+};
+
+class S3GetRanges {
+public:
+    long status{};
+    // Data of the merged GETs.
+    std::vector<ByteBuffer> buffers;
+    // Data of each requested range in request order, views into @buffers.
+    std::vector<std::string_view> ranges;
+};
+
 class S3GetObject {
 public:
     explicit S3GetObject(HttpResponse response);
 
     long status{};
+    // Object data size, also if written to the request output.
+    long size{};
+    // Size of the whole object, from Content-Range for a range GET. -1 if unknown.
+    long objectSize{-1};
+    std::string etag;
+    std::time_t lastModified{};
     ByteBuffer data;
 };
 
+// Object body streamed in chunks. On error, body has the S3 error document.
+class S3GetObjectStream {
+public:
+    explicit S3GetObjectStream(HttpStreamResponse response);
+
+    long status{};
+    long size{};
+    std::shared_ptr<HttpBodyStream> body;
+};
+
+class S3PutObjectRequest {
+public:
+    S3PutObjectRequest(const S3Id &id) : bucket{id.bucket()}, key{id.key()} {}
+    S3PutObjectRequest(std::string_view bucket, std::string_view key) : bucket{bucket}, key{key} {}
+
+    std::string_view bucket;
+    std::string_view key;
+    // Object data, sent without copying. Must stay valid until the request completes.
+    ByteSpan body;
+    std::string_view contentType{"application/octet-stream"};
+};
+
+// Result of PutObject, UploadPart and CompleteMultipartUpload.
+class S3PutObject {
+public:
+    explicit S3PutObject(HttpResponse response);
+
+    long status{};
+    std::string etag;
+};
+
+// Object uploaded as parts of @partSize, up to @maxConcurrentParts at once. Objects not larger
+// than a part are uploaded with a single PutObject.
+class S3UploadObjectRequest {
+public:
+    S3UploadObjectRequest(const S3Id &id) : bucket{id.bucket()}, key{id.key()} {}
+    S3UploadObjectRequest(std::string_view bucket, std::string_view key) :
+        bucket{bucket}, key{key} {}
+
+    std::string_view bucket;
+    std::string_view key;
+    // Must stay valid until the upload completes.
+    ByteSpan body;
+    std::string_view contentType{"application/octet-stream"};
+    // S3 allows 5 MiB to 5 GiB parts and up to 10000 parts.
+    long partSize{64 * 1024 * 1024};
+    int maxConcurrentParts{16};
+};
+
+class S3CreateMultipartUpload {
+public:
+    explicit S3CreateMultipartUpload(HttpResponse response);
+
+    long status{};
+    std::string uploadId;
+};
+
+class S3UploadPartRequest {
+public:
+    std::string_view bucket;
+    std::string_view key;
+    std::string_view uploadId;
+    // From 1
+    int partNumber{};
+    // Must stay valid until the request completes.
+    ByteSpan body;
+};
+
+class S3CompletedPart {
+public:
+    int partNumber{};
+    std::string etag;
+};
+
+class S3CompleteMultipartUploadRequest {
+public:
+    std::string_view bucket;
+    std::string_view key;
+    std::string_view uploadId;
+    std::vector<S3CompletedPart> parts;
+};
+
+class S3AbortMultipartUpload {
+public:
+    explicit S3AbortMultipartUpload(HttpResponse response);
+
+    long status{};
+};
+
+// Multi-object delete of @keys, up to @batchSize keys per request and @maxConcurrentBatches
+// requests in flight.
+class S3DeleteObjectsRequest {
+public:
+    S3DeleteObjectsRequest(std::string_view bucket, std::span<const std::string> keys) :
+        bucket{bucket}, keys{keys} {}
+
+    std::string_view bucket;
+    // Must stay valid until the request completes.
+    std::span<const std::string> keys;
+    // S3 accepts at most 1000 keys per request.
+    int batchSize{1000};
+    int maxConcurrentBatches{8};
+};
+
+// Body of a quiet DeleteObjects request: only keys that failed are listed in the response.
+std::string getS3DeleteXml(std::span<const std::string> keys);
+
+class S3DeleteError {
+public:
+    std::string key;
+    std::string code;
+    std::string message;
+};
+
+// Result of one DeleteObjects request.
+class S3DeleteObjectsBatch {
+public:
+    explicit S3DeleteObjectsBatch(HttpResponse response);
+
+    long status{};
+    // Failed keys, or the error of the whole request if it failed.
+    std::vector<S3DeleteError> errors;
+};
+
+class S3DeleteObjects {
+public:
+    // Status of the first failed batch, 0 if it failed without a response, or 200.
+    long status{200};
+    long numDeleted{};
+    long numBatches{};
+    // Keys of a failed batch are all listed with the error of the request.
+    std::vector<S3DeleteError> errors;
+};
+
+// ListObjectsV2 of keys starting with @prefix.
+class S3ListObjectsRequest {
+public:
+    S3ListObjectsRequest(std::string_view bucket, std::string_view prefix) :
+        bucket{bucket}, prefix{prefix} {}
+
+    std::string_view bucket;
+    std::string_view prefix;
+    // With a delimiter, keys having it after the prefix are rolled up into common prefixes.
+    std::string_view delimiter;
+    // Page to read, empty for the first one.
+    std::string_view continuationToken;
+    int maxKeys{1000};
+    // Parallel listing: levels of delimiter "/" prefixes listed concurrently, and max listings
+    // in flight.
+    int fanOutDepth{1};
+    int maxConcurrency{16};
+
+    // Canonical query string, parameters sorted by name.
+    std::string getQuery() const;
+};
+
+class S3Object {
+public:
+    std::string key;
+    long size{};
+    std::string etag;
+    std::time_t lastModified{};
+};
+
+// One page of ListObjectsV2.
+class S3ListObjects {
+public:
+    explicit S3ListObjects(HttpResponse response);
+
+    long status{};
+    std::vector<S3Object> objects;
+    std::vector<std::string> commonPrefixes;
+    // Empty on the last page.
+    std::string nextContinuationToken;
+};
+
+class S3ListObjectsResult {
+public:
+    // Status of the first failed page, or 200.
+    long status{};
+    long numObjects{};
+    long numPages{};
+};
+
+// Receives listed pages. Parallel listing calls it concurrently.
+using S3ListObjectsCallback = std::function<void(S3ListObjects &page)>;
+
 // S3 storage client.
 class S3Client {
 public:
     virtual ~S3Client() = default;
     virtual folly::Future<S3GetObjectInfo> getObjectInfo(const S3GetObjectInfoRequest &req) = 0;
     virtual folly::Future<S3GetObject> getObject(const S3GetObjectRequest &req) = 0;
+    virtual folly::Future<S3GetObject> getObjectParallel(const S3GetObjectParallelRequest &req) = 0;
+    virtual folly::Future<S3GetRanges> getRanges(const S3GetRangesRequest &req) = 0;
+
+    virtual folly::Future<S3ListObjects> listObjectsPage(const S3ListObjectsRequest &req) = 0;
+    // Reads pages one after another with continuation tokens, passes each to @onPage.
+    virtual folly::Future<S3ListObjectsResult> listObjects(
+            const S3ListObjectsRequest &req,
+            S3ListObjectsCallback onPage) = 0;
+    // Lists "/" prefixes concurrently down to @fanOutDepth levels below the request prefix.
+    // Objects at the upper levels are delivered too. Common prefixes are not delivered.
+    virtual folly::Future<S3ListObjectsResult> listObjectsParallel(
+            const S3ListObjectsRequest &req,
+            S3ListObjectsCallback onPage) = 0;
+
+    virtual folly::Future<S3PutObject> putObject(const S3PutObjectRequest &req) = 0;
+    // PutObject or parallel multipart upload depending on the size. Failed multipart upload is
+    // aborted.
+    virtual folly::Future<S3PutObject> uploadObject(const S3UploadObjectRequest &req) = 0;
+    // Request body is not sent.
+    virtual folly::Future<S3CreateMultipartUpload> createMultipartUpload(
+            const S3PutObjectRequest &req) = 0;
+    virtual folly::Future<S3PutObject> uploadPart(const S3UploadPartRequest &req) = 0;
+    virtual folly::Future<S3PutObject> completeMultipartUpload(
+            const S3CompleteMultipartUploadRequest &req) = 0;
+    virtual folly::Future<S3AbortMultipartUpload> abortMultipartUpload(
+            std::string_view bucket,
+            std::string_view key,
+            std::string_view uploadId) = 0;
+    // Deletes keys in batches. Deleting a missing key succeeds.
+    virtual folly::Future<S3DeleteObjects> deleteObjects(const S3DeleteObjectsRequest &req) = 0;
+    // Completes when the response headers arrive, object data is read from the stream.
+    virtual folly::Future<S3GetObjectStream> getObjectStream(const S3GetObjectRequest &req) = 0;
+    virtual S3ClientStats getStats() const = 0;
+
+    // Coroutine variants. Lazy: the request is sent when the task is awaited, so the strings the
+    // request refers to must outlive the task. Cancelling the awaiting task cancels the request.
+    folly::coro::Task<S3GetObjectInfo> co_getObjectInfo(S3GetObjectInfoRequest req);
+    folly::coro::Task<S3GetObject> co_getObject(S3GetObjectRequest req);
 };
 
 std::unique_ptr<S3Client> createS3Client(HttpClient *httpClient, const S3ClientConfig &config);
 std::time_t parseS3Time(std::string_view timeStr);
+// HTTP date of headers, like Wed, 21 Oct 2015 07:28:00 GMT.
+std::string formatS3Time(std::time_t time);
+// Parses ISO 8601 time of XML responses, like 2009-10-12T17:50:30.000Z.
+std::time_t parseS3IsoTime(std::string_view timeStr);
 
 } // namespace molecula
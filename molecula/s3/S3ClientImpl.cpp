@@ -1,7 +1,14 @@
 #include "molecula/s3/S3ClientImpl.hpp"
 
+#include "folly/executors/GlobalExecutor.h"
+#include "molecula/s3/S3Xml.hpp"
+
 #include <glog/logging.h>
+#include <algorithm>
+#include <array>
 #include <charconv>
+#include <iterator>
+#include <mutex>
 
 namespace molecula {
 std::unique_ptr<S3Client> createS3Client(HttpClient *httpClient, const S3ClientConfig &config) {
@@ -12,21 +19,36 @@ S3ClientImpl::S3ClientImpl(HttpClient *httpClient, const S3ClientConfig &config)
     httpClient{httpClient},
     endpoint{config.endpoint},
     signer{config.accessKey, config.secretKey, config.region},
-    config{config} {}
+    config{config},
+    retryBudget{config.retry} {
+    if (config.concurrency.enabled) {
+        concurrency = std::make_unique<S3ConcurrencyController>(config.concurrency);
+    }
+}
 
 void S3ClientImpl::setObject(S3Request &request, std::string_view bucket, std::string_view key)
         const {
+    // Strings are sized up front: one allocation each.
+    std::string path;
     if (config.pathStyle) {
         request.setHost(endpoint.host());
-        request.setPath(std::string{"/"}.append(bucket).append("/").append(key));
+        path.reserve(bucket.size() + key.size() + 2);
+        path.append("/").append(bucket).append("/").append(key);
     } else {
-        request.setHost(std::string{bucket}.append(".").append(endpoint.host()));
-        request.setPath(std::string{"/"}.append(key));
+        std::string host;
+        host.reserve(bucket.size() + endpoint.host().size() + 1);
+        host.append(bucket).append(".").append(endpoint.host());
+        request.setHost(std::move(host));
+        path.reserve(key.size() + 1);
+        path.append("/").append(key);
     }
+    request.setPath(std::move(path));
 }
 
 HttpRequest S3ClientImpl::createHttpRequest(S3Request &request) const {
     std::string url;
+    url.reserve(endpoint.scheme().size() + request.getHost().size() + request.getPath().size()
+                + request.getQuery().size() + 16);
     url.append(endpoint.scheme());
     url.append("://");
     url.append(request.getHost());
@@ -45,29 +67,42 @@ HttpRequest S3ClientImpl::createHttpRequest(S3Request &request) const {
     HttpRequest httpRequest;
     httpRequest.url = std::move(url);
     httpRequest.method = request.method;
+    httpRequest.body = request.body;
+    httpRequest.timeout = config.requestTimeout;
+    httpRequest.lowSpeedLimit = config.lowSpeedLimit;
+    httpRequest.lowSpeedTime = config.lowSpeedTime;
     for (std::string &header : request.headers.span()) {
         httpRequest.headers.add(std::move(header));
     }
     return httpRequest;
 }
 
-folly::Future<S3GetObjectInfo> S3ClientImpl::getObjectInfo(const S3GetObjectInfoRequest &req) {
+HttpRequest S3ClientImpl::signRequest(S3Request &request) const {
     S3Time time;
+    signer.sign(request, time);
+    return createHttpRequest(request);
+}
 
-    // Prepare S3 request and sign it
-    S3Request s3Req;
-    s3Req.method = HttpMethod::HEAD;
-    setObject(s3Req, req.bucket, req.key);
-    signer.sign(s3Req, time);
+folly::Future<S3GetObjectInfo> S3ClientImpl::getObjectInfo(const S3GetObjectInfoRequest &req) {
+    // Each attempt is signed at send time, request fields must be owned.
+    auto send = [this, bucket = std::string{req.bucket}, key = std::string{req.key}] {
+        S3Time time;
 
-    // Make HTTP request
-    HttpRequest request = createHttpRequest(s3Req);
-    return httpClient->makeRequest(std::move(request)).thenValue([](HttpResponse response) {
-        return S3GetObjectInfo{std::move(response)};
-    });
+        // Prepare S3 request and sign it
+        S3Request s3Req;
+        s3Req.method = HttpMethod::HEAD;
+        setObject(s3Req, bucket, key);
+        signer.sign(s3Req, time);
+
+        // Make HTTP request
+        return httpClient->makeRequest(createHttpRequest(s3Req));
+    };
+    auto limited = limitConcurrency(req.bucket, req.key, std::move(send));
+    return makeRetriedRequest(HttpMethod::HEAD, std::move(limited))
+            .thenValue([](HttpResponse response) { return S3GetObjectInfo{std::move(response)}; });
 }
 
-folly::Future<S3GetObject> S3ClientImpl::getObject(const S3GetObjectRequest &req) {
+HttpRequest S3ClientImpl::createGetObjectRequest(const S3GetObjectRequest &req) {
     S3Time time;
 
     // Prepare S3 request and sign it
@@ -77,13 +112,904 @@ folly::Future<S3GetObject> S3ClientImpl::getObject(const S3GetObjectRequest &req
     if (req.hasRange()) {
         s3Req.headers.add(req.getRangeHeader());
     }
+    if (!req.ifMatch.empty()) {
+        s3Req.headers.add(makeHeader("if-match", req.ifMatch));
+    }
+    if (!req.ifNoneMatch.empty()) {
+        s3Req.headers.add(makeHeader("if-none-match", req.ifNoneMatch));
+    } else if (req.ifModifiedSince > 0) {
+        s3Req.headers.add(makeHeader("if-modified-since", formatS3Time(req.ifModifiedSince)));
+    }
     signer.sign(s3Req, time);
 
-    // Make HTTP request
-    HttpRequest request = createHttpRequest(s3Req);
+    return createHttpRequest(s3Req);
+}
+
+folly::Future<S3GetObject> S3ClientImpl::getObject(const S3GetObjectRequest &req) {
+    numGetRequests.fetch_add(1, std::memory_order_relaxed);
+
+    // Retried and hedged requests are created later, request fields must be owned.
+    auto createRequest = [this,
+                          bucket = std::string{req.bucket},
+                          key = std::string{req.key},
+                          hasRange = req.hasRange(),
+                          range = std::array<long, 2>{req.range[0], req.range[1]},
+                          output = req.output,
+                          ifNoneMatch = std::string{req.ifNoneMatch},
+                          ifModifiedSince = req.ifModifiedSince,
+                          ifMatch = std::string{req.ifMatch}] {
+        S3GetObjectRequest copy{bucket, key};
+        if (hasRange) {
+            copy.setRange(range[0], range[1]);
+        }
+        copy.ifNoneMatch = ifNoneMatch;
+        copy.ifModifiedSince = ifModifiedSince;
+        copy.ifMatch = ifMatch;
+        HttpRequest request = createGetObjectRequest(copy);
+        if (!output.empty()) {
+            request.output = output;
+        } else if (copy.hasRange()) {
+            // Exact size is known: body is copied once, without regrowth.
+            request.responseBody.reserve(copy.getRangeSize());
+        }
+        return request;
+    };
+    // Not hedged with output: two transfers can't write into the same output. Retries are fine,
+    // the previous attempt has completed.
+    bool hedge = req.output.empty();
+    auto send = [this, hedge, createRequest = std::move(createRequest)] {
+        return hedge ? makeHedgedRequest(createRequest) : httpClient->makeRequest(createRequest());
+    };
+    auto limited = limitConcurrency(req.bucket, req.key, std::move(send));
+    return makeRetriedRequest(HttpMethod::GET, std::move(limited))
+            .thenValue([](HttpResponse response) { return S3GetObject{std::move(response)}; });
+}
+
+folly::Future<S3GetObject> S3ClientImpl::getObjectParallel(const S3GetObjectParallelRequest &req) {
+    CHECK(req.partSize > 0) << "Invalid part size: " << req.partSize;
+    if (req.size) {
+        return getObjectParts(req.bucket, req.key, *req.size, req.partSize, req.etag);
+    }
+    return getObjectInfo(S3GetObjectInfoRequest{req.bucket, req.key})
+            .thenValue([this,
+                        bucket = std::string{req.bucket},
+                        key = std::string{req.key},
+                        partSize = req.partSize](S3GetObjectInfo info) {
+                if (!is2xx(info.status)) {
+                    HttpResponse response;
+                    response.status = info.status;
+                    return folly::makeFuture(S3GetObject{std::move(response)});
+                }
+                return getObjectParts(bucket, key, info.size, partSize, info.etag);
+            });
+}
+
+folly::Future<S3GetObject> S3ClientImpl::getObjectParts(
+        std::string_view bucket,
+        std::string_view key,
+        long size,
+        long partSize,
+        std::string_view etag) {
+    if (size <= partSize) {
+        S3GetObjectRequest get{bucket, key};
+        get.ifMatch = etag;
+        return getObject(get);
+    }
+
+    auto get = std::make_shared<ParallelGet>();
+    get->bucket = bucket;
+    get->key = key;
+    get->partSize = partSize;
+    get->etag = etag;
+    get->buffer = std::make_shared<ByteBuffer>(size);
+    get->buffer->resize(size);
+    get->parts.resize((size + partSize - 1) / partSize);
+    auto future = get->promise.getFuture();
+    // Without an ETag, part 0 starts the others when it has one.
+    size_t numParts = get->etag.empty() ? 1 : get->parts.size();
+    for (size_t i = 0; i < numParts; i++) {
+        getPart(get, i);
+    }
+    return future;
+}
+
+void S3ClientImpl::getPart(std::shared_ptr<ParallelGet> get, size_t index) {
+    long offset = static_cast<long>(index) * get->partSize;
+    long end = std::min<long>(offset + get->partSize, get->buffer->size()) - 1;
+    S3GetObjectRequest req{get->bucket, get->key};
+    req.setRange(offset, end);
+    req.output = std::span<char>{
+            get->buffer->data() + offset, static_cast<size_t>(end - offset + 1)};
+    req.ifMatch = get->etag;
+    // Holds the buffer: a cancelled part may write into it until it completes.
+    auto part = getObject(req).thenTry([this, get, index](folly::Try<S3GetObject> result) {
+        finishPart(get, index, std::move(result));
+    });
+    {
+        std::lock_guard<std::mutex> lock{get->mutex};
+        if (!get->done) {
+            get->parts[index].emplace(std::move(part));
+            return;
+        }
+    }
+    part.cancel();
+}
+
+void S3ClientImpl::finishPart(
+        std::shared_ptr<ParallelGet> get,
+        size_t index,
+        folly::Try<S3GetObject> result) {
+    long status = 0;
+    if (result.hasValue()) {
+        const S3GetObject &part = result.value();
+        long expectedSize = std::min<long>(
+                get->partSize, get->buffer->size() - index * get->partSize);
+        status = part.status;
+        if (is2xx(status) && part.size != expectedSize) {
+            // Object changed while read and If-Match wasn't checked.
+            LOG(ERROR) << "Part " << index << " size " << part.size << ", expected "
+                       << expectedSize;
+            status = 412;
+        }
+    }
+    bool failed = !is2xx(status);
+    bool startOthers = false;
+    bool completed = false;
+    std::vector<folly::Future<folly::Unit>> cancelled;
+    {
+        std::lock_guard<std::mutex> lock{get->mutex};
+        if (get->done) {
+            return;
+        }
+        if (failed) {
+            get->done = true;
+            for (size_t i = 0; i < get->parts.size(); i++) {
+                if (i != index && get->parts[i]) {
+                    cancelled.push_back(std::move(*get->parts[i]));
+                }
+            }
+        } else {
+            if (index == 0 && get->etag.empty()) {
+                get->etag = result.value().etag;
+                startOthers = true;
+            }
+            completed = ++get->numCompleted == get->parts.size();
+            get->done = completed;
+        }
+    }
+    // A failed read doesn't wait for the other parts.
+    for (auto &part : cancelled) {
+        part.cancel();
+    }
+
+    HttpResponse response;
+    if (result.hasException()) {
+        get->promise.setException(result.exception());
+    } else if (failed) {
+        // 412 if the object was overwritten since the ETag was taken
+        response.status = status;
+        get->promise.setValue(S3GetObject{std::move(response)});
+    } else if (completed) {
+        response.status = 200;
+        response.headers.add(makeHeader("etag", get->etag));
+        response.body = std::move(*get->buffer);
+        get->promise.setValue(S3GetObject{std::move(response)});
+    } else if (startOthers) {
+        for (size_t i = 1; i < get->parts.size(); i++) {
+            getPart(get, i);
+        }
+    }
+}
+
+folly::Future<S3GetRanges> S3ClientImpl::getRanges(const S3GetRangesRequest &req) {
+    auto merged = coalesceS3Ranges(req.ranges, req.maxGap, req.maxMergedSize);
+    numRangesRequested.fetch_add(req.ranges.size(), std::memory_order_relaxed);
+    long numRequested = 0;
+    long extraBytes = 0;
+    std::vector<folly::Future<S3GetObject>> gets;
+    gets.reserve(merged.size());
+    for (const S3CoalescedRange &m : merged) {
+        numRequested += m.parts.size();
+        extraBytes += m.gapBytes;
+        S3GetObjectRequest get{req.bucket, req.key};
+        get.setRange(m.range.offset, m.range.offset + m.range.size - 1);
+        gets.push_back(getObject(get));
+    }
+    numRangeRequestsSaved.fetch_add(numRequested - merged.size(), std::memory_order_relaxed);
+    numRangeExtraBytes.fetch_add(extraBytes, std::memory_order_relaxed);
+
+    return folly::collectAllUnsafe(gets).thenValue(
+            [merged = std::move(merged), ranges = req.ranges](
+                    std::vector<folly::Try<S3GetObject>> results) {
+                S3GetRanges result;
+                result.status = 200;
+                // Empty ranges keep empty views.
+                result.ranges.resize(ranges.size());
+                result.buffers.reserve(results.size());
+                for (size_t i = 0; i < results.size(); i++) {
+                    // Rethrows the first failure
+                    S3GetObject &get = results[i].value();
+                    const S3Range &range = merged[i].range;
+                    if (!is2xx(get.status)) {
+                        result.status = get.status;
+                        return result;
+                    }
+                    if (get.size != range.size) {
+                        LOG(ERROR) << "Range at " << range.offset << " size " << get.size
+                                   << ", expected " << range.size;
+                        result.status = 416;
+                        return result;
+                    }
+                    const char *data = get.data.data();
+                    for (size_t part : merged[i].parts) {
+                        result.ranges[part] = std::string_view{
+                                data + (ranges[part].offset - range.offset),
+                                static_cast<size_t>(ranges[part].size)};
+                    }
+                    result.buffers.push_back(std::move(get.data));
+                }
+                return result;
+            });
+}
+
+std::function<folly::Future<HttpResponse>()> S3ClientImpl::limitConcurrency(
+        std::string_view bucket,
+        std::string_view key,
+        std::function<folly::Future<HttpResponse>()> send) {
+    if (!concurrency) {
+        return send;
+    }
+    // Each attempt takes a slot: retries of throttled requests wait for a lower limit.
+    return [this,
+            partition = getS3Partition(bucket, key, config.concurrency.prefixDepth),
+            send = std::move(send)] {
+        return concurrency->acquire(partition).thenValue([this, partition, send](folly::Unit) {
+            auto start = std::chrono::steady_clock::now();
+            return send().thenTry([this, partition, start](folly::Try<HttpResponse> result) {
+                long bytes = 0;
+                std::chrono::microseconds firstByteLatency{};
+                if (result.hasValue()) {
+                    const HttpResponse &response = result.value();
+                    bytes = static_cast<long>(response.body.size() + response.outputSize);
+                    firstByteLatency = response.firstByteLatency;
+                }
+                concurrency->release(
+                        partition,
+                        getS3RequestOutcome(result),
+                        start,
+                        std::chrono::steady_clock::now(),
+                        bytes,
+                        firstByteLatency);
+                return std::move(result).value();
+            });
+        });
+    };
+}
+
+folly::Future<HttpResponse> S3ClientImpl::makeRetriedRequest(
+        HttpMethod method,
+        std::function<folly::Future<HttpResponse>()> send) {
+    return makeRetriedRequest(isIdempotent(method) ? config.retry.maxAttempts : 1, std::move(send));
+}
+
+folly::Future<HttpResponse> S3ClientImpl::makeRetriedRequest(
+        int maxAttempts,
+        std::function<folly::Future<HttpResponse>()> send) {
+    retryBudget.deposit();
+    return retryRequest(
+            std::make_shared<std::function<folly::Future<HttpResponse>()>>(std::move(send)),
+            maxAttempts,
+            0);
+}
+
+folly::Future<HttpResponse> S3ClientImpl::retryRequest(
+        std::shared_ptr<std::function<folly::Future<HttpResponse>()>> send,
+        int maxAttempts,
+        int attempt) {
+    auto onResult = [this, send, maxAttempts, attempt](
+                            folly::Try<HttpResponse> result) -> folly::Future<HttpResponse> {
+        if (attempt + 1 >= maxAttempts || !isS3Retryable(result)) {
+            return folly::makeFuture<HttpResponse>(dropPartialResponse(std::move(result)));
+        }
+        if (!retryBudget.tryWithdraw()) {
+            numRetryBudgetExhausted.fetch_add(1, std::memory_order_relaxed);
+            return folly::makeFuture<HttpResponse>(dropPartialResponse(std::move(result)));
+        }
+        numRetries.fetch_add(1, std::memory_order_relaxed);
+        auto delay = getS3RetryDelay(config.retry, attempt);
+        LOG(WARNING) << "Retrying S3 request in " << delay.count() << "ms, status "
+                     << result.value().status;
+        // Timer, not a blocked thread. Next attempt is signed again with the current time.
+        return folly::futures::sleepUnsafe(delay).thenValue(
+                [this, send, maxAttempts, attempt](folly::Unit) {
+                    return retryRequest(send, maxAttempts, attempt + 1);
+                });
+    };
+    return (*send)().thenTry(std::move(onResult));
+}
+
+std::optional<std::chrono::microseconds> S3ClientImpl::getHedgeDelay() const {
+    if (!config.hedging.enabled
+        || getLatency.getCount() < static_cast<uint64_t>(config.hedging.minSamples)) {
+        return std::nullopt;
+    }
+    return std::max<std::chrono::microseconds>(
+            getLatency.getPercentile(config.hedging.percentile), config.hedging.minDelay);
+}
+
+folly::Future<HttpResponse> S3ClientImpl::makeHedgedRequest(
+        std::function<HttpRequest()> createRequest) {
+    auto start = std::chrono::steady_clock::now();
+    auto recordLatency = [this, start](const HttpResponse &response) {
+        if (is2xx(getS3Status(response))) {
+            getLatency.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start));
+        }
+    };
+
+    auto delay = getHedgeDelay();
+    if (!delay) {
+        return httpClient->makeRequest(createRequest())
+                .thenValue([recordLatency](HttpResponse response) {
+                    recordLatency(response);
+                    return response;
+                });
+    }
+
+    // First completed request wins and cancels the other one.
+    struct HedgeState {
+        std::mutex mutex;
+        folly::Promise<HttpResponse> promise;
+        bool done{};
+        std::optional<folly::Future<folly::Unit>> requests[2];
+    };
+    auto state = std::make_shared<HedgeState>();
+    auto settle = [this, state, recordLatency](int index, folly::Try<HttpResponse> result) {
+        std::optional<folly::Future<folly::Unit>> loser;
+        {
+            std::lock_guard<std::mutex> lock{state->mutex};
+            if (state->done) {
+                return;
+            }
+            state->done = true;
+            loser.swap(state->requests[1 - index]);
+        }
+        if (loser) {
+            loser->cancel();
+        }
+        if (index == 1) {
+            numHedgeWins.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (result.hasValue()) {
+            recordLatency(result.value());
+        }
+        state->promise.setTry(std::move(result));
+    };
+
+    auto future = state->promise.getFuture();
+    auto primary = httpClient->makeRequest(createRequest())
+                           .thenTry([settle](folly::Try<HttpResponse> result) {
+                               settle(0, std::move(result));
+                           });
+    {
+        std::lock_guard<std::mutex> lock{state->mutex};
+        if (!state->done) {
+            state->requests[0].emplace(std::move(primary));
+        }
+    }
+
+    folly::futures::sleepUnsafe(*delay).thenValue(
+            [this, state, settle, createRequest = std::move(createRequest)](folly::Unit) {
+                {
+                    std::lock_guard<std::mutex> lock{state->mutex};
+                    if (state->done) {
+                        return;
+                    }
+                }
+                numHedgedRequests.fetch_add(1, std::memory_order_relaxed);
+                auto hedge = httpClient->makeRequest(createRequest())
+                                     .thenTry([settle](folly::Try<HttpResponse> result) {
+                                         settle(1, std::move(result));
+                                     });
+                std::lock_guard<std::mutex> lock{state->mutex};
+                if (state->done) {
+                    // Primary won while the hedge was sent.
+                    hedge.cancel();
+                } else {
+                    state->requests[1].emplace(std::move(hedge));
+                }
+            });
+    return future;
+}
+
+S3ClientStats S3ClientImpl::getStats() const {
+    S3ClientStats stats;
+    stats.getRequests = numGetRequests.load(std::memory_order_relaxed);
+    stats.hedgedRequests = numHedgedRequests.load(std::memory_order_relaxed);
+    stats.hedgeWins = numHedgeWins.load(std::memory_order_relaxed);
+    stats.retries = numRetries.load(std::memory_order_relaxed);
+    stats.retryBudgetExhausted = numRetryBudgetExhausted.load(std::memory_order_relaxed);
+    stats.rangesRequested = numRangesRequested.load(std::memory_order_relaxed);
+    stats.rangeRequestsSaved = numRangeRequestsSaved.load(std::memory_order_relaxed);
+    stats.rangeExtraBytes = numRangeExtraBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+folly::Future<S3GetObjectStream> S3ClientImpl::getObjectStream(const S3GetObjectRequest &req) {
+    HttpRequest request = createGetObjectRequest(req);
+    return httpClient->makeStreamingRequest(std::move(request))
+            .thenValue([](HttpStreamResponse response) {
+                return S3GetObjectStream{std::move(response)};
+            });
+}
+
+folly::Future<HttpResponse> S3ClientImpl::sendWithBody(
+        std::function<HttpRequest()> createRequest,
+        size_t bodySize) {
+    constexpr size_t kMaxInlineHashSize = 64 * 1024;
+    if (config.unsignedPayload || bodySize <= kMaxInlineHashSize) {
+        return httpClient->makeRequest(createRequest());
+    }
+    return folly::via(folly::getGlobalCPUExecutor(), [this, createRequest] {
+        return httpClient->makeRequest(createRequest());
+    });
+}
+
+folly::Future<S3PutObject> S3ClientImpl::putObject(const S3PutObjectRequest &req) {
+    // Each attempt is signed at send time, request fields must be owned. Body is not copied.
+    auto createRequest = [this,
+                          bucket = std::string{req.bucket},
+                          key = std::string{req.key},
+                          contentType = std::string{req.contentType},
+                          body = req.body] {
+        S3Request s3Req;
+        s3Req.method = HttpMethod::PUT;
+        s3Req.body = body;
+        s3Req.unsignedPayload = config.unsignedPayload;
+        s3Req.headers.add(makeHeader("content-type", contentType));
+        setObject(s3Req, bucket, key);
+        return signRequest(s3Req);
+    };
+    auto send = [this, bodySize = req.body.size(), createRequest = std::move(createRequest)] {
+        return sendWithBody(createRequest, bodySize);
+    };
+    auto limited = limitConcurrency(req.bucket, req.key, std::move(send));
+    return makeRetriedRequest(HttpMethod::PUT, std::move(limited))
+            .thenValue([](HttpResponse response) { return S3PutObject{std::move(response)}; });
+}
+
+folly::Future<S3CreateMultipartUpload> S3ClientImpl::createMultipartUpload(
+        const S3PutObjectRequest &req) {
+    S3Request s3Req;
+    s3Req.method = HttpMethod::POST;
+    s3Req.headers.add(makeHeader("content-type", req.contentType));
+    setObject(s3Req, req.bucket, req.key);
+    s3Req.setQuery("uploads=");
+    HttpRequest request = signRequest(s3Req);
+    // POST is not retried: a retry would start another upload.
+    return httpClient->makeRequest(std::move(request)).thenValue([](HttpResponse response) {
+        return S3CreateMultipartUpload{std::move(response)};
+    });
+}
+
+folly::Future<S3PutObject> S3ClientImpl::uploadPart(const S3UploadPartRequest &req) {
+    std::string query{"partNumber="};
+    query.append(std::to_string(req.partNumber));
+    query.append("&uploadId=");
+    query.append(encodeS3Uri(req.uploadId, true));
+    auto createRequest = [this,
+                          bucket = std::string{req.bucket},
+                          key = std::string{req.key},
+                          query = std::move(query),
+                          body = req.body] {
+        S3Request s3Req;
+        s3Req.method = HttpMethod::PUT;
+        s3Req.body = body;
+        s3Req.unsignedPayload = config.unsignedPayload;
+        setObject(s3Req, bucket, key);
+        s3Req.setQuery(query);
+        return signRequest(s3Req);
+    };
+    auto send = [this, bodySize = req.body.size(), createRequest = std::move(createRequest)] {
+        return sendWithBody(createRequest, bodySize);
+    };
+    auto limited = limitConcurrency(req.bucket, req.key, std::move(send));
+    return makeRetriedRequest(HttpMethod::PUT, std::move(limited))
+            .thenValue([](HttpResponse response) { return S3PutObject{std::move(response)}; });
+}
+
+folly::Future<S3PutObject> S3ClientImpl::completeMultipartUpload(
+        const S3CompleteMultipartUploadRequest &req) {
+    std::string xml{"<CompleteMultipartUpload>"};
+    for (const S3CompletedPart &part : req.parts) {
+        xml.append("<Part><PartNumber>");
+        xml.append(std::to_string(part.partNumber));
+        xml.append("</PartNumber><ETag>");
+        appendXmlEscaped(xml, part.etag);
+        xml.append("</ETag></Part>");
+    }
+    xml.append("</CompleteMultipartUpload>");
+
+    S3Request s3Req;
+    s3Req.method = HttpMethod::POST;
+    s3Req.body = ByteSpan{xml.data(), xml.size()};
+    setObject(s3Req, req.bucket, req.key);
+    s3Req.setQuery(std::string{"uploadId="}.append(encodeS3Uri(req.uploadId, true)));
+    HttpRequest request = signRequest(s3Req);
+    // Request owns the body, it's sent after this function returns.
+    request.ownedBody.append(xml);
+    request.body = ByteSpan{request.ownedBody.data(), request.ownedBody.size()};
     return httpClient->makeRequest(std::move(request)).thenValue([](HttpResponse response) {
-        return S3GetObject{std::move(response)};
+        return S3PutObject{std::move(response)};
     });
 }
 
+folly::Future<S3AbortMultipartUpload> S3ClientImpl::abortMultipartUpload(
+        std::string_view bucket,
+        std::string_view key,
+        std::string_view uploadId) {
+    auto send = [this,
+                 bucket = std::string{bucket},
+                 key = std::string{key},
+                 query = std::string{"uploadId="}.append(encodeS3Uri(uploadId, true))] {
+        S3Request s3Req;
+        s3Req.method = HttpMethod::DELETE;
+        setObject(s3Req, bucket, key);
+        s3Req.setQuery(query);
+        return httpClient->makeRequest(signRequest(s3Req));
+    };
+    return makeRetriedRequest(HttpMethod::DELETE, std::move(send))
+            .thenValue([](HttpResponse response) {
+                return S3AbortMultipartUpload{std::move(response)};
+            });
+}
+
+folly::Future<S3DeleteObjectsBatch> S3ClientImpl::deleteBatch(
+        std::string_view bucket,
+        std::span<const std::string> keys) {
+    auto xml = std::make_shared<const std::string>(getS3DeleteXml(keys));
+    auto createRequest = [this,
+                          bucket = std::string{bucket},
+                          md5 = getContentMd5(ByteSpan{xml->data(), xml->size()}),
+                          xml] {
+        S3Request s3Req;
+        s3Req.method = HttpMethod::POST;
+        s3Req.body = ByteSpan{xml->data(), xml->size()};
+        s3Req.unsignedPayload = config.unsignedPayload;
+        s3Req.headers.add(makeHeader("content-md5", md5));
+        s3Req.headers.add(makeHeader("content-type", "application/xml"));
+        setObject(s3Req, bucket, "");
+        s3Req.setQuery("delete=");
+        HttpRequest request = signRequest(s3Req);
+        request.ownedBody.append(*xml);
+        request.body = ByteSpan{request.ownedBody.data(), request.ownedBody.size()};
+        return request;
+    };
+    auto send = [this, bodySize = xml->size(), createRequest = std::move(createRequest)] {
+        return sendWithBody(createRequest, bodySize);
+    };
+    auto limited = limitConcurrency(bucket, keys.front(), std::move(send));
+    // Deleting the same keys again is harmless, the POST is retried like a DELETE.
+    return makeRetriedRequest(config.retry.maxAttempts, std::move(limited))
+            .thenValue([](HttpResponse response) {
+                return S3DeleteObjectsBatch{std::move(response)};
+            });
+}
+
+folly::Future<S3DeleteObjects> S3ClientImpl::deleteObjects(const S3DeleteObjectsRequest &req) {
+    CHECK(req.batchSize > 0 && req.batchSize <= 1000 && req.maxConcurrentBatches > 0);
+    auto batches = std::make_shared<DeleteBatches>();
+    batches->bucket = req.bucket;
+    batches->keys = req.keys;
+    batches->batchSize = req.batchSize;
+    size_t numBatches = (req.keys.size() + req.batchSize - 1) / req.batchSize;
+    size_t numWorkers = std::min<size_t>(req.maxConcurrentBatches, numBatches);
+    std::vector<folly::Future<folly::Unit>> workers;
+    workers.reserve(numWorkers);
+    for (size_t i = 0; i < numWorkers; i++) {
+        workers.push_back(deleteBatches(batches));
+    }
+    return folly::collectAllUnsafe(workers).thenValue(
+            [batches](std::vector<folly::Try<folly::Unit>> results) {
+                for (auto &result : results) {
+                    if (result.hasException()) {
+                        return folly::makeFuture<S3DeleteObjects>(result.exception());
+                    }
+                }
+                return folly::makeFuture(std::move(batches->result));
+            });
+}
+
+folly::Future<folly::Unit> S3ClientImpl::deleteBatches(std::shared_ptr<DeleteBatches> batches) {
+    size_t offset = batches->nextBatch.fetch_add(1, std::memory_order_relaxed)
+            * batches->batchSize;
+    if (offset >= batches->keys.size()) {
+        return folly::makeFuture();
+    }
+    auto keys = batches->keys.subspan(
+            offset, std::min(batches->batchSize, batches->keys.size() - offset));
+    return deleteBatch(batches->bucket, keys)
+            .thenTry([this, batches, keys](folly::Try<S3DeleteObjectsBatch> batch) {
+                if (batch.hasException()) {
+                    // Only this batch failed, the workers go on with the next ones.
+                    std::string message = batch.exception().what().toStdString();
+                    LOG(ERROR) << "Failed DeleteObjects: " << message;
+                    addFailedBatch(
+                            *batches, keys, 0, S3DeleteError{"", "RequestFailed", message});
+                } else if (!is2xx(batch->status)) {
+                    addFailedBatch(*batches, keys, batch->status, batch->errors.front());
+                } else {
+                    std::lock_guard lock{batches->mutex};
+                    S3DeleteObjects &result = batches->result;
+                    result.numBatches++;
+                    result.numDeleted += static_cast<long>(keys.size() - batch->errors.size());
+                    std::move(
+                            batch->errors.begin(),
+                            batch->errors.end(),
+                            std::back_inserter(result.errors));
+                }
+                return deleteBatches(batches);
+            });
+}
+
+void S3ClientImpl::addFailedBatch(
+        DeleteBatches &batches,
+        std::span<const std::string> keys,
+        long status,
+        const S3DeleteError &error) {
+    std::lock_guard lock{batches.mutex};
+    S3DeleteObjects &result = batches.result;
+    result.numBatches++;
+    if (is2xx(result.status)) {
+        result.status = status;
+    }
+    for (const std::string &key : keys) {
+        result.errors.push_back(S3DeleteError{key, error.code, error.message});
+    }
+}
+
+folly::Future<S3PutObject> S3ClientImpl::uploadObject(const S3UploadObjectRequest &req) {
+    CHECK(req.partSize > 0 && req.maxConcurrentParts > 0);
+    if (req.body.size() <= static_cast<size_t>(req.partSize)) {
+        S3PutObjectRequest put{req.bucket, req.key};
+        put.body = req.body;
+        put.contentType = req.contentType;
+        return putObject(put);
+    }
+
+    auto upload = std::make_shared<MultipartUpload>();
+    upload->bucket = req.bucket;
+    upload->key = req.key;
+    upload->body = req.body;
+    upload->partSize = req.partSize;
+    upload->parts.resize((req.body.size() + req.partSize - 1) / req.partSize);
+
+    S3PutObjectRequest create{req.bucket, req.key};
+    create.contentType = req.contentType;
+    return createMultipartUpload(create).thenValue(
+            [this, upload, maxConcurrentParts = req.maxConcurrentParts](
+                    S3CreateMultipartUpload created) {
+                if (!is2xx(created.status)) {
+                    HttpResponse response;
+                    response.status = created.status;
+                    return folly::makeFuture(S3PutObject{std::move(response)});
+                }
+                upload->uploadId = std::move(created.uploadId);
+                size_t numWorkers =
+                        std::min<size_t>(maxConcurrentParts, upload->parts.size());
+                std::vector<folly::Future<folly::Unit>> workers;
+                workers.reserve(numWorkers);
+                for (size_t i = 0; i < numWorkers; i++) {
+                    workers.push_back(uploadParts(upload));
+                }
+                return folly::collectAllUnsafe(workers).thenValue(
+                        [this, upload](std::vector<folly::Try<folly::Unit>> results) {
+                            for (auto &result : results) {
+                                if (result.hasException()) {
+                                    return abortAndReturn(
+                                            upload,
+                                            folly::Try<S3PutObject>{result.exception()});
+                                }
+                            }
+                            return finishMultipartUpload(upload);
+                        });
+            });
+}
+
+folly::Future<folly::Unit> S3ClientImpl::uploadParts(std::shared_ptr<MultipartUpload> upload) {
+    size_t index = upload->nextPart.fetch_add(1, std::memory_order_relaxed);
+    if (index >= upload->parts.size() || upload->failedStatus.load(std::memory_order_relaxed)) {
+        return folly::makeFuture();
+    }
+    size_t offset = index * upload->partSize;
+    S3UploadPartRequest part;
+    part.bucket = upload->bucket;
+    part.key = upload->key;
+    part.uploadId = upload->uploadId;
+    part.partNumber = static_cast<int>(index + 1);
+    part.body = upload->body.subspan(
+            offset, std::min<size_t>(upload->partSize, upload->body.size() - offset));
+    return uploadPart(part).thenTry(
+            [this, upload, index](folly::Try<S3PutObject> result) -> folly::Future<folly::Unit> {
+                if (result.hasException()) {
+                    // Stops other workers
+                    upload->failedStatus.store(-1, std::memory_order_relaxed);
+                    return folly::makeFuture<folly::Unit>(result.exception());
+                }
+                if (!is2xx(result.value().status)) {
+                    upload->failedStatus.store(result.value().status, std::memory_order_relaxed);
+                    return folly::makeFuture();
+                }
+                S3CompletedPart &completed = upload->parts[index];
+                completed.partNumber = static_cast<int>(index + 1);
+                completed.etag = std::move(result.value().etag);
+                return uploadParts(upload);
+            });
+}
+
+folly::Future<S3PutObject> S3ClientImpl::finishMultipartUpload(
+        std::shared_ptr<MultipartUpload> upload) {
+    if (long status = upload->failedStatus.load(std::memory_order_relaxed)) {
+        HttpResponse response;
+        response.status = status;
+        return abortAndReturn(upload, folly::Try<S3PutObject>{S3PutObject{std::move(response)}});
+    }
+    S3CompleteMultipartUploadRequest complete;
+    complete.bucket = upload->bucket;
+    complete.key = upload->key;
+    complete.uploadId = upload->uploadId;
+    complete.parts = std::move(upload->parts);
+    return completeMultipartUpload(complete).thenTry(
+            [this, upload](folly::Try<S3PutObject> result) -> folly::Future<S3PutObject> {
+                if (result.hasValue() && is2xx(result.value().status)) {
+                    return folly::makeFuture(std::move(result.value()));
+                }
+                return abortAndReturn(upload, std::move(result));
+            });
+}
+
+folly::Future<S3PutObject> S3ClientImpl::abortAndReturn(
+        std::shared_ptr<MultipartUpload> upload,
+        folly::Try<S3PutObject> result) {
+    // Uploaded parts are stored (and billed) until the upload is aborted.
+    return abortMultipartUpload(upload->bucket, upload->key, upload->uploadId)
+            .thenTry([result = std::move(result)](folly::Try<S3AbortMultipartUpload>) mutable {
+                return std::move(result).value();
+            });
+}
+
+folly::Future<S3ListObjects> S3ClientImpl::listObjectsPage(const S3ListObjectsRequest &req) {
+    auto send = [this, bucket = std::string{req.bucket}, query = req.getQuery()] {
+        S3Request s3Req;
+        s3Req.method = HttpMethod::GET;
+        setObject(s3Req, bucket, "");
+        s3Req.setQuery(query);
+        return httpClient->makeRequest(signRequest(s3Req));
+    };
+    auto limited = limitConcurrency(req.bucket, req.prefix, std::move(send));
+    return makeRetriedRequest(HttpMethod::GET, std::move(limited))
+            .thenValue([](HttpResponse response) { return S3ListObjects{std::move(response)}; });
+}
+
+folly::Future<S3ListObjectsResult> S3ClientImpl::listObjects(
+        const S3ListObjectsRequest &req,
+        S3ListObjectsCallback onPage) {
+    auto list = std::make_shared<ListPages>();
+    list->bucket = req.bucket;
+    list->prefix = req.prefix;
+    list->delimiter = req.delimiter;
+    list->continuationToken = req.continuationToken;
+    list->maxKeys = req.maxKeys;
+    list->onPage = std::move(onPage);
+    return listPages(std::move(list));
+}
+
+folly::Future<S3ListObjectsResult> S3ClientImpl::listPages(std::shared_ptr<ListPages> list) {
+    S3ListObjectsRequest req{list->bucket, list->prefix};
+    req.delimiter = list->delimiter;
+    req.continuationToken = list->continuationToken;
+    req.maxKeys = list->maxKeys;
+    return listObjectsPage(req).thenValue(
+            [this, list](S3ListObjects page) -> folly::Future<S3ListObjectsResult> {
+                S3ListObjectsResult &result = list->result;
+                result.numPages++;
+                if (!is2xx(page.status)) {
+                    result.status = page.status;
+                    return folly::makeFuture(result);
+                }
+                result.numObjects += page.objects.size();
+                // Callback may take the page apart.
+                list->continuationToken = std::move(page.nextContinuationToken);
+                list->onPage(page);
+                if (list->continuationToken.empty()) {
+                    result.status = 200;
+                    return folly::makeFuture(result);
+                }
+                return listPages(list);
+            });
+}
+
+folly::Future<S3ListObjectsResult> S3ClientImpl::listObjectsParallel(
+        const S3ListObjectsRequest &req,
+        S3ListObjectsCallback onPage) {
+    CHECK(req.maxConcurrency > 0);
+    auto list = std::make_shared<ParallelList>();
+    list->bucket = req.bucket;
+    list->maxKeys = req.maxKeys;
+    list->fanOutDepth = req.fanOutDepth;
+    list->maxConcurrency = req.maxConcurrency;
+    list->onPage = std::move(onPage);
+    list->result.status = 200;
+    list->pending.emplace_back(std::string{req.prefix}, 0);
+    auto future = list->promise.getFuture();
+    listPending(std::move(list));
+    return future;
+}
+
+void S3ClientImpl::listPending(std::shared_ptr<ParallelList> list) {
+    std::vector<std::pair<std::string, int>> started;
+    {
+        std::lock_guard<std::mutex> lock{list->mutex};
+        while (list->numActive < list->maxConcurrency && !list->pending.empty()) {
+            started.push_back(std::move(list->pending.front()));
+            list->pending.pop_front();
+            list->numActive++;
+        }
+    }
+    for (auto &[prefix, depth] : started) {
+        listPrefix(list, std::move(prefix), depth);
+    }
+}
+
+void S3ClientImpl::listPrefix(std::shared_ptr<ParallelList> list, std::string prefix, int depth) {
+    bool fanOut = depth < list->fanOutDepth;
+    auto prefixes = std::make_shared<std::vector<std::string>>();
+    auto pages = std::make_shared<ListPages>();
+    pages->bucket = list->bucket;
+    pages->prefix = std::move(prefix);
+    pages->delimiter = fanOut ? "/" : "";
+    pages->maxKeys = list->maxKeys;
+    pages->onPage = [list, prefixes](S3ListObjects &page) {
+        for (std::string &commonPrefix : page.commonPrefixes) {
+            prefixes->push_back(std::move(commonPrefix));
+        }
+        page.commonPrefixes.clear();
+        list->onPage(page);
+    };
+    listPages(std::move(pages))
+            .thenTry([this, list, prefixes, depth](folly::Try<S3ListObjectsResult> result) {
+                bool done = false;
+                {
+                    std::lock_guard<std::mutex> lock{list->mutex};
+                    list->numActive--;
+                    S3ListObjectsResult &total = list->result;
+                    if (result.hasException()) {
+                        list->error = result.exception();
+                    } else {
+                        total.numObjects += result.value().numObjects;
+                        total.numPages += result.value().numPages;
+                        if (!is2xx(result.value().status) && is2xx(total.status)) {
+                            total.status = result.value().status;
+                        }
+                    }
+                    if (list->error || !is2xx(total.status)) {
+                        // Failed: finish listings in flight, start no more.
+                        list->pending.clear();
+                    } else {
+                        for (std::string &commonPrefix : *prefixes) {
+                            list->pending.emplace_back(std::move(commonPrefix), depth + 1);
+                        }
+                    }
+                    done = list->pending.empty() && list->numActive == 0;
+                }
+                if (!done) {
+                    listPending(list);
+                } else if (list->error) {
+                    list->promise.setException(list->error);
+                } else {
+                    list->promise.setValue(list->result);
+                }
+            });
+}
+
 } // namespace molecula
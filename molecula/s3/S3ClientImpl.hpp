@@ -1,10 +1,21 @@
 #pragma once
 
+#include "molecula/common/LatencyHistogram.hpp"
 #include "molecula/s3/S3Client.hpp"
+#include "molecula/s3/S3ConcurrencyController.hpp"
 #include "molecula/s3/S3Request.hpp"
+#include "molecula/s3/S3Retry.hpp"
 
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace molecula {
 
@@ -14,8 +25,161 @@ public:
     ~S3ClientImpl() override = default;
     folly::Future<S3GetObjectInfo> getObjectInfo(const S3GetObjectInfoRequest &req) override;
     folly::Future<S3GetObject> getObject(const S3GetObjectRequest &req) override;
+    folly::Future<S3GetObject> getObjectParallel(const S3GetObjectParallelRequest &req) override;
+    folly::Future<S3GetRanges> getRanges(const S3GetRangesRequest &req) override;
+    folly::Future<S3GetObjectStream> getObjectStream(const S3GetObjectRequest &req) override;
+    folly::Future<S3ListObjects> listObjectsPage(const S3ListObjectsRequest &req) override;
+    folly::Future<S3ListObjectsResult> listObjects(
+            const S3ListObjectsRequest &req,
+            S3ListObjectsCallback onPage) override;
+    folly::Future<S3ListObjectsResult> listObjectsParallel(
+            const S3ListObjectsRequest &req,
+            S3ListObjectsCallback onPage) override;
+    folly::Future<S3PutObject> putObject(const S3PutObjectRequest &req) override;
+    folly::Future<S3PutObject> uploadObject(const S3UploadObjectRequest &req) override;
+    folly::Future<S3CreateMultipartUpload> createMultipartUpload(
+            const S3PutObjectRequest &req) override;
+    folly::Future<S3PutObject> uploadPart(const S3UploadPartRequest &req) override;
+    folly::Future<S3PutObject> completeMultipartUpload(
+            const S3CompleteMultipartUploadRequest &req) override;
+    folly::Future<S3AbortMultipartUpload> abortMultipartUpload(
+            std::string_view bucket,
+            std::string_view key,
+            std::string_view uploadId) override;
+    folly::Future<S3DeleteObjects> deleteObjects(const S3DeleteObjectsRequest &req) override;
+    S3ClientStats getStats() const override;
 
 private:
+    // Sequential listing, the next page is requested when the previous one arrives.
+    struct ListPages {
+        std::string bucket;
+        std::string prefix;
+        std::string delimiter;
+        std::string continuationToken;
+        int maxKeys{};
+        S3ListObjectsCallback onPage;
+        S3ListObjectsResult result;
+    };
+
+    // Parallel listing: prefixes waiting to be listed, with their depth below the request
+    // prefix. Listing of a prefix above the fan-out depth adds its common prefixes.
+    struct ParallelList {
+        std::string bucket;
+        int maxKeys{};
+        int fanOutDepth{};
+        int maxConcurrency{};
+        S3ListObjectsCallback onPage;
+        folly::Promise<S3ListObjectsResult> promise;
+
+        std::mutex mutex;
+        std::deque<std::pair<std::string, int>> pending;
+        int numActive{};
+        S3ListObjectsResult result;
+        folly::exception_wrapper error;
+    };
+
+    folly::Future<S3ListObjectsResult> listPages(std::shared_ptr<ListPages> list);
+    // Starts pending prefixes up to the concurrency limit.
+    void listPending(std::shared_ptr<ParallelList> list);
+    void listPrefix(std::shared_ptr<ParallelList> list, std::string prefix, int depth);
+    // Parallel GET of one object version. Parts write into their slices of @buffer, which
+    // becomes the result data when all completed. The first failure completes the read and
+    // cancels the parts in flight; the buffer lives until they complete.
+    struct ParallelGet {
+        std::string bucket;
+        std::string key;
+        long partSize{};
+        // Sent with If-Match on each part. Set by part 0 if unknown, before other parts start.
+        std::string etag;
+        std::shared_ptr<ByteBuffer> buffer;
+        folly::Promise<S3GetObject> promise;
+
+        std::mutex mutex;
+        std::vector<std::optional<folly::Future<folly::Unit>>> parts;
+        size_t numCompleted{};
+        bool done{};
+    };
+
+    // Multipart upload in progress. Parts are taken in order by up to maxConcurrentParts
+    // workers; each worker uploads parts one after another.
+    struct MultipartUpload {
+        std::string bucket;
+        std::string key;
+        std::string uploadId;
+        ByteSpan body;
+        long partSize{};
+        std::vector<S3CompletedPart> parts;
+        std::atomic<size_t> nextPart{};
+        // Status of the first failed part, or -1 on exception.
+        std::atomic<long> failedStatus{};
+    };
+
+    // Batches are taken in order by up to maxConcurrentBatches workers.
+    struct DeleteBatches {
+        std::string bucket;
+        std::span<const std::string> keys;
+        size_t batchSize{};
+        std::atomic<size_t> nextBatch{};
+        std::mutex mutex;
+        S3DeleteObjects result;
+    };
+
+    folly::Future<folly::Unit> deleteBatches(std::shared_ptr<DeleteBatches> batches);
+    // Lists all @keys with @error.
+    static void addFailedBatch(
+            DeleteBatches &batches,
+            std::span<const std::string> keys,
+            long status,
+            const S3DeleteError &error);
+    folly::Future<S3DeleteObjectsBatch> deleteBatch(
+            std::string_view bucket,
+            std::span<const std::string> keys);
+    folly::Future<folly::Unit> uploadParts(std::shared_ptr<MultipartUpload> upload);
+    folly::Future<S3PutObject> finishMultipartUpload(std::shared_ptr<MultipartUpload> upload);
+    // Aborts the upload and returns @result.
+    folly::Future<S3PutObject> abortAndReturn(
+            std::shared_ptr<MultipartUpload> upload,
+            folly::Try<S3PutObject> result);
+    // Sends a request with a body. Hashing a large body takes milliseconds, so it is signed on
+    // the CPU executor, not on the caller thread which may be the event loop.
+    folly::Future<HttpResponse> sendWithBody(
+            std::function<HttpRequest()> createRequest,
+            size_t bodySize);
+    HttpRequest signRequest(S3Request &request) const;
+    HttpRequest createGetObjectRequest(const S3GetObjectRequest &req);
+    folly::Future<S3GetObject> getObjectParts(
+            std::string_view bucket,
+            std::string_view key,
+            long size,
+            long partSize,
+            std::string_view etag);
+    // Starts the GET of part @index and keeps its future to cancel it.
+    void getPart(std::shared_ptr<ParallelGet> get, size_t index);
+    // Completes the read on the first failure or the last part. Learns the ETag from part 0 if
+    // it was unknown and starts the other parts.
+    void finishPart(std::shared_ptr<ParallelGet> get, size_t index, folly::Try<S3GetObject> result);
+    // Wraps @send to wait for a slot in the partition of the object. Returns @send as is if
+    // adaptive concurrency is disabled.
+    std::function<folly::Future<HttpResponse>()> limitConcurrency(
+            std::string_view bucket,
+            std::string_view key,
+            std::function<folly::Future<HttpResponse>()> send);
+    // Calls @send again while it fails with a retryable error, within the retry budget. Only
+    // idempotent methods are retried.
+    folly::Future<HttpResponse> makeRetriedRequest(
+            HttpMethod method,
+            std::function<folly::Future<HttpResponse>()> send);
+    // For requests idempotent regardless of the method, like DeleteObjects.
+    folly::Future<HttpResponse> makeRetriedRequest(
+            int maxAttempts,
+            std::function<folly::Future<HttpResponse>()> send);
+    folly::Future<HttpResponse> retryRequest(
+            std::shared_ptr<std::function<folly::Future<HttpResponse>()>> send,
+            int maxAttempts,
+            int attempt);
+    // Sends the request created by @createRequest, and a duplicate if it is slow.
+    folly::Future<HttpResponse> makeHedgedRequest(std::function<HttpRequest()> createRequest);
+    std::optional<std::chrono::microseconds> getHedgeDelay() const;
     void setObject(S3Request &request, std::string_view bucket, std::string_view key) const;
     HttpRequest createHttpRequest(S3Request &request) const;
 
@@ -23,6 +187,18 @@ private:
     folly::Uri endpoint;
     S3SignerV4 signer;
     S3ClientConfig config;
+    S3RetryBudget retryBudget;
+    // Null if adaptive concurrency is disabled.
+    std::unique_ptr<S3ConcurrencyController> concurrency;
+    LatencyHistogram getLatency;
+    std::atomic<long> numGetRequests{};
+    std::atomic<long> numHedgedRequests{};
+    std::atomic<long> numHedgeWins{};
+    std::atomic<long> numRetries{};
+    std::atomic<long> numRetryBudgetExhausted{};
+    std::atomic<long> numRangesRequested{};
+    std::atomic<long> numRangeRequestsSaved{};
+    std::atomic<long> numRangeExtraBytes{};
 };
 
 } // namespace molecula
@@ -0,0 +1,139 @@
+#include "folly/init/Init.h"
+#include "molecula/common/LatencyHistogram.hpp"
+#include "molecula/s3/S3Client.hpp"
+#include "molecula/s3/S3TestServer.hpp"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Range GET throughput and latency percentiles of S3ClientImpl against the loopback S3 test
+// server, with S3-like first byte latency, per connection bandwidth and throttling errors.
+// Deterministic for a given seed and needs no network, e.g. to compare concurrency settings:
+// "--latency_ms=30 --latency_p99_ms=200 --bandwidth_mbps=80 --error_rate=0.01".
+// With an --endpoint the run is repeated with HTTP/2 multiplexing, e.g.
+// "--endpoint=https://gateway:9000 --range_kb=64 --max_host_connections=4". The test server
+// speaks HTTP/1.1 only. Rows are labelled with the protocol negotiated, not the one asked for.
+DEFINE_int32(object_mb, 256, "Size of the object read");
+DEFINE_int32(range_kb, 1024, "Size of each range GET");
+DEFINE_int32(concurrency, 64, "Number of requests in flight");
+DEFINE_int32(requests, 4096, "Total number of requests");
+DEFINE_int32(latency_ms, 0, "Median first byte latency");
+DEFINE_int32(latency_p99_ms, 0, "99th percentile first byte latency");
+DEFINE_int32(bandwidth_mbps, 0, "Bandwidth of each connection in MB/s, zero for no limit");
+DEFINE_double(error_rate, 0.0, "Fraction of requests failed with 503 SlowDown");
+DEFINE_int32(max_attempts, 4, "Attempts per request, including retries");
+DEFINE_string(endpoint, "", "S3 endpoint to read from instead of the loopback test server");
+DEFINE_string(access_key, "benchmark", "Access key of --endpoint");
+DEFINE_string(secret_key, "benchmark", "Secret key of --endpoint");
+DEFINE_string(bucket, "bucket", "Bucket of --endpoint the object is written to");
+DEFINE_bool(http2_prior_knowledge, false, "Use HTTP/2 without negotiation, for http:// (h2c)");
+DEFINE_int32(max_streams, 100, "Max streams per HTTP/2 connection");
+DEFINE_int32(max_host_connections, 0, "Max connections to the endpoint, zero for no limit");
+
+namespace molecula {
+
+static void runBenchmark(std::optional<S3TestServer> &server, HttpVersion httpVersion) {
+    HttpClientConfig httpConfig;
+    httpConfig.httpVersion = httpVersion;
+    httpConfig.maxConcurrentStreams = FLAGS_max_streams;
+    httpConfig.maxHostConnections = FLAGS_max_host_connections;
+    auto http = createHttpClientCurl(httpConfig);
+    CHECK(http) << "Failed to create HTTP client";
+    std::string endpoint = server ? server->getEndpoint() : FLAGS_endpoint;
+    S3ClientConfig config;
+    config.endpoint = endpoint;
+    config.accessKey = FLAGS_access_key;
+    config.secretKey = FLAGS_secret_key;
+    config.region = "us-east-1";
+    config.retry.maxAttempts = FLAGS_max_attempts;
+    auto s3 = createS3Client(http.get(), config);
+
+    long objectSize = FLAGS_object_mb * 1024L * 1024;
+    std::string data(objectSize, 'x');
+    if (server) {
+        server->putObject(FLAGS_bucket, "object", data);
+    } else {
+        S3PutObjectRequest put{FLAGS_bucket, "object"};
+        put.body = data;
+        CHECK(is2xx(s3->putObject(put).get().status)) << "Failed to write the object";
+    }
+
+    long rangeSize = FLAGS_range_kb * 1024L;
+    long numRanges = std::max(1L, objectSize / rangeSize);
+    LatencyHistogram latency{static_cast<uint64_t>(FLAGS_requests)};
+    std::atomic<int> next{};
+    std::atomic<long> bytes{};
+    std::atomic<long> failed{};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < FLAGS_concurrency; t++) {
+        threads.emplace_back([&] {
+            for (int i; (i = next.fetch_add(1)) < FLAGS_requests;) {
+                S3GetObjectRequest req{FLAGS_bucket, "object"};
+                long offset = (i % numRanges) * rangeSize;
+                req.setRange(offset, std::min(offset + rangeSize, objectSize) - 1);
+                auto requestStart = std::chrono::steady_clock::now();
+                S3GetObject get = s3->getObject(req).get();
+                latency.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - requestStart));
+                if (is2xx(get.status)) {
+                    bytes += get.size;
+                } else {
+                    failed++;
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    auto stats = s3->getStats();
+    auto httpStats = http->getStats();
+    // CURL falls back to HTTP/1.1 when the server doesn't negotiate HTTP/2.
+    std::printf(
+            "http=%-3s requests=%d failed=%ld %8.3f GB/s  p50=%.1fms p99=%.1fms p999=%.1fms  "
+            "retries=%ld connections=%ld h2 transfers=%ld\n",
+            httpStats.http2Transfers == 0 ? "1.1" : "2",
+            FLAGS_requests,
+            failed.load(),
+            bytes / elapsed.count() / 1e9,
+            latency.getPercentile(0.5).count() / 1e3,
+            latency.getPercentile(0.99).count() / 1e3,
+            latency.getPercentile(0.999).count() / 1e3,
+            stats.retries,
+            httpStats.newConnections,
+            httpStats.http2Transfers);
+}
+
+} // namespace molecula
+
+int main(int argc, char **argv) {
+    folly::Init init(&argc, &argv);
+    std::optional<molecula::S3TestServer> server;
+    if (FLAGS_endpoint.empty()) {
+        molecula::S3TestServerConfig serverConfig;
+        serverConfig.latency.median = std::chrono::milliseconds{FLAGS_latency_ms};
+        serverConfig.latency.p99 = std::chrono::milliseconds{FLAGS_latency_p99_ms};
+        serverConfig.bandwidth = FLAGS_bandwidth_mbps * 1'000'000L;
+        serverConfig.errorRate = FLAGS_error_rate;
+        server.emplace(serverConfig);
+    }
+    molecula::runBenchmark(server, molecula::HttpVersion::Http1);
+    if (!server) {
+        molecula::runBenchmark(
+                server,
+                FLAGS_http2_prior_knowledge ? molecula::HttpVersion::Http2PriorKnowledge
+                                            : molecula::HttpVersion::Http2);
+    }
+    return 0;
+}
@@ -39,4 +39,155 @@ GTEST_TEST(S3, S3Id_Errors) {
     EXPECT_TRUE(S3Id::fromString("s3://").empty());
 }
 
+GTEST_TEST(S3, coalesceS3Ranges) {
+    std::vector<S3Range> ranges{{100, 10}, {0, 10}, {15, 5}, {1000, 10}, {105, 20}, {50, 0}};
+    auto merged = coalesceS3Ranges(ranges, 10, 1000);
+    ASSERT_EQ(merged.size(), 3);
+
+    EXPECT_EQ(merged[0].range.offset, 0);
+    EXPECT_EQ(merged[0].range.size, 20);
+    EXPECT_EQ(merged[0].parts, (std::vector<size_t>{1, 2}));
+    EXPECT_EQ(merged[0].gapBytes, 5);
+
+    // Overlapping ranges
+    EXPECT_EQ(merged[1].range.offset, 100);
+    EXPECT_EQ(merged[1].range.size, 25);
+    EXPECT_EQ(merged[1].parts, (std::vector<size_t>{0, 4}));
+    EXPECT_EQ(merged[1].gapBytes, 0);
+
+    EXPECT_EQ(merged[2].range.offset, 1000);
+    EXPECT_EQ(merged[2].parts, (std::vector<size_t>{3}));
+}
+
+GTEST_TEST(S3, coalesceS3Ranges_MaxSize) {
+    std::vector<S3Range> ranges{{0, 10}, {10, 10}, {20, 10}};
+    auto merged = coalesceS3Ranges(ranges, 100, 20);
+    ASSERT_EQ(merged.size(), 2);
+    EXPECT_EQ(merged[0].range.size, 20);
+    EXPECT_EQ(merged[1].range.offset, 20);
+
+    EXPECT_TRUE(coalesceS3Ranges({}, 100, 20).empty());
+}
+
+GTEST_TEST(S3, S3ListObjectsRequest_Query) {
+    S3ListObjectsRequest req{"bucket", "warehouse/db 1/"};
+    EXPECT_EQ(req.getQuery(), "list-type=2&max-keys=1000&prefix=warehouse%2Fdb%201%2F");
+
+    req.delimiter = "/";
+    req.continuationToken = "1ueGcxLPRx1Tr/XYExHnhbYLgveDs2J/wm36Hy4vbOwM=";
+    req.maxKeys = 10;
+    EXPECT_EQ(
+            req.getQuery(),
+            "continuation-token=1ueGcxLPRx1Tr%2FXYExHnhbYLgveDs2J%2Fwm36Hy4vbOwM%3D&"
+            "delimiter=%2F&list-type=2&max-keys=10&prefix=warehouse%2Fdb%201%2F");
+}
+
+GTEST_TEST(S3, S3ListObjects) {
+    HttpResponse response;
+    response.status = 200;
+    response.body.append(
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<ListBucketResult xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">"
+            "<Name>bucket</Name><Prefix>t/</Prefix><KeyCount>3</KeyCount>"
+            "<MaxKeys>1000</MaxKeys><Delimiter>/</Delimiter><IsTruncated>true</IsTruncated>"
+            "<NextContinuationToken>token&amp;1</NextContinuationToken>"
+            "<Contents><Key>t/a&amp;b.parquet</Key>"
+            "<LastModified>2025-08-20T07:31:00.000Z</LastModified>"
+            "<ETag>&quot;9b2cf535f27731c974343645a3985328&quot;</ETag>"
+            "<Size>434234</Size><StorageClass>STANDARD</StorageClass></Contents>"
+            "<CommonPrefixes><Prefix>t/data/</Prefix></CommonPrefixes>"
+            "<CommonPrefixes><Prefix>t/metadata/</Prefix></CommonPrefixes>"
+            "</ListBucketResult>");
+    S3ListObjects page{std::move(response)};
+    EXPECT_EQ(page.status, 200);
+    ASSERT_EQ(page.objects.size(), 1);
+    EXPECT_EQ(page.objects[0].key, "t/a&b.parquet");
+    EXPECT_EQ(page.objects[0].size, 434234);
+    EXPECT_EQ(page.objects[0].etag, "\"9b2cf535f27731c974343645a3985328\"");
+    EXPECT_EQ(page.objects[0].lastModified, 1'755'675'060L);
+    EXPECT_EQ(page.commonPrefixes, (std::vector<std::string>{"t/data/", "t/metadata/"}));
+    EXPECT_EQ(page.nextContinuationToken, "token&1");
+}
+
+GTEST_TEST(S3, getS3DeleteXml) {
+    std::vector<std::string> keys{"t/a.parquet", "t/a&b<c>.parquet"};
+    EXPECT_EQ(
+            getS3DeleteXml(keys),
+            "<Delete><Quiet>true</Quiet>"
+            "<Object><Key>t/a.parquet</Key></Object>"
+            "<Object><Key>t/a&amp;b&lt;c&gt;.parquet</Key></Object>"
+            "</Delete>");
+}
+
+GTEST_TEST(S3, S3DeleteObjectsBatch) {
+    HttpResponse response;
+    response.status = 200;
+    response.body.append(
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<DeleteResult xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">"
+            "<Error><Key>t/a&amp;b.parquet</Key><Code>AccessDenied</Code>"
+            "<Message>Access Denied</Message></Error>"
+            "<Error><Key>t/c.parquet</Key><Code>InternalError</Code>"
+            "<Message>We encountered an internal error. Please try again.</Message></Error>"
+            "</DeleteResult>");
+    S3DeleteObjectsBatch batch{std::move(response)};
+    EXPECT_EQ(batch.status, 200);
+    ASSERT_EQ(batch.errors.size(), 2);
+    EXPECT_EQ(batch.errors[0].key, "t/a&b.parquet");
+    EXPECT_EQ(batch.errors[0].code, "AccessDenied");
+    EXPECT_EQ(batch.errors[0].message, "Access Denied");
+    EXPECT_EQ(batch.errors[1].key, "t/c.parquet");
+    EXPECT_EQ(batch.errors[1].code, "InternalError");
+}
+
+GTEST_TEST(S3, S3DeleteObjectsBatch_Failed) {
+    HttpResponse response;
+    response.status = 400;
+    response.body.append(
+            "<Error><Code>InvalidDigest</Code>"
+            "<Message>The Content-MD5 you specified was invalid.</Message></Error>");
+    S3DeleteObjectsBatch batch{std::move(response)};
+    EXPECT_EQ(batch.status, 400);
+    ASSERT_EQ(batch.errors.size(), 1);
+    EXPECT_EQ(batch.errors[0].key, "");
+    EXPECT_EQ(batch.errors[0].code, "InvalidDigest");
+}
+
+GTEST_TEST(S3, S3GetObjectRequest_Range) {
+    S3GetObjectRequest req{"bucket", "key"};
+    EXPECT_FALSE(req.hasRange());
+    // First byte only
+    req.setRange(0, 0);
+    EXPECT_TRUE(req.hasRange());
+    EXPECT_EQ(req.getRangeSize(), 1);
+    EXPECT_EQ(req.getRangeHeader(), "range:bytes=0-0");
+}
+
+GTEST_TEST(S3, formatS3Time) {
+    EXPECT_EQ(formatS3Time(1445412480), "Wed, 21 Oct 2015 07:28:00 GMT");
+    EXPECT_EQ(parseS3Time(formatS3Time(1445412480)), 1445412480);
+}
+
+GTEST_TEST(S3, S3GetObject_Validators) {
+    HttpResponse response;
+    response.status = 200;
+    response.headers.add(makeHeader("etag", "\"abc\""));
+    response.headers.add(makeHeader("last-modified", "Wed, 21 Oct 2015 07:28:00 GMT"));
+    response.body.append("data");
+    S3GetObject get{std::move(response)};
+    EXPECT_EQ(get.etag, "\"abc\"");
+    EXPECT_EQ(get.lastModified, 1445412480);
+}
+
+GTEST_TEST(S3, S3GetObject_PartialBody) {
+    // Timed out after the headers arrived
+    HttpResponse response;
+    response.status = 206;
+    response.error = HttpError::Timeout;
+    response.body.append("da");
+    S3GetObject get{std::move(response)};
+    EXPECT_EQ(get.status, 0);
+    EXPECT_EQ(get.size, 0);
+}
+
 } // namespace molecula
@@ -0,0 +1,184 @@
+#include "molecula/s3/S3ConcurrencyController.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+
+namespace molecula {
+
+S3RequestOutcome getS3RequestOutcome(const folly::Try<HttpResponse> &result) {
+    if (!result.hasValue() || result.value().error != HttpError::None) {
+        return S3RequestOutcome::Failed;
+    }
+    long status = result.value().status;
+    if (status == 429 || status == 503) {
+        return S3RequestOutcome::Throttled;
+    }
+    // Client errors like 404 are still served at full speed.
+    return is5xx(status) ? S3RequestOutcome::Failed : S3RequestOutcome::Success;
+}
+
+std::string getS3Partition(std::string_view bucket, std::string_view key, int depth) {
+    std::string partition{bucket};
+    size_t end = 0;
+    for (int i = 0; i < depth; i++) {
+        size_t slash = key.find('/', end);
+        if (slash == std::string_view::npos) {
+            break;
+        }
+        end = slash + 1;
+    }
+    partition.append("/");
+    partition.append(key.substr(0, end));
+    return partition;
+}
+
+S3ConcurrencyController::S3ConcurrencyController(const S3ConcurrencyConfig &config) :
+    config{config} {}
+
+S3ConcurrencyController::Partition &S3ConcurrencyController::getPartition(
+        const std::string &partition) {
+    auto &p = partitions[partition];
+    if (!p) {
+        p = std::make_unique<Partition>();
+        p->limit = config.initialLimit;
+    }
+    return *p;
+}
+
+folly::Future<folly::Unit> S3ConcurrencyController::acquire(const std::string &partition) {
+    std::lock_guard<std::mutex> lock{mutex};
+    Partition &p = getPartition(partition);
+    if (p.inFlight < static_cast<int>(p.limit)) {
+        p.inFlight++;
+        p.maxInFlight = std::max(p.maxInFlight, p.inFlight);
+        return folly::makeFuture();
+    }
+    Waiter &waiter = p.waiters.emplace_back();
+    waiter.id = ++p.lastWaiterId;
+    waiter.promise.setInterruptHandler(
+            [this, partition, id = waiter.id](const folly::exception_wrapper &e) {
+                cancelWaiter(partition, id, e);
+            });
+    return waiter.promise.getFuture();
+}
+
+void S3ConcurrencyController::cancelWaiter(
+        const std::string &partition,
+        uint64_t id,
+        const folly::exception_wrapper &e) {
+    std::optional<folly::Promise<folly::Unit>> promise;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        auto &waiters = getPartition(partition).waiters;
+        auto it = std::find_if(waiters.begin(), waiters.end(), [id](const Waiter &waiter) {
+            return waiter.id == id;
+        });
+        if (it == waiters.end()) {
+            // Already granted: the slot is released after the request.
+            return;
+        }
+        promise = std::move(it->promise);
+        waiters.erase(it);
+    }
+    promise->setException(e);
+}
+
+void S3ConcurrencyController::release(
+        const std::string &partition,
+        S3RequestOutcome outcome,
+        std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::time_point end,
+        long bytes,
+        std::chrono::microseconds firstByteLatency) {
+    auto latency = firstByteLatency.count() > 0
+            ? firstByteLatency
+            : std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+    std::vector<folly::Promise<folly::Unit>> granted;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        Partition &p = getPartition(partition);
+        p.inFlight--;
+        bool current = start >= p.lastDecrease;
+        if (outcome == S3RequestOutcome::Throttled) {
+            if (current) {
+                decrease(p, end);
+            }
+        } else if (outcome == S3RequestOutcome::Success) {
+            bool spike = p.baseline.count() > 0
+                    && latency.count() > config.latencyTolerance * p.baseline.count();
+            updateBaseline(p, latency);
+            if (current) {
+                if (spike) {
+                    decrease(p, end);
+                } else {
+                    addToRound(p, start, end, bytes);
+                }
+            }
+        }
+
+        while (!p.waiters.empty() && p.inFlight < static_cast<int>(p.limit)) {
+            granted.push_back(std::move(p.waiters.front().promise));
+            p.waiters.pop_front();
+            p.inFlight++;
+            p.maxInFlight = std::max(p.maxInFlight, p.inFlight);
+        }
+    }
+    // Continuations may acquire again, run them outside of the lock.
+    for (auto &promise : granted) {
+        promise.setValue();
+    }
+}
+
+void S3ConcurrencyController::decrease(Partition &p, std::chrono::steady_clock::time_point now) {
+    p.limit = std::max<double>(p.limit * config.decreaseFactor, config.minLimit);
+    p.maxInFlight = p.inFlight;
+    p.lastDecrease = now;
+    p.roundRequests = 0;
+    p.roundBytes = 0;
+    p.lastThroughput = 0;
+}
+
+void S3ConcurrencyController::addToRound(
+        Partition &p,
+        std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::time_point end,
+        long bytes) {
+    if (p.roundRequests == 0) {
+        p.roundStart = std::max(start, p.lastDecrease);
+    }
+    p.roundRequests++;
+    p.roundBytes += bytes;
+    if (p.roundRequests < static_cast<int>(p.limit)) {
+        return;
+    }
+    // Requests per second if the responses have no body.
+    double seconds = std::chrono::duration<double>(end - p.roundStart).count();
+    double work = p.roundBytes > 0 ? p.roundBytes : p.roundRequests;
+    double throughput = seconds > 0 ? work / seconds : 0;
+    // More requests in flight that don't move more bytes only queue up, e.g. on a full link.
+    if (p.maxInFlight >= static_cast<int>(p.limit) && throughput > p.lastThroughput) {
+        p.limit = std::min<double>(p.limit + 1, config.maxLimit);
+    }
+    p.maxInFlight = p.inFlight;
+    p.lastThroughput = throughput;
+    p.roundRequests = 0;
+    p.roundBytes = 0;
+}
+
+void S3ConcurrencyController::updateBaseline(Partition &p, std::chrono::microseconds latency) {
+    if (p.baseline.count() == 0 || latency < p.baseline) {
+        p.baseline = latency;
+    } else {
+        // Drift up slowly, so that a single fast response doesn't make everything a spike.
+        p.baseline += (latency - p.baseline) / 64;
+    }
+}
+
+int S3ConcurrencyController::getLimit(const std::string &partition) const {
+    std::lock_guard<std::mutex> lock{mutex};
+    auto it = partitions.find(partition);
+    return static_cast<int>(it == partitions.end() ? config.initialLimit : it->second->limit);
+}
+
+} // namespace molecula
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "folly/futures/Future.h"
+#include "molecula/s3/S3Client.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace molecula {
+
+enum class S3RequestOutcome {
+    Success,
+    // 429 or 503 SlowDown
+    Throttled,
+    // Other failures don't change the limit.
+    Failed,
+};
+
+S3RequestOutcome getS3RequestOutcome(const folly::Try<HttpResponse> &result);
+
+// Returns "bucket/prefix" with @depth leading key components, not including the object name.
+std::string getS3Partition(std::string_view bucket, std::string_view key, int depth);
+
+// AIMD concurrency limit for each partition. See S3ConcurrencyConfig. Thread safe.
+class S3ConcurrencyController {
+public:
+    explicit S3ConcurrencyController(const S3ConcurrencyConfig &config);
+
+    S3ConcurrencyController(const S3ConcurrencyController &) = delete;
+    S3ConcurrencyController &operator=(const S3ConcurrencyController &) = delete;
+
+    // Completes when a request to @partition may be sent. Every acquire must be followed by
+    // release. Cancelling the future while it waits gives up the place in the queue, it then
+    // fails with the interrupt and takes no slot.
+    folly::Future<folly::Unit> acquire(const std::string &partition);
+    // Request sent at @start completed at @end with @bytes of response body. Its first byte
+    // arrived after @firstByteLatency, zero if unknown: the whole request time is used then.
+    void release(
+            const std::string &partition,
+            S3RequestOutcome outcome,
+            std::chrono::steady_clock::time_point start,
+            std::chrono::steady_clock::time_point end,
+            long bytes = 0,
+            std::chrono::microseconds firstByteLatency = {});
+
+    int getLimit(const std::string &partition) const;
+
+private:
+    struct Waiter {
+        uint64_t id{};
+        folly::Promise<folly::Unit> promise;
+    };
+
+    struct Partition {
+        double limit{};
+        int inFlight{};
+        // Max in flight in the current round: the limit grows only if it's actually used.
+        int maxInFlight{};
+        std::deque<Waiter> waiters;
+        uint64_t lastWaiterId{};
+        // Smoothed low first byte latency, reference for spikes.
+        std::chrono::microseconds baseline{};
+        // Requests sent before the last decrease reflect the old limit and are not counted.
+        std::chrono::steady_clock::time_point lastDecrease;
+        // Successful requests of the current round, the limit grows at most once per round.
+        int roundRequests{};
+        long roundBytes{};
+        std::chrono::steady_clock::time_point roundStart;
+        // Bytes (or requests) per second of the previous round, zero after a decrease.
+        double lastThroughput{};
+    };
+
+    Partition &getPartition(const std::string &partition);
+    // Interrupt of a waiting acquire.
+    void cancelWaiter(const std::string &partition, uint64_t id, const folly::exception_wrapper &e);
+    void decrease(Partition &p, std::chrono::steady_clock::time_point now);
+    // Counts a successful request, at the end of a round the limit may grow.
+    void addToRound(
+            Partition &p,
+            std::chrono::steady_clock::time_point start,
+            std::chrono::steady_clock::time_point end,
+            long bytes);
+    void updateBaseline(Partition &p, std::chrono::microseconds latency);
+
+    const S3ConcurrencyConfig config;
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::unique_ptr<Partition>> partitions;
+};
+
+} // namespace molecula
@@ -0,0 +1,230 @@
+#include "molecula/s3/S3ConcurrencyController.hpp"
+
+#include "molecula/s3/FakeS3Client.hpp"
+#include "molecula/s3/S3TestServer.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace molecula {
+
+namespace {
+// Sends @count GETs of @keys in turn to @test, all through @controller like
+// S3ClientImpl::limitConcurrency, and waits for them.
+void sendGets(
+        S3TestFixture &test,
+        S3ConcurrencyController &controller,
+        const std::vector<std::string> &keys,
+        int count) {
+    std::vector<folly::Future<folly::Unit>> gets;
+    for (int i = 0; i < count; i++) {
+        std::string url = test.endpoint + "/bucket/" + keys[i % keys.size()];
+        gets.push_back(controller.acquire("p").thenValue([&test, &controller, url](folly::Unit) {
+            auto start = std::chrono::steady_clock::now();
+            HttpRequest request;
+            request.url = url;
+            return test.http->makeRequest(std::move(request))
+                    .thenTry([&controller, start](folly::Try<HttpResponse> result) {
+                        const HttpResponse &response = result.value();
+                        controller.release(
+                                "p",
+                                getS3RequestOutcome(result),
+                                start,
+                                std::chrono::steady_clock::now(),
+                                static_cast<long>(response.body.size()),
+                                response.firstByteLatency);
+                    });
+        }));
+    }
+    folly::collectAllUnsafe(gets).get();
+}
+} // namespace
+
+GTEST_TEST(S3ConcurrencyController, getS3Partition) {
+    EXPECT_EQ(getS3Partition("bucket", "table/data/file.parquet", 1), "bucket/table/");
+    EXPECT_EQ(getS3Partition("bucket", "table/data/file.parquet", 2), "bucket/table/data/");
+    EXPECT_EQ(getS3Partition("bucket", "table/data/file.parquet", 5), "bucket/table/data/");
+    EXPECT_EQ(getS3Partition("bucket", "file.parquet", 1), "bucket/");
+    EXPECT_EQ(getS3Partition("bucket", "table/file.parquet", 0), "bucket/");
+}
+
+GTEST_TEST(S3ConcurrencyController, WaitForSlot) {
+    S3ConcurrencyConfig config;
+    config.initialLimit = 2;
+    S3ConcurrencyController controller{config};
+    auto start = std::chrono::steady_clock::now();
+
+    auto first = controller.acquire("p");
+    auto second = controller.acquire("p");
+    auto third = controller.acquire("p");
+    EXPECT_TRUE(first.isReady());
+    EXPECT_TRUE(second.isReady());
+    EXPECT_FALSE(third.isReady());
+    // Other partitions have their own limit
+    EXPECT_TRUE(controller.acquire("q").isReady());
+
+    controller.release("p", S3RequestOutcome::Failed, start, start);
+    EXPECT_TRUE(third.isReady());
+}
+
+GTEST_TEST(S3ConcurrencyController, CancelWaiter) {
+    S3ConcurrencyConfig config;
+    config.initialLimit = 1;
+    S3ConcurrencyController controller{config};
+    auto start = std::chrono::steady_clock::now();
+
+    EXPECT_TRUE(controller.acquire("p").isReady());
+    // Like S3ClientImpl::limitConcurrency: the request is sent when the slot is granted.
+    bool sent = false;
+    auto cancelled = controller.acquire("p").thenValue([&sent](folly::Unit) { sent = true; });
+    auto next = controller.acquire("p");
+    cancelled.cancel();
+    ASSERT_TRUE(cancelled.isReady());
+    EXPECT_TRUE(cancelled.hasException());
+
+    // The slot goes to the next waiter.
+    controller.release("p", S3RequestOutcome::Failed, start, start);
+    EXPECT_FALSE(sent);
+    EXPECT_TRUE(next.isReady());
+    EXPECT_FALSE(controller.acquire("p").isReady());
+}
+
+GTEST_TEST(S3ConcurrencyController, LatencySpike) {
+    S3ConcurrencyConfig config;
+    config.initialLimit = 10;
+    S3ConcurrencyController controller{config};
+    auto start = std::chrono::steady_clock::now();
+    auto fast = start + std::chrono::milliseconds{10};
+    auto slow = start + std::chrono::milliseconds{100};
+
+    controller.acquire("p");
+    controller.release("p", S3RequestOutcome::Success, start, fast);
+    EXPECT_EQ(controller.getLimit("p"), 10);
+
+    controller.acquire("p");
+    controller.release("p", S3RequestOutcome::Success, start, slow);
+    EXPECT_EQ(controller.getLimit("p"), 7);
+}
+
+GTEST_TEST(S3ConcurrencyController, LargeResponses) {
+    // Footers and multi-MB range GETs in one partition have the same first byte latency.
+    S3ConcurrencyConfig config;
+    config.initialLimit = 10;
+    S3ConcurrencyController controller{config};
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100; i++) {
+        bool large = i % 4 == 0;
+        controller.acquire("p");
+        controller.release(
+                "p",
+                S3RequestOutcome::Success,
+                start,
+                start + std::chrono::milliseconds{large ? 500 : 20},
+                large ? 8'000'000 : 16'000,
+                std::chrono::milliseconds{20});
+    }
+    EXPECT_EQ(controller.getLimit("p"), 10);
+}
+
+// Rounds of 1MB GETs, each round sends as many as the controller allows. On a saturated link
+// a round takes longer with each request, otherwise the same time.
+GTEST_TEST(S3ConcurrencyController, ThroughputPlateau) {
+    for (bool saturated : {true, false}) {
+        S3ConcurrencyConfig config;
+        config.initialLimit = 4;
+        S3ConcurrencyController controller{config};
+        auto now = std::chrono::steady_clock::now();
+        for (int round = 0; round < 20; round++) {
+            int limit = controller.getLimit("p");
+            for (int i = 0; i < limit; i++) {
+                controller.acquire("p");
+            }
+            auto end = now + std::chrono::milliseconds{saturated ? 100 * limit : 100};
+            for (int i = 0; i < limit; i++) {
+                controller.release(
+                        "p",
+                        S3RequestOutcome::Success,
+                        now,
+                        end,
+                        1'000'000,
+                        std::chrono::milliseconds{10});
+            }
+            now = end;
+        }
+        // The first round has no throughput to compare with.
+        EXPECT_EQ(controller.getLimit("p"), saturated ? 5 : 24);
+    }
+}
+
+GTEST_TEST(S3ConcurrencyController, TestServer) {
+    // Data GETs take 5 times longer than footer GETs.
+    S3TestServerConfig serverConfig;
+    serverConfig.latency.median = std::chrono::milliseconds{20};
+    serverConfig.latency.p99 = std::chrono::milliseconds{20};
+    serverConfig.bandwidth = 4'000'000;
+    S3TestFixture test{serverConfig};
+    test.server.putObject("bucket", "footer", makeData(1'000));
+    test.server.putObject("bucket", "data", makeData(400'000));
+    std::vector<std::string> keys{"footer", "footer", "footer", "data"};
+
+    S3ConcurrencyConfig config;
+    config.initialLimit = 8;
+    S3ConcurrencyController controller{config};
+    sendGets(test, controller, keys, 200);
+    int limit = controller.getLimit("p");
+    EXPECT_GT(limit, 8);
+
+    test.server.failRequests(20, 503);
+    sendGets(test, controller, keys, 100);
+    EXPECT_LT(controller.getLimit("p"), limit);
+    EXPECT_EQ(test.server.getStats().errors, 20);
+}
+
+// Simulated S3 partition that serves up to @capacity requests at once and throttles the rest
+// with 503 SlowDown. Each round the client sends as many requests as the controller allows.
+GTEST_TEST(S3ConcurrencyController, ConvergesToCapacity) {
+    constexpr int kCapacity = 40;
+    constexpr int kRounds = 500;
+    S3ConcurrencyConfig config;
+    config.initialLimit = 4;
+    S3ConcurrencyController controller{config};
+    auto now = std::chrono::steady_clock::now();
+    auto latency = std::chrono::milliseconds{20};
+
+    long sent = 0;
+    long throttled = 0;
+    long sentLastRounds = 0;
+    for (int round = 0; round < kRounds; round++) {
+        int numRequests = 0;
+        while (controller.acquire("p").isReady()) {
+            numRequests++;
+        }
+        // Released at the end of the round, frees the slot taken by the failed acquire.
+        numRequests++;
+        for (int i = 0; i < numRequests; i++) {
+            bool isThrottled = i >= kCapacity;
+            controller.release(
+                    "p",
+                    isThrottled ? S3RequestOutcome::Throttled : S3RequestOutcome::Success,
+                    now,
+                    now + latency);
+            throttled += isThrottled;
+        }
+        sent += numRequests;
+        if (round >= kRounds - 100) {
+            sentLastRounds += numRequests;
+        }
+        now += latency;
+    }
+
+    int limit = controller.getLimit("p");
+    EXPECT_GE(limit, kCapacity / 2);
+    EXPECT_LE(limit, kCapacity + 2);
+    // Most of the capacity is used, few requests are throttled.
+    EXPECT_GT(sentLastRounds / 100, kCapacity * 3 / 5);
+    EXPECT_LT(throttled, sent / 20);
+}
+
+} // namespace molecula
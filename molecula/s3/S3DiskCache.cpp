@@ -0,0 +1,378 @@
+#include "molecula/s3/S3DiskCache.hpp"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace molecula {
+
+namespace {
+bool readFully(int fd, char *data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t n = ::pread(fd, data, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+bool writeFully(int fd, const char *data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t n = ::pwrite(fd, data, size, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+// Finalizes the statement when leaving the scope.
+struct Statement {
+    ~Statement() {
+        sqlite3_finalize(stmt);
+    }
+
+    sqlite3_stmt *stmt{};
+};
+} // namespace
+
+S3DiskCache::S3DiskCache(const S3DiskCacheConfig &config) : config{config} {
+    CHECK(config.blockSize > 0 && config.capacity >= config.blockSize && config.ioThreads > 0);
+    numSlots = config.capacity / config.blockSize;
+    std::filesystem::path directory{config.directory};
+    std::filesystem::create_directories(directory);
+    std::string dataFile = directory / "blocks";
+    fd = ::open(dataFile.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + dataFile + ": " + std::strerror(errno));
+    }
+    try {
+        openIndex();
+        loadIndex();
+    } catch (...) {
+        sqlite3_close(db);
+        ::close(fd);
+        throw;
+    }
+    executor = std::make_unique<folly::CPUThreadPoolExecutor>(config.ioThreads);
+}
+
+S3DiskCache::~S3DiskCache() {
+    // Completes queued reads and writes.
+    executor->join();
+    sqlite3_close(db);
+    ::close(fd);
+}
+
+void S3DiskCache::openIndex() {
+    std::string indexFile = std::filesystem::path{config.directory} / "index.db";
+    if (sqlite3_open(indexFile.c_str(), &db) != SQLITE_OK) {
+        throw std::runtime_error("Failed to open disk cache index " + indexFile);
+    }
+    // Index rows are written after the block data is synced, WAL without syncs is enough for
+    // them. Deletes that free a slot for reuse are synced, see deleteIndex.
+    execute("PRAGMA journal_mode=WAL");
+    execute("PRAGMA synchronous=NORMAL");
+    execute(R"(
+        CREATE TABLE IF NOT EXISTS blocks (
+            key TEXT PRIMARY KEY,
+            slot INTEGER NOT NULL,
+            size INTEGER NOT NULL,
+            object_size INTEGER NOT NULL,
+            sequence INTEGER NOT NULL
+        );
+    )");
+    // Slots of another block size are unusable. The block size is kept in user_version.
+    Statement version;
+    sqlite3_prepare_v2(db, "PRAGMA user_version", -1, &version.stmt, nullptr);
+    long blockSize = sqlite3_step(version.stmt) == SQLITE_ROW
+            ? sqlite3_column_int64(version.stmt, 0)
+            : 0;
+    if (blockSize != config.blockSize) {
+        LOG(INFO) << "Disk cache block size changed from " << blockSize << " to "
+                  << config.blockSize << ", dropping cached blocks";
+        execute("DELETE FROM blocks");
+        execute(("PRAGMA user_version=" + std::to_string(config.blockSize)).c_str());
+    }
+}
+
+void S3DiskCache::loadIndex() {
+    Statement select;
+    sqlite3_prepare_v2(
+            db,
+            "SELECT key, slot, size, object_size, sequence FROM blocks ORDER BY sequence DESC",
+            -1,
+            &select.stmt,
+            nullptr);
+    std::vector<bool> used;
+    std::vector<std::string> stale;
+    while (sqlite3_step(select.stmt) == SQLITE_ROW) {
+        std::string key{(const char *)sqlite3_column_text(select.stmt, 0)};
+        long slot = sqlite3_column_int64(select.stmt, 1);
+        long size = sqlite3_column_int64(select.stmt, 2);
+        nextSequence = std::max<long>(nextSequence, sqlite3_column_int64(select.stmt, 4) + 1);
+        // Slots past a reduced capacity are dropped. Of rows sharing a slot the newest one is
+        // for the data in it.
+        if (slot < 0 || slot >= numSlots || size > config.blockSize
+            || (slot < static_cast<long>(used.size()) && used[slot])) {
+            stale.push_back(std::move(key));
+            continue;
+        }
+        if (slot >= static_cast<long>(used.size())) {
+            used.resize(slot + 1);
+        }
+        used[slot] = true;
+        lru.push_back(key);
+        Entry &entry = entries[std::move(key)];
+        entry.slot = slot;
+        entry.size = size;
+        entry.objectSize = sqlite3_column_int64(select.stmt, 3);
+        entry.lru = std::prev(lru.end());
+        bytes += size;
+    }
+    for (const std::string &key : stale) {
+        deleteIndex(key);
+    }
+    nextSlot = static_cast<long>(used.size());
+    for (long slot = nextSlot - 1; slot >= 0; slot--) {
+        if (!used[slot]) {
+            freeSlots.push_back(slot);
+        }
+    }
+    LOG(INFO) << "Disk cache " << config.directory << ": " << entries.size() << " blocks, "
+              << bytes << " bytes";
+}
+
+void S3DiskCache::execute(const char *sql) {
+    char *errMsg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        std::string message{errMsg ? errMsg : "Unknown error"};
+        sqlite3_free(errMsg);
+        throw std::runtime_error("Disk cache index error: " + message);
+    }
+}
+
+folly::Future<std::optional<S3CachedBlock>> S3DiskCache::get(const std::string &key) {
+    long slot = 0;
+    long size = 0;
+    long objectSize = 0;
+    {
+        std::lock_guard lock{mutex};
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            numMisses.fetch_add(1, std::memory_order_relaxed);
+            return folly::makeFuture(std::optional<S3CachedBlock>{});
+        }
+        Entry &entry = it->second;
+        entry.pins++;
+        lru.splice(lru.begin(), lru, entry.lru);
+        slot = entry.slot;
+        size = entry.size;
+        objectSize = entry.objectSize;
+    }
+    return folly::via(
+            executor.get(),
+            [this, key, slot, size, objectSize]() -> std::optional<S3CachedBlock> {
+                auto data = std::make_shared<ByteBuffer>(size);
+                data->resize(size);
+                bool failed = !readFully(fd, data->data(), size, slot * config.blockSize);
+                unpin(key, failed);
+                if (failed) {
+                    LOG(WARNING) << "Failed to read cached block " << key;
+                    numMisses.fetch_add(1, std::memory_order_relaxed);
+                    return std::nullopt;
+                }
+                numHits.fetch_add(1, std::memory_order_relaxed);
+                numBytesRead.fetch_add(size, std::memory_order_relaxed);
+                return S3CachedBlock{200, objectSize, std::move(data)};
+            });
+}
+
+void S3DiskCache::unpin(const std::string &key, bool failed) {
+    long slot = 0;
+    {
+        std::lock_guard lock{mutex};
+        Entry &entry = entries.at(key);
+        entry.pins--;
+        if (!failed || entry.pins > 0) {
+            return;
+        }
+        slot = entry.slot;
+        bytes -= entry.size;
+        lru.erase(entry.lru);
+        entries.erase(key);
+    }
+    // Slot is reusable only once the index no longer points to it. If the row stays, so does
+    // the slot, until a restart.
+    if (deleteIndex(key)) {
+        std::lock_guard lock{mutex};
+        freeSlots.push_back(slot);
+    }
+}
+
+void S3DiskCache::put(const std::string &key, S3CachedBlock block) {
+    if (block.status < 200 || block.status >= 300 || !block.data
+        || static_cast<long>(block.data->size()) > config.blockSize) {
+        return;
+    }
+    long slot = 0;
+    std::string evictedKey;
+    {
+        std::lock_guard lock{mutex};
+        if (entries.contains(key) || writing.contains(key)) {
+            return;
+        }
+        if (pendingWrites >= config.maxPendingWrites
+            || (slot = allocateSlot(evictedKey)) < 0) {
+            numWritesDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        writing.insert(key);
+        pendingWrites++;
+    }
+    executor->add([this, key, block = std::move(block), slot, evictedKey] {
+        // Index must not point to the slot while it is overwritten. If the row stays, the slot
+        // keeps the evicted block and isn't reused until a restart.
+        if (!evictedKey.empty() && !deleteIndex(evictedKey)) {
+            std::lock_guard lock{mutex};
+            writing.erase(key);
+            pendingWrites--;
+            writesDone.notify_all();
+            return;
+        }
+        write(key, block, slot);
+    });
+}
+
+long S3DiskCache::allocateSlot(std::string &evictedKey) {
+    if (!freeSlots.empty()) {
+        long slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+    if (nextSlot < numSlots) {
+        return nextSlot++;
+    }
+    for (auto it = lru.rbegin(); it != lru.rend(); ++it) {
+        auto entry = entries.find(*it);
+        if (entry->second.pins > 0) {
+            continue;
+        }
+        long slot = entry->second.slot;
+        bytes -= entry->second.size;
+        evictedKey = std::move(entries.extract(entry).key());
+        lru.erase(std::next(it).base());
+        numEvictions.fetch_add(1, std::memory_order_relaxed);
+        return slot;
+    }
+    return -1;
+}
+
+void S3DiskCache::write(const std::string &key, const S3CachedBlock &block, long slot) {
+    long size = static_cast<long>(block.data->size());
+    bool ok = writeFully(fd, block.data->view().data(), size, slot * config.blockSize)
+            && ::fdatasync(fd) == 0;
+    if (!ok) {
+        LOG(WARNING) << "Failed to write cached block " << key << ": " << std::strerror(errno);
+    } else {
+        try {
+            writeIndex(key, block, slot);
+        } catch (const std::exception &e) {
+            LOG(WARNING) << e.what();
+            ok = false;
+        }
+    }
+
+    std::lock_guard lock{mutex};
+    writing.erase(key);
+    pendingWrites--;
+    if (ok) {
+        lru.push_front(key);
+        Entry &entry = entries[key];
+        entry.slot = slot;
+        entry.size = size;
+        entry.objectSize = block.objectSize;
+        entry.lru = lru.begin();
+        bytes += size;
+        numBytesWritten.fetch_add(size, std::memory_order_relaxed);
+    } else {
+        freeSlots.push_back(slot);
+    }
+    writesDone.notify_all();
+}
+
+void S3DiskCache::writeIndex(const std::string &key, const S3CachedBlock &block, long slot) {
+    std::lock_guard lock{dbMutex};
+    Statement insert;
+    sqlite3_prepare_v2(
+            db,
+            "INSERT OR REPLACE INTO blocks VALUES (?, ?, ?, ?, ?)",
+            -1,
+            &insert.stmt,
+            nullptr);
+    sqlite3_bind_text(insert.stmt, 1, key.data(), static_cast<int>(key.size()), SQLITE_STATIC);
+    sqlite3_bind_int64(insert.stmt, 2, slot);
+    sqlite3_bind_int64(insert.stmt, 3, static_cast<long>(block.data->size()));
+    sqlite3_bind_int64(insert.stmt, 4, block.objectSize);
+    sqlite3_bind_int64(insert.stmt, 5, nextSequence++);
+    if (sqlite3_step(insert.stmt) != SQLITE_DONE) {
+        throw std::runtime_error(
+                std::string{"Failed to write disk cache index: "} + sqlite3_errmsg(db));
+    }
+}
+
+bool S3DiskCache::deleteIndex(const std::string &key) {
+    std::lock_guard lock{dbMutex};
+    // The slot of the row is overwritten next. With synchronous=NORMAL a WAL commit is not
+    // synced, so after a power loss the row could come back and map the key to another block.
+    sqlite3_exec(db, "PRAGMA synchronous=FULL", nullptr, nullptr, nullptr);
+    Statement remove;
+    sqlite3_prepare_v2(db, "DELETE FROM blocks WHERE key = ?", -1, &remove.stmt, nullptr);
+    sqlite3_bind_text(remove.stmt, 1, key.data(), static_cast<int>(key.size()), SQLITE_STATIC);
+    bool ok = sqlite3_step(remove.stmt) == SQLITE_DONE;
+    if (!ok) {
+        LOG(WARNING) << "Failed to delete from disk cache index: " << sqlite3_errmsg(db);
+    }
+    sqlite3_exec(db, "PRAGMA synchronous=NORMAL", nullptr, nullptr, nullptr);
+    return ok;
+}
+
+void S3DiskCache::waitForWrites() {
+    std::unique_lock lock{mutex};
+    writesDone.wait(lock, [this] { return pendingWrites == 0; });
+}
+
+S3DiskCacheStats S3DiskCache::getStats() const {
+    S3DiskCacheStats stats;
+    stats.hits = numHits.load(std::memory_order_relaxed);
+    stats.misses = numMisses.load(std::memory_order_relaxed);
+    stats.bytesRead = numBytesRead.load(std::memory_order_relaxed);
+    stats.bytesWritten = numBytesWritten.load(std::memory_order_relaxed);
+    stats.writesDropped = numWritesDropped.load(std::memory_order_relaxed);
+    stats.evictions = numEvictions.load(std::memory_order_relaxed);
+    std::lock_guard lock{mutex};
+    stats.numBlocks = static_cast<long>(entries.size());
+    stats.bytes = bytes;
+    return stats;
+}
+
+} // namespace molecula
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "folly/executors/CPUThreadPoolExecutor.h"
+#include "folly/futures/Future.h"
+#include "molecula/s3/S3BlockCache.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <sqlite3.h>
+
+namespace molecula {
+
+class S3DiskCacheConfig {
+public:
+    // Cache directory, created if missing. Empty disables the disk cache.
+    std::string directory;
+    // Budget of block data on disk.
+    long capacity{100L * 1024 * 1024 * 1024};
+    // Must be the block size of the memory cache above.
+    long blockSize{1024 * 1024};
+    int ioThreads{16};
+    // Blocks are not admitted while this many writes are queued, so a burst of misses doesn't
+    // build an IO backlog in front of reads.
+    int maxPendingWrites{64};
+};
+
+class S3DiskCacheStats {
+public:
+    long hits{};
+    long misses{};
+    long bytesRead{};
+    long bytesWritten{};
+    // Blocks not admitted because of the write backlog.
+    long writesDropped{};
+    long evictions{};
+    long numBlocks{};
+    long bytes{};
+};
+
+// Persistent cache of object blocks on a local disk. Blocks are stored in fixed size slots of
+// one data file, the slot index is kept in SQLite next to it and reloaded on start. A slot is
+// synced before its index row is written, and the row of a previous block in the slot is
+// deleted durably before it is overwritten, so after a crash the index only refers to complete
+// blocks under their own keys. Eviction is LRU over the blocks in memory; after a restart,
+// blocks are ordered by write time. Reads and writes run on a thread pool. Thread safe.
+class S3DiskCache {
+public:
+    // Throws if the directory or the index can't be opened.
+    explicit S3DiskCache(const S3DiskCacheConfig &config);
+    ~S3DiskCache();
+
+    S3DiskCache(const S3DiskCache &) = delete;
+    S3DiskCache &operator=(const S3DiskCache &) = delete;
+
+    const S3DiskCacheConfig &getConfig() const {
+        return config;
+    }
+
+    // Empty on a miss or a read error.
+    folly::Future<std::optional<S3CachedBlock>> get(const std::string &key);
+    // Writes the block in the background unless it is cached or the write backlog is full.
+    void put(const std::string &key, S3CachedBlock block);
+    // Waits for the queued writes.
+    void waitForWrites();
+
+    S3DiskCacheStats getStats() const;
+
+private:
+    struct Entry {
+        long slot{};
+        long size{};
+        long objectSize{};
+        // Reads in progress, the block is not evicted while it is read.
+        int pins{};
+        std::list<std::string>::iterator lru;
+    };
+
+    void openIndex();
+    void loadIndex();
+    void execute(const char *sql);
+    // Free slot, or the slot of the least recently used block. -1 if all slots are being read.
+    long allocateSlot(std::string &evictedKey);
+    void unpin(const std::string &key, bool failed);
+    void write(const std::string &key, const S3CachedBlock &block, long slot);
+    void writeIndex(const std::string &key, const S3CachedBlock &block, long slot);
+    // Durable before it returns true, so the slot of the row can be overwritten.
+    bool deleteIndex(const std::string &key);
+
+    S3DiskCacheConfig config;
+    long numSlots{};
+    int fd{-1};
+    sqlite3 *db{};
+    std::mutex dbMutex;
+    // Write order of the index rows, guarded by @dbMutex.
+    long nextSequence{};
+    std::unique_ptr<folly::CPUThreadPoolExecutor> executor;
+
+    mutable std::mutex mutex;
+    std::condition_variable writesDone;
+    std::unordered_map<std::string, Entry> entries;
+    // Most recently used first.
+    std::list<std::string> lru;
+    // Slots freed below @nextSlot, slots from @nextSlot on were never used.
+    std::vector<long> freeSlots;
+    long nextSlot{};
+    std::unordered_set<std::string> writing;
+    int pendingWrites{};
+    long bytes{};
+
+    std::atomic<long> numHits{};
+    std::atomic<long> numMisses{};
+    std::atomic<long> numBytesRead{};
+    std::atomic<long> numBytesWritten{};
+    std::atomic<long> numWritesDropped{};
+    std::atomic<long> numEvictions{};
+};
+
+} // namespace molecula
@@ -0,0 +1,142 @@
+#include "molecula/s3/S3DiskCache.hpp"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+
+namespace molecula {
+
+namespace {
+std::string makeDirectory(std::string_view name) {
+    auto directory = std::filesystem::path{::testing::TempDir()} / name;
+    std::filesystem::remove_all(directory);
+    return directory;
+}
+
+S3DiskCacheConfig makeConfig(std::string directory) {
+    S3DiskCacheConfig config;
+    config.directory = std::move(directory);
+    config.blockSize = 1000;
+    config.capacity = 3000;
+    config.ioThreads = 2;
+    return config;
+}
+
+S3CachedBlock makeBlock(char c, long size) {
+    auto data = std::make_shared<ByteBuffer>(size);
+    data->append(std::string(size, c));
+    return S3CachedBlock{206, 10'000, std::move(data)};
+}
+
+std::optional<S3CachedBlock> get(S3DiskCache &cache, const std::string &key) {
+    return cache.get(key).get();
+}
+} // namespace
+
+GTEST_TEST(S3DiskCache, PutGet) {
+    S3DiskCache cache{makeConfig(makeDirectory("S3DiskCache_PutGet"))};
+    EXPECT_FALSE(get(cache, "a@0"));
+    cache.put("a@0", makeBlock('a', 1000));
+    cache.put("a@1", makeBlock('b', 10));
+    cache.waitForWrites();
+
+    auto block = get(cache, "a@1");
+    ASSERT_TRUE(block);
+    EXPECT_EQ(block->status, 200);
+    EXPECT_EQ(block->objectSize, 10'000);
+    EXPECT_EQ(block->data->view(), std::string(10, 'b'));
+
+    S3DiskCacheStats stats = cache.getStats();
+    EXPECT_EQ(stats.hits, 1);
+    EXPECT_EQ(stats.misses, 1);
+    EXPECT_EQ(stats.bytesRead, 10);
+    EXPECT_EQ(stats.bytesWritten, 1010);
+    EXPECT_EQ(stats.numBlocks, 2);
+    EXPECT_EQ(stats.bytes, 1010);
+}
+
+GTEST_TEST(S3DiskCache, Restart) {
+    std::string directory = makeDirectory("S3DiskCache_Restart");
+    {
+        S3DiskCache cache{makeConfig(directory)};
+        cache.put("a@0", makeBlock('a', 1000));
+        cache.put("a@1", makeBlock('b', 500));
+    }
+    {
+        S3DiskCache cache{makeConfig(directory)};
+        EXPECT_EQ(cache.getStats().numBlocks, 2);
+        auto block = get(cache, "a@0");
+        ASSERT_TRUE(block);
+        EXPECT_EQ(block->data->view(), std::string(1000, 'a'));
+        block = get(cache, "a@1");
+        ASSERT_TRUE(block);
+        EXPECT_EQ(block->data->view(), std::string(500, 'b'));
+        // Doesn't reuse the slots of the loaded blocks.
+        cache.put("a@2", makeBlock('c', 1000));
+        cache.waitForWrites();
+        EXPECT_EQ(get(cache, "a@0")->data->view(), std::string(1000, 'a'));
+        EXPECT_EQ(get(cache, "a@2")->data->view(), std::string(1000, 'c'));
+    }
+    {
+        // Blocks of another size are dropped.
+        S3DiskCacheConfig config = makeConfig(directory);
+        config.blockSize = 500;
+        S3DiskCache cache{config};
+        EXPECT_EQ(cache.getStats().numBlocks, 0);
+    }
+}
+
+GTEST_TEST(S3DiskCache, Eviction) {
+    S3DiskCache cache{makeConfig(makeDirectory("S3DiskCache_Eviction"))};
+    for (char c : std::string{"abc"}) {
+        cache.put(std::string{c} + "@0", makeBlock(c, 1000));
+        cache.waitForWrites();
+    }
+    // "a" becomes the most recently used.
+    EXPECT_TRUE(get(cache, "a@0"));
+    cache.put("d@0", makeBlock('d', 1000));
+    cache.waitForWrites();
+
+    EXPECT_FALSE(get(cache, "b@0"));
+    EXPECT_EQ(get(cache, "a@0")->data->view(), std::string(1000, 'a'));
+    EXPECT_EQ(get(cache, "d@0")->data->view(), std::string(1000, 'd'));
+    S3DiskCacheStats stats = cache.getStats();
+    EXPECT_EQ(stats.evictions, 1);
+    EXPECT_EQ(stats.numBlocks, 3);
+    EXPECT_EQ(stats.bytes, 3000);
+}
+
+GTEST_TEST(S3DiskCache, RestartAfterEviction) {
+    std::string directory = makeDirectory("S3DiskCache_RestartAfterEviction");
+    {
+        S3DiskCache cache{makeConfig(directory)};
+        for (char c : std::string{"abcd"}) {
+            cache.put(std::string{c} + "@0", makeBlock(c, 1000));
+            cache.waitForWrites();
+        }
+        EXPECT_EQ(cache.getStats().evictions, 1);
+    }
+    {
+        // A row of the evicted block left for the reused slot, as after a lost delete.
+        sqlite3 *db = nullptr;
+        std::string index = std::filesystem::path{directory} / "index.db";
+        ASSERT_EQ(sqlite3_open(index.c_str(), &db), SQLITE_OK);
+        EXPECT_EQ(
+                sqlite3_exec(
+                        db,
+                        "INSERT INTO blocks SELECT 'a@0', slot, size, object_size, -1 FROM blocks "
+                        "WHERE key = 'd@0'",
+                        nullptr,
+                        nullptr,
+                        nullptr),
+                SQLITE_OK);
+        sqlite3_close(db);
+    }
+    S3DiskCache cache{makeConfig(directory)};
+    EXPECT_EQ(cache.getStats().numBlocks, 3);
+    EXPECT_FALSE(get(cache, "a@0"));
+    EXPECT_EQ(get(cache, "d@0")->data->view(), std::string(1000, 'd'));
+}
+
+} // namespace molecula
@@ -0,0 +1,203 @@
+#include "molecula/s3/S3InputStream.hpp"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace molecula {
+
+S3InputStream::S3InputStream(
+        S3Client *client,
+        std::string_view bucket,
+        std::string_view key,
+        long size,
+        const S3InputStreamConfig &config,
+        std::shared_ptr<ByteBufferPool> pool) :
+    client{client},
+    bucket{bucket},
+    key{key},
+    size{size},
+    config{config},
+    pool{std::move(pool)},
+    requestSize{std::clamp(
+            config.initialRequestSize, config.minRequestSize, config.maxRequestSize)},
+    depth{std::max(config.initialDepth, 1)} {
+    CHECK(config.minRequestSize > 0 && config.minRequestSize <= config.maxRequestSize);
+    prefetch();
+}
+
+S3InputStream::~S3InputStream() {
+    // Its continuation would run on the destroyed stream.
+    CHECK(!reading) << "S3InputStream destroyed while a read is pending";
+    for (Chunk &chunk : chunks) {
+        drop(chunk);
+    }
+}
+
+folly::Future<std::unique_ptr<S3InputStream>> S3InputStream::open(
+        S3Client *client,
+        std::string_view bucket,
+        std::string_view key,
+        const S3InputStreamConfig &config,
+        std::shared_ptr<ByteBufferPool> pool) {
+    return client->getObjectInfo(S3GetObjectInfoRequest{bucket, key})
+            .thenValue([client,
+                        bucket = std::string{bucket},
+                        key = std::string{key},
+                        config,
+                        pool = std::move(pool)](S3GetObjectInfo info) {
+                if (!is2xx(info.status)) {
+                    throw std::runtime_error(
+                            "Failed to open s3://" + bucket + "/" + key + ", status "
+                            + std::to_string(info.status));
+                }
+                return std::make_unique<S3InputStream>(
+                        client, bucket, key, info.size, config, pool);
+            });
+}
+
+void S3InputStream::prefetch() {
+    while (static_cast<int>(chunks.size()) < depth && fetchOffset < size) {
+        long n = std::min(requestSize, size - fetchOffset);
+        // One chunk is always allowed, the read needs it.
+        if (!chunks.empty() && bufferedBytes + n > config.maxBufferedBytes) {
+            break;
+        }
+        auto pending = std::make_shared<Pending>();
+        pending->buffer = pool->acquire(n);
+        pending->buffer.resize(n);
+        S3GetObjectRequest req{bucket, key};
+        req.setRange(fetchOffset, fetchOffset + n - 1);
+        req.output = pending->buffer.span();
+        auto start = std::chrono::steady_clock::now();
+        // Touches only the shared state: the stream may be gone when the GET is done.
+        client->getObject(req).thenTry(
+                [start, pending, pool = pool](folly::Try<S3GetObject> get) {
+                    std::optional<folly::Promise<folly::Unit>> waiter;
+                    {
+                        std::lock_guard lock{pending->mutex};
+                        if (pending->dropped) {
+                            pool->release(std::move(pending->buffer));
+                            return;
+                        }
+                        if (get.hasException()) {
+                            pending->result.emplace(std::move(get.exception()));
+                        } else {
+                            pending->result.emplace(Fetched{
+                                    std::move(get.value()),
+                                    std::chrono::steady_clock::now() - start});
+                        }
+                        pending->done = true;
+                        waiter.swap(pending->waiter);
+                    }
+                    if (waiter) {
+                        waiter->setValue();
+                    }
+                });
+        chunks.push_back(Chunk{fetchOffset, n, std::move(pending), std::nullopt, {}});
+        fetchOffset += n;
+        bufferedBytes += n;
+    }
+}
+
+folly::Future<size_t> S3InputStream::read(std::span<char> output) {
+    if (output.empty() || position >= size) {
+        return folly::makeFuture<size_t>(0);
+    }
+    prefetch();
+    Chunk &chunk = chunks.front();
+    if (!chunk.fetched && !chunk.error) {
+        std::unique_lock lock{chunk.pending->mutex};
+        if (!chunk.pending->done) {
+            // Prefetch is not far enough ahead.
+            folly::Promise<folly::Unit> waiter;
+            auto waited = waiter.getFuture();
+            chunk.pending->waiter = std::move(waiter);
+            lock.unlock();
+            chunk.waited = true;
+            numStalls++;
+            readyChunks = 0;
+            depth = std::min(depth + 1, config.maxDepth);
+            prefetch();
+            reading = true;
+            return std::move(waited).thenValue([this, output](folly::Unit) {
+                reading = false;
+                return read(output);
+            });
+        }
+        folly::Try<Fetched> result = std::move(*chunk.pending->result);
+        lock.unlock();
+        if (!chunk.waited && ++readyChunks >= depth) {
+            readyChunks = 0;
+            depth = std::max(depth - 1, std::max(config.initialDepth, 1));
+        }
+        takeFetched(chunk, std::move(result));
+    }
+    if (chunk.error) {
+        return folly::makeFuture<size_t>(chunk.error);
+    }
+    const S3GetObject &get = chunk.fetched->get;
+    if (!is2xx(get.status) || get.size != chunk.size) {
+        return folly::makeFuture<size_t>(std::runtime_error(
+                "Failed to read s3://" + bucket + "/" + key + " at " + std::to_string(chunk.offset)
+                + ", status " + std::to_string(get.status)));
+    }
+
+    long offset = position - chunk.offset;
+    size_t n = std::min<size_t>(output.size(), chunk.size - offset);
+    std::memcpy(output.data(), chunk.pending->buffer.data() + offset, n);
+    position += static_cast<long>(n);
+    if (position >= chunk.offset + chunk.size) {
+        drop(chunk);
+        chunks.pop_front();
+        prefetch();
+    }
+    return folly::makeFuture(n);
+}
+
+void S3InputStream::takeFetched(Chunk &chunk, folly::Try<Fetched> result) {
+    if (result.hasException()) {
+        chunk.error = std::move(result.exception());
+        return;
+    }
+    Fetched &fetched = result.value();
+    if (fetched.time < config.minRequestTime) {
+        requestSize = std::min(requestSize * 2, config.maxRequestSize);
+    } else if (fetched.time > config.maxRequestTime) {
+        requestSize = std::max(requestSize / 2, config.minRequestSize);
+    }
+    chunk.fetched = std::move(fetched);
+}
+
+void S3InputStream::seek(long offset) {
+    CHECK(!reading) << "S3InputStream seek while a read is pending";
+    position = std::clamp(offset, 0L, size);
+    if (!chunks.empty() && chunks.front().offset > position) {
+        for (Chunk &chunk : chunks) {
+            drop(chunk);
+        }
+        chunks.clear();
+    }
+    while (!chunks.empty() && chunks.front().offset + chunks.front().size <= position) {
+        drop(chunks.front());
+        chunks.pop_front();
+    }
+    if (chunks.empty()) {
+        fetchOffset = position;
+    }
+    prefetch();
+}
+
+void S3InputStream::drop(Chunk &chunk) {
+    bufferedBytes -= chunk.size;
+    std::lock_guard lock{chunk.pending->mutex};
+    if (!chunk.pending->done) {
+        // GET still writes to the buffer, its continuation returns it.
+        chunk.pending->dropped = true;
+        return;
+    }
+    pool->release(std::move(chunk.pending->buffer));
+}
+
+} // namespace molecula
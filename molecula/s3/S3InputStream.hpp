@@ -0,0 +1,148 @@
+#pragma once
+
+#include "molecula/common/ByteBufferPool.hpp"
+#include "molecula/s3/S3Client.hpp"
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace molecula {
+
+// Prefetch of a sequential reader: up to @depth range GETs of @requestSize are kept in flight
+// ahead of the read position, within @maxBufferedBytes. A read that has to wait for data adds
+// one to the depth. When a whole depth of chunks is done before the reads reach them, the
+// consumer is slower than S3 and the depth goes down by one, not below @initialDepth. A GET
+// faster than @minRequestTime is dominated by the first byte latency and doubles the request
+// size, a GET slower than @maxRequestTime halves it.
+class S3InputStreamConfig {
+public:
+    long initialRequestSize{1024 * 1024};
+    long minRequestSize{256 * 1024};
+    long maxRequestSize{16 * 1024 * 1024};
+    int initialDepth{2};
+    int maxDepth{16};
+    long maxBufferedBytes{64 * 1024 * 1024};
+    std::chrono::milliseconds minRequestTime{100};
+    std::chrono::milliseconds maxRequestTime{1'000};
+};
+
+// Object read front to back with prefetching. Buffers of consumed data go back to the pool.
+// One consumer: call @read, @skip or @seek only after the previous read completed. The stream
+// may be destroyed with GETs in flight, but not while a read is pending. GETs of dropped data
+// run to completion and return their buffers to the pool then.
+class S3InputStream {
+public:
+    S3InputStream(
+            S3Client *client,
+            std::string_view bucket,
+            std::string_view key,
+            long size,
+            const S3InputStreamConfig &config,
+            std::shared_ptr<ByteBufferPool> pool);
+    ~S3InputStream();
+
+    S3InputStream(const S3InputStream &) = delete;
+    S3InputStream &operator=(const S3InputStream &) = delete;
+
+    // Takes the object size from GetObjectInfo.
+    static folly::Future<std::unique_ptr<S3InputStream>> open(
+            S3Client *client,
+            std::string_view bucket,
+            std::string_view key,
+            const S3InputStreamConfig &config,
+            std::shared_ptr<ByteBufferPool> pool);
+
+    // Reads up to @output size bytes, returns the size read, zero at the end of the object.
+    // Fails if a GET failed.
+    folly::Future<size_t> read(std::span<char> output);
+    void skip(long size) {
+        seek(position + size);
+    }
+    // Prefetched data before @offset is dropped. Seeking backward drops all of it.
+    void seek(long offset);
+
+    long getPosition() const {
+        return position;
+    }
+
+    long getSize() const {
+        return size;
+    }
+
+    long getRequestSize() const {
+        return requestSize;
+    }
+
+    int getDepth() const {
+        return depth;
+    }
+
+    // Reads that waited for a GET.
+    long getStalls() const {
+        return numStalls;
+    }
+
+private:
+    struct Fetched {
+        S3GetObject get;
+        std::chrono::steady_clock::duration time;
+    };
+
+    // GET of a chunk, shared with its continuation, which may outlive the stream.
+    struct Pending {
+        std::mutex mutex;
+        // GET writes here until it is done.
+        ByteBuffer buffer;
+        bool done{};
+        // Chunk dropped before the GET was done, the continuation returns the buffer.
+        bool dropped{};
+        std::optional<folly::Try<Fetched>> result;
+        // Read waiting for the GET.
+        std::optional<folly::Promise<folly::Unit>> waiter;
+    };
+
+    struct Chunk {
+        long offset{};
+        long size{};
+        std::shared_ptr<Pending> pending;
+        // Result taken from the pending GET.
+        std::optional<Fetched> fetched;
+        folly::exception_wrapper error;
+        // A read waited for the GET.
+        bool waited{};
+    };
+
+    void prefetch();
+    // Takes the result of the completed GET and adapts the request size to its time.
+    void takeFetched(Chunk &chunk, folly::Try<Fetched> result);
+    // Returns the buffer to the pool once no GET writes to it.
+    void drop(Chunk &chunk);
+
+    S3Client *client{};
+    std::string bucket;
+    std::string key;
+    long size{};
+    S3InputStreamConfig config;
+    std::shared_ptr<ByteBufferPool> pool;
+
+    long position{};
+    // Next offset to prefetch.
+    long fetchOffset{};
+    long bufferedBytes{};
+    long requestSize{};
+    int depth{};
+    // Chunks done before the read reached them, since the last change of the depth.
+    int readyChunks{};
+    long numStalls{};
+    // A read waits for a GET.
+    bool reading{};
+    std::deque<Chunk> chunks;
+};
+
+} // namespace molecula
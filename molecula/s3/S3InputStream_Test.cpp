@@ -0,0 +1,167 @@
+#include "molecula/s3/S3InputStream.hpp"
+
+#include "molecula/s3/FakeS3Client.hpp"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+
+namespace molecula {
+
+namespace {
+S3InputStreamConfig makeConfig() {
+    S3InputStreamConfig config;
+    config.initialRequestSize = 1000;
+    config.minRequestSize = 1000;
+    config.maxRequestSize = 4000;
+    config.maxBufferedBytes = 100'000;
+    return config;
+}
+
+std::string readAll(S3InputStream &stream, size_t readSize) {
+    std::string data;
+    std::string buffer(readSize, '\0');
+    while (size_t n = stream.read(buffer).get()) {
+        data.append(buffer.data(), n);
+    }
+    return data;
+}
+} // namespace
+
+GTEST_TEST(S3InputStream, ReadAll) {
+    FakeS3Client s3{makeData(20'000)};
+    auto pool = std::make_shared<ByteBufferPool>(1024 * 1024);
+    auto stream = S3InputStream::open(&s3, "bucket", "key", makeConfig(), pool).get();
+    EXPECT_EQ(stream->getSize(), 20'000);
+    EXPECT_EQ(readAll(*stream, 700), s3.data);
+    EXPECT_EQ(stream->getPosition(), 20'000);
+    // Fast GETs grow the request size.
+    EXPECT_EQ(stream->getRequestSize(), 4000);
+    EXPECT_LT(s3.numGets, 20);
+    EXPECT_GT(pool->getPooledBytes(), 0);
+}
+
+GTEST_TEST(S3InputStream, Prefetch) {
+    FakeS3Client s3{makeData(10'000)};
+    s3.deferGets = true;
+    S3InputStreamConfig config = makeConfig();
+    config.initialDepth = 2;
+    auto pool = std::make_shared<ByteBufferPool>(0);
+    S3InputStream stream{&s3, "bucket", "key", 10'000, config, pool};
+    EXPECT_EQ(s3.numGets, 2);
+
+    std::string buffer(600, '\0');
+    auto read = stream.read(buffer);
+    EXPECT_FALSE(read.isReady());
+    // Waiting read adds a GET in flight.
+    EXPECT_EQ(stream.getStalls(), 1);
+    EXPECT_EQ(stream.getDepth(), 3);
+    EXPECT_EQ(s3.numGets, 3);
+
+    ASSERT_TRUE(s3.completeGet());
+    EXPECT_EQ(std::move(read).get(), 600);
+    EXPECT_EQ(buffer, s3.data.substr(0, 600));
+    // Rest of the first chunk
+    EXPECT_EQ(stream.read(buffer).get(), 400);
+    EXPECT_EQ(buffer.substr(0, 400), s3.data.substr(600, 400));
+    // First chunk consumed, the next one is requested.
+    EXPECT_EQ(s3.numGets, 4);
+    while (s3.completeGet()) {
+    }
+}
+
+GTEST_TEST(S3InputStream, PrefetchShrinks) {
+    FakeS3Client s3{makeData(20'000)};
+    s3.deferGets = true;
+    S3InputStreamConfig config = makeConfig();
+    config.initialDepth = 2;
+    config.maxRequestSize = 1000;
+    auto pool = std::make_shared<ByteBufferPool>(0);
+    S3InputStream stream{&s3, "bucket", "key", 20'000, config, pool};
+
+    std::string buffer(1000, '\0');
+    // GETs complete only once a read waits: each read adds one to the depth.
+    for (int i = 0; i < 3; i++) {
+        auto read = stream.read(buffer);
+        ASSERT_TRUE(s3.completeGet());
+        EXPECT_EQ(std::move(read).get(), 1000);
+    }
+    EXPECT_EQ(stream.getDepth(), 5);
+
+    // Consumer slower than S3: every GET is done before the read reaches it.
+    for (long offset = 3000; offset < 20'000; offset += 1000) {
+        while (s3.completeGet()) {
+        }
+        EXPECT_EQ(stream.read(buffer).get(), 1000);
+        EXPECT_EQ(buffer, s3.data.substr(offset, 1000));
+    }
+    EXPECT_EQ(stream.getStalls(), 3);
+    EXPECT_EQ(stream.getDepth(), 2);
+}
+
+GTEST_TEST(S3InputStream, DropPendingGets) {
+    FakeS3Client s3{makeData(10'000)};
+    s3.deferGets = true;
+    S3InputStreamConfig config = makeConfig();
+    config.initialDepth = 2;
+    auto pool = std::make_shared<ByteBufferPool>(1024 * 1024);
+    {
+        S3InputStream stream{&s3, "bucket", "key", 10'000, config, pool};
+        // Drops both chunks in flight and prefetches from the new position.
+        stream.seek(5'000);
+        EXPECT_EQ(s3.numGets, 4);
+    }
+    EXPECT_EQ(pool->getPooledBytes(), 0);
+    // GETs write to their buffers after the stream is gone, then return them.
+    while (s3.completeGet()) {
+    }
+    EXPECT_EQ(pool->getPooledBytes(), 4 * ByteBuffer::align(1'000));
+}
+
+GTEST_TEST(S3InputStream, MaxBufferedBytes) {
+    FakeS3Client s3{makeData(10'000)};
+    s3.deferGets = true;
+    S3InputStreamConfig config = makeConfig();
+    config.initialDepth = 8;
+    config.maxBufferedBytes = 2500;
+    auto pool = std::make_shared<ByteBufferPool>(0);
+    S3InputStream stream{&s3, "bucket", "key", 10'000, config, pool};
+    EXPECT_EQ(s3.numGets, 2);
+    while (s3.completeGet()) {
+    }
+}
+
+GTEST_TEST(S3InputStream, Seek) {
+    FakeS3Client s3{makeData(10'000)};
+    auto pool = std::make_shared<ByteBufferPool>(1024 * 1024);
+    S3InputStream stream{&s3, "bucket", "key", 10'000, makeConfig(), pool};
+    std::string buffer(100, '\0');
+    stream.seek(5'500);
+    EXPECT_EQ(stream.read(buffer).get(), 100);
+    EXPECT_EQ(buffer, s3.data.substr(5'500, 100));
+
+    stream.skip(1'000);
+    EXPECT_EQ(stream.read(buffer).get(), 100);
+    EXPECT_EQ(buffer, s3.data.substr(6'600, 100));
+
+    stream.seek(10);
+    EXPECT_EQ(stream.getPosition(), 10);
+    EXPECT_EQ(stream.read(buffer).get(), 100);
+    EXPECT_EQ(buffer, s3.data.substr(10, 100));
+
+    stream.seek(20'000);
+    EXPECT_EQ(stream.read(buffer).get(), 0);
+}
+
+GTEST_TEST(S3InputStream, FailedGet) {
+    FakeS3Client s3{makeData(1'000)};
+    // Larger than the object: the GET past its end fails.
+    auto pool = std::make_shared<ByteBufferPool>(0);
+    S3InputStream stream{&s3, "bucket", "key", 3'000, makeConfig(), pool};
+    std::string buffer(1'000, '\0');
+    EXPECT_EQ(stream.read(buffer).get(), 1'000);
+    EXPECT_THROW(stream.read(buffer).get(), std::runtime_error);
+}
+
+} // namespace molecula
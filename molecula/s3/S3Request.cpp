@@ -4,9 +4,11 @@
 
 #include <glog/logging.h>
 
+#include <openssl/evp.h>
 #include <openssl/hmac.h>
 #include <openssl/sha.h>
 #include <cstring>
+#include <memory>
 
 namespace molecula {
 
@@ -26,12 +28,63 @@ cryptoHmacSha256(std::string_view key, std::string_view data, char *buffer) {
     return std::string_view{buffer, hashSize};
 }
 
-std::string cryptoSha256Hex(ByteSpan data) {
+// Writes 2 * @size lower case hex digits to @output.
+static void toHex(const char *data, size_t size, char *output) {
+    constexpr char kDigits[] = "0123456789abcdef";
+    for (size_t i = 0; i < size; i++) {
+        auto byte = static_cast<unsigned char>(data[i]);
+        output[2 * i] = kDigits[byte >> 4];
+        output[2 * i + 1] = kDigits[byte & 0xf];
+    }
+}
+
+// Buffer must be 2 * SHA256_DIGEST_LENGTH bytes long.
+static void cryptoSha256Hex(ByteSpan data, char *output) {
+    // Requests without a body are the most common, their hash is a constant.
+    constexpr std::string_view kEmptyHash{
+            "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"};
+    if (data.empty()) {
+        std::memcpy(output, kEmptyHash.data(), kEmptyHash.size());
+        return;
+    }
     char buffer[SHA256_DIGEST_LENGTH];
     SHA256((const unsigned char *)data.data(), data.size(), (unsigned char *)buffer);
-    return folly::hexlify({buffer, SHA256_DIGEST_LENGTH});
+    toHex(buffer, sizeof(buffer), output);
 }
 
+namespace {
+// Incremental SHA-256 over pieces of text. The digest context is allocated once per thread.
+class Sha256 {
+public:
+    Sha256() : context{getContext()} {
+        EVP_DigestInit_ex(context, EVP_sha256(), nullptr);
+    }
+
+    void update(std::string_view data) {
+        EVP_DigestUpdate(context, data.data(), data.size());
+    }
+
+    // Buffer must be SHA256_DIGEST_LENGTH bytes long.
+    void finish(char *digest) {
+        EVP_DigestFinal_ex(context, (unsigned char *)digest, nullptr);
+    }
+
+private:
+    static EVP_MD_CTX *getContext() {
+        thread_local std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> context{
+                EVP_MD_CTX_new(), &EVP_MD_CTX_free};
+        return context.get();
+    }
+
+    EVP_MD_CTX *context{};
+};
+
+std::string_view getHeaderName(const std::string &header) {
+    size_t i = header.find(':');
+    return i == std::string::npos ? std::string_view{header} : std::string_view{header.data(), i};
+}
+} // namespace
+
 S3Time::S3Time() : S3Time{std::time(nullptr)} {}
 
 S3Time::S3Time(std::time_t timestamp) : timestamp{timestamp} {
@@ -54,68 +107,118 @@ S3SignerV4::S3SignerV4(
         std::string_view region) :
     accessKey{accessKey}, secretKey{secretKey}, region{region} {}
 
-void S3SignerV4::generateSigningKey(const S3Time &time) {
+std::shared_ptr<const S3SigningKey> S3SignerV4::getSigningKey(const S3Time &time) const {
+    auto key = signingKey.load(std::memory_order_acquire);
+    if (key && key->day == time.getDay()) {
+        return key;
+    }
+    // Threads racing at the day change derive the same key, any of them may win.
+    return generateSigningKey(time);
+}
+
+std::shared_ptr<const S3SigningKey> S3SignerV4::generateSigningKey(const S3Time &time) const {
+    auto signingKey = std::make_shared<S3SigningKey>();
+    signingKey->day = time.getDay();
     char keys[2][SHA256_DIGEST_LENGTH];
 
-    // Initalize first key with "AWS4" + secret key
-    keys[0][0] = 'A';
-    keys[0][1] = 'W';
-    keys[0][2] = 'S';
-    keys[0][3] = '4';
-    std::memcpy(&keys[0][4], secretKey.data(), secretKey.size());
-    std::string_view key{keys[0], 4 + secretKey.size()};
+    // First key is "AWS4" + secret key, longer than a digest: AWS secret keys are 40 characters.
+    std::string firstKey = "AWS4" + secretKey;
+    std::string_view key{firstKey};
 
     char buffer[S3Time::kBufferSize];
     key = cryptoHmacSha256(key, time.getDate(buffer), keys[1]);
     key = cryptoHmacSha256(key, region, keys[0]);
     key = cryptoHmacSha256(key, std::string_view{"s3"}, keys[1]);
-    key = cryptoHmacSha256(key, std::string_view{"aws4_request"}, signingKey);
+    key = cryptoHmacSha256(key, std::string_view{"aws4_request"}, signingKey->key);
+
+    std::shared_ptr<const S3SigningKey> result = std::move(signingKey);
+    this->signingKey.store(result, std::memory_order_release);
+    return result;
 }
 
 std::string S3SignerV4::getSigningKeyHex() const {
-    return folly::hexlify({signingKey, sizeof(signingKey)});
+    auto key = signingKey.load(std::memory_order_acquire);
+    return key ? folly::hexlify(key->view()) : std::string{};
 }
 
-void S3SignerV4::sign(S3Request &request, const S3Time &time) {
-    char buffer[S3Time::kBufferSize];
+void S3SignerV4::appendScope(std::string &out, std::string_view day) const {
+    out.append(day);
+    out.append("/");
+    out.append(region);
+    out.append("/s3/aws4_request");
+}
 
-    generateSigningKey(time);
+void S3SignerV4::sign(S3Request &request, const S3Time &time) const {
+    char date[S3Time::kBufferSize];
+    char dateTime[S3Time::kBufferSize];
+
+    auto signingKey = getSigningKey(time);
 
     request.prepareToSign(time);
 
-    std::string scope;
-    scope.reserve(64);
-    scope.append(time.getDate(buffer));
-    scope.append("/");
-    scope.append(region);
-    scope.append("/s3/aws4_request");
+    char requestHash[SHA256_DIGEST_LENGTH];
+    request.hashRequest(requestHash);
+    char requestHashHex[2 * SHA256_DIGEST_LENGTH];
+    toHex(requestHash, sizeof(requestHash), requestHashHex);
 
-    std::string toSign;
-    toSign.reserve(256);
+    // Scratch text reused by the thread, its capacity stays after the first request.
+    thread_local std::string toSign;
+    toSign.clear();
     toSign.append("AWS4-HMAC-SHA256\n");
-    toSign.append(time.getDateTime(buffer));
+    toSign.append(time.getDateTime(dateTime));
     toSign.append("\n");
-    toSign.append(scope);
+    std::string_view day = time.getDate(date);
+    appendScope(toSign, day);
     toSign.append("\n");
-    toSign.append(request.getRequestHash());
+    toSign.append(requestHashHex, sizeof(requestHashHex));
 
     char hash[SHA256_DIGEST_LENGTH];
-    cryptoHmacSha256(getSigningKey(), toSign, hash);
-    std::string signature = folly::hexlify({hash, sizeof(hash)});
+    cryptoHmacSha256(signingKey->view(), toSign, hash);
+    char signature[2 * SHA256_DIGEST_LENGTH];
+    toHex(hash, sizeof(hash), signature);
 
+    // Header is built in place: the only allocation of the signature.
     std::string auth;
     auth.reserve(256);
-    auth.append("AWS4-HMAC-SHA256 ");
-    auth.append("Credential=");
+    auth.append("authorization:AWS4-HMAC-SHA256 Credential=");
     auth.append(accessKey);
     auth.append("/");
-    auth.append(scope);
+    // Not a view into @toSign: appends after the scope may reallocate it.
+    appendScope(auth, day);
     auth.append(",SignedHeaders=");
     request.appendHeaderNames(auth);
     auth.append(",Signature=");
-    auth.append(signature);
+    auth.append(signature, sizeof(signature));
+
+    request.headers.add(std::move(auth));
+}
+
+std::string getContentMd5(ByteSpan data) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digestSize = 0;
+    EVP_Digest(data.data(), data.size(), digest, &digestSize, EVP_md5(), nullptr);
+    // 4 characters per 3 bytes and the terminating null.
+    char base64[32];
+    int size = EVP_EncodeBlock((unsigned char *)base64, digest, digestSize);
+    return std::string(base64, size);
+}
 
-    request.headers.add(makeHeader("authorization", auth));
+std::string encodeS3Uri(std::string_view text, bool encodeSlash) {
+    constexpr char kDigits[] = "0123456789ABCDEF";
+    std::string output;
+    output.reserve(text.size());
+    for (char c : text) {
+        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-'
+            || c == '_' || c == '.' || c == '~' || (c == '/' && !encodeSlash)) {
+            output.push_back(c);
+        } else {
+            auto byte = static_cast<unsigned char>(c);
+            output.push_back('%');
+            output.push_back(kDigits[byte >> 4]);
+            output.push_back(kDigits[byte & 0xf]);
+        }
+    }
+    return output;
 }
 
 void S3Request::setHost(std::string host) {
@@ -145,23 +248,25 @@ void S3Request::appendHeaderNames(std::string &output) const {
         } else {
             semicolon = true;
         }
-        size_t i = header.find(':');
-        if (i != std::string::npos) {
-            output.append(header.data(), i);
-        } else {
-            output.append(header);
-        }
+        output.append(getHeaderName(header));
     }
 }
 
 void S3Request::prepareToSign(const S3Time &time) {
     char buffer[S3Time::kBufferSize];
 
-    bodyHash = cryptoSha256Hex(body);
+    if (unsignedPayload) {
+        constexpr std::string_view kUnsignedPayload{"UNSIGNED-PAYLOAD"};
+        std::memcpy(bodyHash, kUnsignedPayload.data(), kUnsignedPayload.size());
+        bodyHashSize = kUnsignedPayload.size();
+    } else {
+        cryptoSha256Hex(body, bodyHash);
+        bodyHashSize = sizeof(bodyHash);
+    }
 
     headers.add(makeHeader("host", host));
     headers.add(makeHeader("x-amz-date", time.getDateTime(buffer)));
-    headers.add(makeHeader("x-amz-content-sha256", bodyHash));
+    headers.add(makeHeader("x-amz-content-sha256", getBodyHash()));
 
     headers.sort();
 }
@@ -193,9 +298,38 @@ std::string S3Request::getRequestTextToHash() const {
     return output;
 }
 
+void S3Request::hashRequest(char *digest) const {
+    // Same text as getRequestTextToHash, hashed piece by piece.
+    Sha256 sha;
+    sha.update(getMethodName(method));
+    sha.update("\n");
+    sha.update(path);
+    sha.update("\n");
+    sha.update(query);
+    sha.update("\n");
+    for (const std::string &header : headers.span()) {
+        sha.update(header);
+        sha.update("\n");
+    }
+    sha.update("\n");
+    bool semicolon = false;
+    for (const std::string &header : headers.span()) {
+        if (semicolon) {
+            sha.update(";");
+        } else {
+            semicolon = true;
+        }
+        sha.update(getHeaderName(header));
+    }
+    sha.update("\n");
+    sha.update(getBodyHash());
+    sha.finish(digest);
+}
+
 std::string S3Request::getRequestHash() const {
-    auto text = getRequestTextToHash();
-    return cryptoSha256Hex(ByteSpan{text.data(), text.size()});
+    char digest[SHA256_DIGEST_LENGTH];
+    hashRequest(digest);
+    return folly::hexlify({digest, SHA256_DIGEST_LENGTH});
 }
 
 } // namespace molecula
@@ -2,7 +2,9 @@
 
 #include "molecula/http_client/HttpClient.hpp"
 
+#include <atomic>
 #include <ctime>
+#include <memory>
 #include <span>
 #include <string>
 #include <string_view>
@@ -20,6 +22,11 @@ public:
     std::string_view getDate(char *buffer) const;
     std::string_view getDateTime(char *buffer) const;
 
+    // Days since the epoch, UTC. Signing key changes with the day.
+    long getDay() const {
+        return static_cast<long>(timestamp / 86'400);
+    }
+
 private:
     std::time_t timestamp{};
     std::tm tm{};
@@ -31,6 +38,9 @@ public:
     HttpHeaders headers;
     HttpMethod method{HttpMethod::GET};
     ByteSpan body;
+    // Sign "UNSIGNED-PAYLOAD" instead of the body hash. Saves hashing large bodies, TLS still
+    // protects the data.
+    bool unsignedPayload{};
 
     void setHost(std::string host);
 
@@ -57,39 +67,66 @@ public:
     std::string getRequestTextToHash() const;
 
     std::string getRequestHash() const;
+    // SHA-256 of the canonical request text without building it. @digest must be 32 bytes long.
+    void hashRequest(char *digest) const;
 
     std::string_view getBodyHash() const {
-        return bodyHash;
+        return {bodyHash, bodyHashSize};
     }
 
 private:
     std::string host;
     std::string path;
     std::string query;
-    std::string bodyHash;
+    // Hex SHA-256 or UNSIGNED-PAYLOAD, set by @prepareToSign.
+    char bodyHash[64]{};
+    size_t bodyHashSize{};
+};
+
+// Percent-encodes @text for a canonical URI or query: all but unreserved characters, and '/'
+// only if @encodeSlash.
+std::string encodeS3Uri(std::string_view text, bool encodeSlash);
+
+// Base64 MD5 of @data for the Content-MD5 header.
+std::string getContentMd5(ByteSpan data);
+
+// Key derived from the secret key for one day and the signer region.
+class S3SigningKey {
+public:
+    long day{};
+    // SHA256_DIGEST_LENGTH is 32 bytes.
+    char key[32]{};
+
+    std::string_view view() const {
+        return {key, sizeof(key)};
+    }
 };
 
+// Thread safe. The signing key is derived once per day and published with an atomic
+// shared_ptr, so signing a request takes only the request HMAC.
 class S3SignerV4 {
 public:
     S3SignerV4(std::string_view accessKey, std::string_view secretKey, std::string_view region);
 
-    void generateSigningKey(const S3Time &time);
-
-    std::string_view getSigningKey() const {
-        return {signingKey, sizeof(signingKey)};
-    }
+    // Returns the cached key for the day of @time, generates it on a day change.
+    std::shared_ptr<const S3SigningKey> getSigningKey(const S3Time &time) const;
+    // Generates the key for the day of @time and caches it.
+    std::shared_ptr<const S3SigningKey> generateSigningKey(const S3Time &time) const;
 
+    // Hex of the cached key, empty if there is none yet.
     std::string getSigningKeyHex() const;
 
-    void sign(S3Request &request, const S3Time &time);
+    void sign(S3Request &request, const S3Time &time) const;
 
 private:
+    // Appends the credential scope "<day>/<region>/s3/aws4_request".
+    void appendScope(std::string &out, std::string_view day) const;
+
     std::string accessKey;
     std::string secretKey;
     std::string region;
 
-    // SHA256_DIGEST_LENGTH is 32 bytes.
-    char signingKey[32]{};
+    mutable std::atomic<std::shared_ptr<const S3SigningKey>> signingKey;
 };
 
 } // namespace molecula
@@ -0,0 +1,81 @@
+#include "molecula/s3/S3Retry.hpp"
+
+#include <algorithm>
+#include <random>
+
+namespace molecula {
+
+bool isS3Retryable(const folly::Try<HttpResponse> &result) {
+    if (!result.hasValue()) {
+        return false;
+    }
+    const HttpResponse &response = result.value();
+    switch (response.error) {
+    case HttpError::None:
+        break;
+    case HttpError::Timeout:
+    case HttpError::Connection:
+        return true;
+    case HttpError::Other:
+        return false;
+    }
+    switch (response.status) {
+    case 429:
+    case 500:
+    case 502:
+    case 503:
+    case 504:
+        return true;
+    default:
+        return false;
+    }
+}
+
+folly::Try<HttpResponse> dropPartialResponse(folly::Try<HttpResponse> result) {
+    if (result.hasValue() && result.value().error != HttpError::None) {
+        result.value().status = 0;
+        result.value().body.clear();
+        result.value().outputSize = 0;
+    }
+    return result;
+}
+
+bool isIdempotent(HttpMethod method) {
+    return method != HttpMethod::POST;
+}
+
+std::chrono::milliseconds getS3RetryDelay(const S3RetryConfig &config, int attempt) {
+    thread_local std::minstd_rand random{std::random_device{}()};
+    // Cap the shift, the delay is bounded by maxDelay long before.
+    long ceiling = config.baseDelay.count() << std::min(attempt, 20);
+    ceiling = std::min<long>(ceiling, config.maxDelay.count());
+    std::uniform_int_distribution<long> distribution{0, std::max<long>(ceiling, 0)};
+    return std::chrono::milliseconds{distribution(random)};
+}
+
+S3RetryBudget::S3RetryBudget(const S3RetryConfig &config) :
+    capacity{config.budgetCapacity * kScale},
+    depositAmount{static_cast<long>(config.budgetRatio * kScale)},
+    balance{capacity} {}
+
+void S3RetryBudget::deposit() {
+    long current = balance.load(std::memory_order_relaxed);
+    while (current < capacity
+           && !balance.compare_exchange_weak(
+                   current,
+                   std::min(current + depositAmount, capacity),
+                   std::memory_order_relaxed)) {
+    }
+}
+
+bool S3RetryBudget::tryWithdraw() {
+    long current = balance.load(std::memory_order_relaxed);
+    while (current >= kScale) {
+        if (balance.compare_exchange_weak(current, current - kScale, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace molecula
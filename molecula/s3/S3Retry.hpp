@@ -0,0 +1,45 @@
+#pragma once
+
+#include "folly/Try.h"
+#include "molecula/http_client/HttpClient.hpp"
+#include "molecula/s3/S3Client.hpp"
+
+#include <atomic>
+#include <chrono>
+
+namespace molecula {
+
+// Whether the same request may succeed later: throttling, server errors, timeouts and
+// connection failures. Cancellation and client errors are final.
+bool isS3Retryable(const folly::Try<HttpResponse> &result);
+
+// Result returned when retries end. A transfer that failed after the headers arrived gets status
+// 0 and an empty body: its partial data must not pass for a 2xx response.
+folly::Try<HttpResponse> dropPartialResponse(folly::Try<HttpResponse> result);
+
+// Whether repeating the request is safe if the first attempt reached the server.
+bool isIdempotent(HttpMethod method);
+
+// Random delay before retry number @attempt (from 0) with full jitter.
+std::chrono::milliseconds getS3RetryDelay(const S3RetryConfig &config, int attempt);
+
+// Token bucket that limits retries to a fraction of requests. Thread safe.
+class S3RetryBudget {
+public:
+    explicit S3RetryBudget(const S3RetryConfig &config);
+
+    // Called for every new request.
+    void deposit();
+    // Takes a token for a retry, returns false if there is none.
+    bool tryWithdraw();
+
+private:
+    // Tokens in thousandths, to add fractions without floating point atomics.
+    static constexpr long kScale = 1'000;
+
+    const long capacity{};
+    const long depositAmount{};
+    std::atomic<long> balance{};
+};
+
+} // namespace molecula
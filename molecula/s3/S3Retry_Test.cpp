@@ -0,0 +1,89 @@
+#include "molecula/s3/S3Retry.hpp"
+
+#include <gtest/gtest.h>
+
+namespace molecula {
+
+namespace {
+folly::Try<HttpResponse> makeResponse(long status, HttpError error = HttpError::None) {
+    HttpResponse response;
+    response.status = status;
+    response.error = error;
+    return folly::Try<HttpResponse>{std::move(response)};
+}
+} // namespace
+
+GTEST_TEST(S3Retry, isS3Retryable) {
+    EXPECT_TRUE(isS3Retryable(makeResponse(503)));
+    EXPECT_TRUE(isS3Retryable(makeResponse(500)));
+    EXPECT_TRUE(isS3Retryable(makeResponse(429)));
+    EXPECT_TRUE(isS3Retryable(makeResponse(0, HttpError::Timeout)));
+    EXPECT_TRUE(isS3Retryable(makeResponse(0, HttpError::Connection)));
+    EXPECT_TRUE(isS3Retryable(makeResponse(206, HttpError::Timeout)));
+    EXPECT_FALSE(isS3Retryable(makeResponse(200)));
+    EXPECT_FALSE(isS3Retryable(makeResponse(403)));
+    EXPECT_FALSE(isS3Retryable(makeResponse(404)));
+    EXPECT_FALSE(isS3Retryable(makeResponse(0, HttpError::Other)));
+    EXPECT_FALSE(isS3Retryable(
+            folly::Try<HttpResponse>{folly::make_exception_wrapper<folly::FutureCancellation>()}));
+}
+
+GTEST_TEST(S3Retry, dropPartialResponse) {
+    auto partial = makeResponse(200, HttpError::Timeout);
+    partial.value().body.append("da");
+    auto result = dropPartialResponse(std::move(partial));
+    EXPECT_EQ(result.value().status, 0);
+    EXPECT_EQ(result.value().error, HttpError::Timeout);
+    EXPECT_EQ(result.value().body.size(), 0);
+
+    EXPECT_EQ(dropPartialResponse(makeResponse(200)).value().status, 200);
+    EXPECT_EQ(dropPartialResponse(makeResponse(503)).value().status, 503);
+}
+
+GTEST_TEST(S3Retry, isIdempotent) {
+    EXPECT_TRUE(isIdempotent(HttpMethod::GET));
+    EXPECT_TRUE(isIdempotent(HttpMethod::HEAD));
+    EXPECT_TRUE(isIdempotent(HttpMethod::PUT));
+    EXPECT_TRUE(isIdempotent(HttpMethod::DELETE));
+    EXPECT_FALSE(isIdempotent(HttpMethod::POST));
+}
+
+GTEST_TEST(S3Retry, getS3RetryDelay) {
+    S3RetryConfig config;
+    config.baseDelay = std::chrono::milliseconds{10};
+    config.maxDelay = std::chrono::milliseconds{100};
+    for (int i = 0; i < 100; i++) {
+        EXPECT_LE(getS3RetryDelay(config, 0).count(), 10);
+        EXPECT_LE(getS3RetryDelay(config, 2).count(), 40);
+        EXPECT_LE(getS3RetryDelay(config, 10).count(), 100);
+        EXPECT_LE(getS3RetryDelay(config, 100).count(), 100);
+    }
+}
+
+GTEST_TEST(S3Retry, S3RetryBudget) {
+    S3RetryConfig config;
+    config.budgetRatio = 0.5;
+    config.budgetCapacity = 2;
+    S3RetryBudget budget{config};
+
+    // Starts full
+    EXPECT_TRUE(budget.tryWithdraw());
+    EXPECT_TRUE(budget.tryWithdraw());
+    EXPECT_FALSE(budget.tryWithdraw());
+
+    // Two requests earn one retry
+    budget.deposit();
+    EXPECT_FALSE(budget.tryWithdraw());
+    budget.deposit();
+    EXPECT_TRUE(budget.tryWithdraw());
+
+    // Capped by capacity
+    for (int i = 0; i < 10; i++) {
+        budget.deposit();
+    }
+    EXPECT_TRUE(budget.tryWithdraw());
+    EXPECT_TRUE(budget.tryWithdraw());
+    EXPECT_FALSE(budget.tryWithdraw());
+}
+
+} // namespace molecula
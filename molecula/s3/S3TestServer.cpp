@@ -0,0 +1,980 @@
+#include "molecula/s3/S3TestServer.hpp"
+
+#include "molecula/s3/S3Client.hpp"
+#include "molecula/s3/S3Xml.hpp"
+
+#include <glog/logging.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace molecula {
+
+namespace {
+constexpr size_t kMaxHeaderSize = 64 * 1024;
+// Bodies up to this size are sent with the headers in one write.
+constexpr size_t kMaxInlineBody = 64 * 1024;
+
+std::string decodeUri(std::string_view text) {
+    std::string result;
+    result.reserve(text.size());
+    for (size_t i = 0; i < text.size(); i++) {
+        int value = 0;
+        if (text[i] == '%' && i + 2 < text.size()) {
+            auto [ptr, ec] = std::from_chars(text.data() + i + 1, text.data() + i + 3, value, 16);
+            if (ec == std::errc{} && ptr == text.data() + i + 3) {
+                result.push_back(static_cast<char>(value));
+                i += 2;
+                continue;
+            }
+        }
+        result.push_back(text[i]);
+    }
+    return result;
+}
+
+std::string toLower(std::string_view text) {
+    std::string result{text};
+    std::transform(result.begin(), result.end(), result.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    return result;
+}
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+std::string_view getReason(int status) {
+    switch (status) {
+    case 200:
+        return "OK";
+    case 204:
+        return "No Content";
+    case 206:
+        return "Partial Content";
+    case 304:
+        return "Not Modified";
+    case 400:
+        return "Bad Request";
+    case 404:
+        return "Not Found";
+    case 412:
+        return "Precondition Failed";
+    case 416:
+        return "Range Not Satisfiable";
+    case 500:
+        return "Internal Server Error";
+    case 501:
+        return "Not Implemented";
+    case 503:
+        return "Service Unavailable";
+    default:
+        return "Error";
+    }
+}
+
+std::string_view getErrorCode(int status) {
+    switch (status) {
+    case 400:
+        return "InvalidRequest";
+    case 404:
+        return "NoSuchKey";
+    case 412:
+        return "PreconditionFailed";
+    case 416:
+        return "InvalidRange";
+    case 501:
+        return "NotImplemented";
+    case 503:
+        return "SlowDown";
+    default:
+        return "InternalError";
+    }
+}
+
+std::string formatTime(std::time_t time, const char *format) {
+    std::tm tm{};
+    ::gmtime_r(&time, &tm);
+    char buffer[64];
+    size_t n = std::strftime(buffer, sizeof(buffer), format, &tm);
+    return std::string{buffer, n};
+}
+
+std::string makeEtag(std::string_view text) {
+    char buffer[24];
+    size_t hash = std::hash<std::string_view>{}(text);
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), hash, 16);
+    return "\"" + std::string{buffer, end} + "\"";
+}
+
+// "bytes=first-last", "bytes=first-" or "bytes=-suffix" as [begin, end) of an object of @size.
+// Begin is past the object if the range is not satisfiable. Nothing if the header is invalid,
+// then the whole object is sent.
+std::optional<std::pair<long, long>> parseRange(std::string_view header, long size) {
+    constexpr std::string_view kPrefix = "bytes=";
+    if (!header.starts_with(kPrefix)) {
+        return std::nullopt;
+    }
+    header.remove_prefix(kPrefix.size());
+    size_t dash = header.find('-');
+    if (dash == std::string_view::npos) {
+        return std::nullopt;
+    }
+    auto parse = [](std::string_view text, long &value) {
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return !text.empty() && ec == std::errc{} && ptr == text.data() + text.size();
+    };
+    std::string_view firstStr = header.substr(0, dash);
+    std::string_view lastStr = header.substr(dash + 1);
+    long first = 0;
+    long last = 0;
+    if (firstStr.empty()) {
+        if (!parse(lastStr, last)) {
+            return std::nullopt;
+        }
+        if (last <= 0) {
+            return std::pair{size, size};
+        }
+        return std::pair{std::max(0L, size - last), size};
+    }
+    if (!parse(firstStr, first)) {
+        return std::nullopt;
+    }
+    if (lastStr.empty()) {
+        last = size - 1;
+    } else if (!parse(lastStr, last)) {
+        return std::nullopt;
+    }
+    if (first >= size) {
+        return std::pair{first, first};
+    }
+    if (last < first) {
+        return std::nullopt;
+    }
+    return std::pair{first, std::min(last, size - 1) + 1};
+}
+
+bool isSafeKey(std::string_view key) {
+    for (const auto &part : std::filesystem::path{key}) {
+        if (part == "..") {
+            return false;
+        }
+    }
+    return true;
+}
+
+S3ClientConfig getRetryConfig(int maxAttempts) {
+    S3ClientConfig config;
+    config.retry.maxAttempts = maxAttempts;
+    config.retry.baseDelay = std::chrono::milliseconds{1};
+    return config;
+}
+} // namespace
+
+S3TestServer::S3TestServer(const S3TestServerConfig &config) :
+    config{config}, random{config.seed} {
+    if (!config.directory.empty()) {
+        std::filesystem::create_directories(config.directory);
+    }
+    listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        throw std::runtime_error(std::string{"Failed to open socket: "} + std::strerror(errno));
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addrSize = sizeof(addr);
+    if (::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0
+        || ::listen(listenFd, SOMAXCONN) != 0
+        || ::getsockname(listenFd, reinterpret_cast<sockaddr *>(&addr), &addrSize) != 0) {
+        std::string error = std::strerror(errno);
+        ::close(listenFd);
+        throw std::runtime_error("Failed to listen on loopback: " + error);
+    }
+    port = ntohs(addr.sin_port);
+    acceptThread = std::thread{&S3TestServer::acceptLoop, this};
+}
+
+S3TestServer::~S3TestServer() {
+    {
+        std::lock_guard lock{mutex};
+        stopping = true;
+        for (int fd : connections) {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+    }
+    // Wakes up accept.
+    ::shutdown(listenFd, SHUT_RDWR);
+    acceptThread.join();
+    ::close(listenFd);
+    for (std::thread &thread : connectionThreads) {
+        thread.join();
+    }
+}
+
+std::string S3TestServer::getEndpoint() const {
+    return "http://127.0.0.1:" + std::to_string(port);
+}
+
+void S3TestServer::putObject(std::string_view bucket, std::string_view key, std::string data) {
+    storeObject(std::string{bucket}, std::string{key}, std::move(data));
+}
+
+std::optional<std::string> S3TestServer::getObject(std::string_view bucket, std::string_view key) {
+    auto object = findObject(std::string{bucket}, std::string{key});
+    if (!object) {
+        return std::nullopt;
+    }
+    if (object->data) {
+        return *object->data;
+    }
+    auto data = readFile(object->path, 0, object->size);
+    return data ? std::optional<std::string>{*data} : std::nullopt;
+}
+
+void S3TestServer::failRequests(int count, int status, int skip) {
+    std::lock_guard lock{mutex};
+    failCount = count;
+    failStatus = status;
+    failSkip = skip;
+}
+
+int S3TestServer::getNumUploads() {
+    std::lock_guard lock{mutex};
+    return static_cast<int>(uploads.size());
+}
+
+void S3TestServer::denyDeletes(std::string_view bucket, std::string_view prefix) {
+    std::lock_guard lock{mutex};
+    deniedDeletes.push_back(std::string{bucket} + "/" + std::string{prefix});
+}
+
+bool S3TestServer::isDeleteDenied(const std::string &bucket, const std::string &key) {
+    std::string path = bucket + "/" + key;
+    std::lock_guard lock{mutex};
+    return std::any_of(deniedDeletes.begin(), deniedDeletes.end(), [&path](const auto &prefix) {
+        return path.starts_with(prefix);
+    });
+}
+
+S3TestServerStats S3TestServer::getStats() const {
+    S3TestServerStats stats;
+    stats.connections = numConnections.load();
+    stats.requests = numRequests.load();
+    stats.bytesReceived = numBytesReceived.load();
+    stats.bytesSent = numBytesSent.load();
+    stats.errors = numErrors.load();
+    stats.resets = numResets.load();
+    return stats;
+}
+
+void S3TestServer::acceptLoop() {
+    while (true) {
+        int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            std::string error = std::strerror(errno);
+            std::lock_guard lock{mutex};
+            if (!stopping) {
+                LOG(ERROR) << "Test server accept failed: " << error;
+            }
+            return;
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        std::lock_guard lock{mutex};
+        if (stopping) {
+            ::close(fd);
+            return;
+        }
+        numConnections++;
+        connections.insert(fd);
+        connectionThreads.emplace_back(&S3TestServer::serve, this, fd);
+    }
+}
+
+void S3TestServer::serve(int fd) {
+    std::string buffer;
+    Request req;
+    while (readRequest(fd, buffer, req)) {
+        numRequests++;
+        int fault = drawFault();
+        if (fault < 0) {
+            // Close with RST, like a connection reset by a load balancer.
+            numResets++;
+            linger reset{1, 0};
+            ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+            break;
+        }
+        Response response;
+        if (fault > 0) {
+            numErrors++;
+            response = makeError(fault);
+        } else {
+            response = handle(req);
+        }
+        response.headersOnly = response.headersOnly || req.method == "HEAD";
+        std::this_thread::sleep_for(drawLatency());
+        bool close = toLower(req.headers["connection"]) == "close";
+        if (!send(fd, response, close) || close) {
+            break;
+        }
+    }
+    {
+        std::lock_guard lock{mutex};
+        connections.erase(fd);
+    }
+    ::close(fd);
+}
+
+bool S3TestServer::receive(int fd, std::string &buffer) {
+    char data[64 * 1024];
+    while (true) {
+        ssize_t n = ::recv(fd, data, sizeof(data), 0);
+        if (n > 0) {
+            buffer.append(data, n);
+            numBytesReceived += n;
+            return true;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        return false;
+    }
+}
+
+bool S3TestServer::readRequest(int fd, std::string &buffer, Request &req) {
+    size_t headerEnd;
+    while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+        if (buffer.size() > kMaxHeaderSize || !receive(fd, buffer)) {
+            return false;
+        }
+    }
+    req = Request{};
+    std::string_view head{buffer.data(), headerEnd};
+    size_t lineEnd = std::min(head.find("\r\n"), head.size());
+    // "GET /bucket/key?query HTTP/1.1"
+    std::string_view line = head.substr(0, lineEnd);
+    size_t space1 = line.find(' ');
+    size_t space2 = line.rfind(' ');
+    if (space1 == std::string_view::npos || space2 <= space1) {
+        return false;
+    }
+    req.method = line.substr(0, space1);
+    std::string_view target = line.substr(space1 + 1, space2 - space1 - 1);
+    std::string_view query;
+    if (size_t mark = target.find('?'); mark != std::string_view::npos) {
+        query = target.substr(mark + 1);
+        target = target.substr(0, mark);
+    }
+    std::string path = decodeUri(target);
+    size_t bucketStart = path.starts_with('/') ? 1 : 0;
+    size_t bucketEnd = std::min(path.find('/', bucketStart), path.size());
+    req.bucket = path.substr(bucketStart, bucketEnd - bucketStart);
+    if (bucketEnd < path.size()) {
+        req.key = path.substr(bucketEnd + 1);
+    }
+    while (!query.empty()) {
+        size_t amp = std::min(query.find('&'), query.size());
+        std::string_view param = query.substr(0, amp);
+        size_t eq = std::min(param.find('='), param.size());
+        std::string_view value = eq < param.size() ? param.substr(eq + 1) : std::string_view{};
+        req.query[decodeUri(param.substr(0, eq))] = decodeUri(value);
+        query.remove_prefix(std::min(amp + 1, query.size()));
+    }
+    for (size_t pos = lineEnd + 2; pos < head.size();) {
+        size_t end = std::min(head.find("\r\n", pos), head.size());
+        std::string_view header = head.substr(pos, end - pos);
+        if (size_t colon = header.find(':'); colon != std::string_view::npos) {
+            req.headers[toLower(trim(header.substr(0, colon)))] = trim(header.substr(colon + 1));
+        }
+        pos = end + 2;
+    }
+
+    if (req.headers.contains("transfer-encoding")) {
+        LOG(ERROR) << "Test server doesn't support chunked requests";
+        return false;
+    }
+    size_t bodySize = 0;
+    const std::string &contentLength = req.headers["content-length"];
+    std::from_chars(contentLength.data(), contentLength.data() + contentLength.size(), bodySize);
+    buffer.erase(0, headerEnd + 4);
+    if (toLower(req.headers["expect"]) == "100-continue" && buffer.size() < bodySize
+        && !sendAll(fd, "HTTP/1.1 100 Continue\r\n\r\n")) {
+        return false;
+    }
+    while (buffer.size() < bodySize) {
+        if (!receive(fd, buffer)) {
+            return false;
+        }
+    }
+    req.body = buffer.substr(0, bodySize);
+    buffer.erase(0, bodySize);
+    return true;
+}
+
+S3TestServer::Response S3TestServer::handle(Request &req) {
+    if (req.bucket.empty() || !isSafeKey(req.key)) {
+        return makeError(400);
+    }
+    if (req.method == "POST" && req.key.empty() && req.query.contains("delete")) {
+        return handleDelete(req);
+    }
+    if (req.query.contains("uploadId") || req.query.contains("uploads")) {
+        return req.key.empty() ? makeError(501) : handleMultipart(req);
+    }
+    if (req.method == "POST") {
+        return makeError(501);
+    }
+    if (req.key.empty()) {
+        return req.method == "GET" ? handleList(req) : makeError(501);
+    }
+    if (req.method == "GET" || req.method == "HEAD") {
+        return handleGet(req);
+    }
+    if (req.method == "PUT") {
+        Response response;
+        response.headers.emplace_back(
+                "ETag", storeObject(req.bucket, req.key, std::move(req.body)));
+        return response;
+    }
+    if (req.method == "DELETE") {
+        removeObject(req.bucket, req.key);
+        Response response;
+        response.status = 204;
+        return response;
+    }
+    return makeError(501);
+}
+
+S3TestServer::Response S3TestServer::handleGet(const Request &req) {
+    auto object = findObject(req.bucket, req.key);
+    if (!object) {
+        return makeError(404);
+    }
+    Response response;
+    response.headers.emplace_back("ETag", object->etag);
+    response.headers.emplace_back("Last-Modified", formatS3Time(object->lastModified));
+    if (auto ifMatch = req.headers.find("if-match");
+        ifMatch != req.headers.end() && ifMatch->second != object->etag && ifMatch->second != "*") {
+        return makeError(412);
+    }
+    // If-None-Match takes precedence over If-Modified-Since.
+    auto ifNoneMatch = req.headers.find("if-none-match");
+    auto ifModifiedSince = req.headers.find("if-modified-since");
+    if (ifNoneMatch != req.headers.end()
+                ? ifNoneMatch->second == object->etag || ifNoneMatch->second == "*"
+                : ifModifiedSince != req.headers.end()
+                        && object->lastModified <= parseS3Time(ifModifiedSince->second)) {
+        response.status = 304;
+        return response;
+    }
+    long begin = 0;
+    long end = object->size;
+    if (auto range = req.headers.find("range"); range != req.headers.end()) {
+        if (auto parsed = parseRange(range->second, object->size)) {
+            if (parsed->first >= object->size) {
+                Response error = makeError(416);
+                error.headers.emplace_back("Content-Range", "bytes */" + std::to_string(end));
+                return error;
+            }
+            std::tie(begin, end) = *parsed;
+            response.status = 206;
+            response.headers.emplace_back(
+                    "Content-Range",
+                    "bytes " + std::to_string(begin) + "-" + std::to_string(end - 1) + "/"
+                            + std::to_string(object->size));
+        }
+    }
+    response.headers.emplace_back("Content-Type", "application/octet-stream");
+    response.size = end - begin;
+    if (req.method == "HEAD") {
+        response.headersOnly = true;
+        return response;
+    }
+    if (object->data) {
+        response.body = object->data;
+        response.offset = begin;
+    } else if (!(response.body = readFile(object->path, begin, end - begin))) {
+        return makeError(500);
+    }
+    return response;
+}
+
+S3TestServer::Response S3TestServer::handleList(const Request &req) {
+    auto getParam = [&req](const char *name) {
+        auto it = req.query.find(name);
+        return it == req.query.end() ? std::string{} : it->second;
+    };
+    if (getParam("list-type") != "2") {
+        return makeError(501);
+    }
+    std::string prefix = getParam("prefix");
+    std::string delimiter = getParam("delimiter");
+    std::string token = std::max(getParam("continuation-token"), getParam("start-after"));
+    int maxKeys = 1000;
+    std::string maxKeysStr = getParam("max-keys");
+    std::from_chars(maxKeysStr.data(), maxKeysStr.data() + maxKeysStr.size(), maxKeys);
+    maxKeys = std::clamp(maxKeys, 0, 1000);
+
+    std::string items;
+    int count = 0;
+    bool truncated = false;
+    // Continuation token is the last key or common prefix of the page.
+    std::string last;
+    std::string lastPrefix;
+    for (auto &[key, object] : listObjects(req.bucket, prefix, token)) {
+        std::string commonPrefix;
+        if (size_t pos = delimiter.empty() ? std::string::npos : key.find(delimiter, prefix.size());
+            pos != std::string::npos) {
+            commonPrefix = key.substr(0, pos + delimiter.size());
+            // Rolled up on this page or the previous one.
+            if (commonPrefix == lastPrefix || commonPrefix == token) {
+                continue;
+            }
+        }
+        if (count == maxKeys) {
+            truncated = true;
+            break;
+        }
+        count++;
+        if (!commonPrefix.empty()) {
+            items.append("<CommonPrefixes><Prefix>");
+            appendXmlEscaped(items, commonPrefix);
+            items.append("</Prefix></CommonPrefixes>");
+            last = lastPrefix = std::move(commonPrefix);
+            continue;
+        }
+        items.append("<Contents><Key>");
+        appendXmlEscaped(items, key);
+        items.append("</Key><LastModified>");
+        items.append(formatTime(object.lastModified, "%Y-%m-%dT%H:%M:%S.000Z"));
+        items.append("</LastModified><ETag>");
+        appendXmlEscaped(items, object.etag);
+        items.append("</ETag><Size>");
+        items.append(std::to_string(object.size));
+        items.append("</Size><StorageClass>STANDARD</StorageClass></Contents>");
+        last = key;
+    }
+
+    std::string xml{
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<ListBucketResult xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\"><Name>"};
+    appendXmlEscaped(xml, req.bucket);
+    xml.append("</Name><Prefix>");
+    appendXmlEscaped(xml, prefix);
+    xml.append("</Prefix><KeyCount>").append(std::to_string(count));
+    xml.append("</KeyCount><MaxKeys>").append(std::to_string(maxKeys)).append("</MaxKeys>");
+    if (!delimiter.empty()) {
+        xml.append("<Delimiter>");
+        appendXmlEscaped(xml, delimiter);
+        xml.append("</Delimiter>");
+    }
+    xml.append("<IsTruncated>").append(truncated ? "true" : "false").append("</IsTruncated>");
+    if (truncated) {
+        xml.append("<NextContinuationToken>");
+        appendXmlEscaped(xml, last);
+        xml.append("</NextContinuationToken>");
+    }
+    xml.append(items).append("</ListBucketResult>");
+    return makeXml(200, std::move(xml));
+}
+
+S3TestServer::Response S3TestServer::handleDelete(const Request &req) {
+    std::string items;
+    bool quiet = getXmlElement(req.body, "Quiet") == "true";
+    int count = 0;
+    S3XmlScanner scanner{req.body};
+    while (auto element = scanner.next("Object")) {
+        std::string key = unescapeXml(getXmlElement(*element, "Key"));
+        if (key.empty() || !isSafeKey(key) || ++count > 1000) {
+            return makeError(400);
+        }
+        if (isDeleteDenied(req.bucket, key)) {
+            items.append("<Error><Key>");
+            appendXmlEscaped(items, key);
+            items.append("</Key><Code>AccessDenied</Code><Message>Access Denied</Message></Error>");
+            continue;
+        }
+        removeObject(req.bucket, key);
+        if (!quiet) {
+            items.append("<Deleted><Key>");
+            appendXmlEscaped(items, key);
+            items.append("</Key></Deleted>");
+        }
+    }
+    if (count == 0) {
+        return makeError(400);
+    }
+    std::string xml{
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<DeleteResult xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">"};
+    xml.append(items).append("</DeleteResult>");
+    return makeXml(200, std::move(xml));
+}
+
+S3TestServer::Response S3TestServer::handleMultipart(Request &req) {
+    if (req.method == "POST" && req.query.contains("uploads")) {
+        std::string uploadId;
+        {
+            std::lock_guard lock{mutex};
+            uploadId = "upload" + std::to_string(++lastUploadId);
+            Upload &upload = uploads[uploadId];
+            upload.bucket = req.bucket;
+            upload.key = req.key;
+        }
+        std::string xml{
+                "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                "<InitiateMultipartUploadResult><Bucket>"};
+        appendXmlEscaped(xml, req.bucket);
+        xml.append("</Bucket><Key>");
+        appendXmlEscaped(xml, req.key);
+        xml.append("</Key><UploadId>").append(uploadId);
+        xml.append("</UploadId></InitiateMultipartUploadResult>");
+        return makeXml(200, std::move(xml));
+    }
+    auto it = req.query.find("uploadId");
+    if (it == req.query.end()) {
+        return makeError(400);
+    }
+    const std::string &uploadId = it->second;
+
+    if (req.method == "PUT") {
+        auto part = req.query.find("partNumber");
+        std::string_view number = part == req.query.end() ? std::string_view{} : part->second;
+        int partNumber = 0;
+        std::from_chars(number.data(), number.data() + number.size(), partNumber);
+        if (partNumber < 1 || partNumber > 10'000) {
+            return makeError(400);
+        }
+        std::string etag = makeEtag(req.body);
+        std::lock_guard lock{mutex};
+        auto upload = uploads.find(uploadId);
+        if (upload == uploads.end() || upload->second.bucket != req.bucket
+            || upload->second.key != req.key) {
+            return makeError(404);
+        }
+        upload->second.parts[partNumber] = {etag, std::move(req.body)};
+        Response response;
+        response.headers.emplace_back("ETag", std::move(etag));
+        return response;
+    }
+
+    if (req.method == "DELETE") {
+        std::lock_guard lock{mutex};
+        if (uploads.erase(uploadId) == 0) {
+            return makeError(404);
+        }
+        Response response;
+        response.status = 204;
+        return response;
+    }
+
+    if (req.method != "POST") {
+        return makeError(501);
+    }
+    // CompleteMultipartUpload: the listed parts in ascending order, with their current ETags.
+    std::string data;
+    {
+        std::lock_guard lock{mutex};
+        auto upload = uploads.find(uploadId);
+        if (upload == uploads.end() || upload->second.bucket != req.bucket
+            || upload->second.key != req.key) {
+            return makeError(404);
+        }
+        auto &parts = upload->second.parts;
+        int lastPartNumber = 0;
+        S3XmlScanner scanner{req.body};
+        while (auto element = scanner.next("Part")) {
+            int partNumber = 0;
+            std::string_view number = getXmlElement(*element, "PartNumber");
+            std::from_chars(number.data(), number.data() + number.size(), partNumber);
+            auto part = parts.find(partNumber);
+            if (partNumber <= lastPartNumber || part == parts.end()
+                || part->second.first != unescapeXml(getXmlElement(*element, "ETag"))) {
+                return makeError(400);
+            }
+            data.append(part->second.second);
+            lastPartNumber = partNumber;
+        }
+        if (lastPartNumber == 0) {
+            return makeError(400);
+        }
+        uploads.erase(upload);
+    }
+    std::string etag = storeObject(req.bucket, req.key, std::move(data));
+    std::string xml{
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<CompleteMultipartUploadResult><Bucket>"};
+    appendXmlEscaped(xml, req.bucket);
+    xml.append("</Bucket><Key>");
+    appendXmlEscaped(xml, req.key);
+    xml.append("</Key><ETag>");
+    appendXmlEscaped(xml, etag);
+    xml.append("</ETag></CompleteMultipartUploadResult>");
+    return makeXml(200, std::move(xml));
+}
+
+S3TestServer::Response S3TestServer::makeError(int status) {
+    std::string xml{"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<Error><Code>"};
+    xml.append(getErrorCode(status)).append("</Code><Message>");
+    xml.append(getReason(status)).append("</Message></Error>");
+    return makeXml(status, std::move(xml));
+}
+
+S3TestServer::Response S3TestServer::makeXml(int status, std::string xml) {
+    Response response;
+    response.status = status;
+    response.headers.emplace_back("Content-Type", "application/xml");
+    response.size = xml.size();
+    response.body = std::make_shared<const std::string>(std::move(xml));
+    return response;
+}
+
+int S3TestServer::drawFault() {
+    std::lock_guard lock{mutex};
+    if (failSkip > 0) {
+        failSkip--;
+    } else if (failCount > 0) {
+        failCount--;
+        return failStatus;
+    }
+    // One draw per request keeps the sequence reproducible for a given seed.
+    double draw = std::uniform_real_distribution<double>{}(random);
+    if (draw < config.resetRate) {
+        return -1;
+    }
+    if (draw < config.resetRate + config.errorRate) {
+        return config.errorStatus;
+    }
+    return 0;
+}
+
+std::chrono::microseconds S3TestServer::drawLatency() {
+    const S3TestLatency &latency = config.latency;
+    if (latency.median.count() <= 0) {
+        return {};
+    }
+    // 2.326 is the 99th percentile of the standard normal distribution.
+    double sigma = latency.p99 > latency.median
+            ? std::log(static_cast<double>(latency.p99.count()) / latency.median.count()) / 2.326
+            : 0.0;
+    std::lognormal_distribution<double> distribution{
+            std::log(static_cast<double>(latency.median.count())), sigma};
+    std::lock_guard lock{mutex};
+    return std::chrono::microseconds{std::llround(distribution(random))};
+}
+
+bool S3TestServer::send(int fd, const Response &response, bool close) {
+    std::string head{"HTTP/1.1 "};
+    head.append(std::to_string(response.status)).append(" ");
+    head.append(getReason(response.status)).append("\r\n");
+    for (const auto &[name, value] : response.headers) {
+        head.append(name).append(": ").append(value).append("\r\n");
+    }
+    head.append("Content-Length: ").append(std::to_string(response.size)).append("\r\n");
+    if (close) {
+        head.append("Connection: close\r\n");
+    }
+    head.append("\r\n");
+    if (response.headersOnly || !response.body) {
+        return sendAll(fd, head);
+    }
+    std::string_view body{response.body->data() + response.offset, response.size};
+    if (config.bandwidth <= 0) {
+        if (body.size() <= kMaxInlineBody) {
+            head.append(body);
+            return sendAll(fd, head);
+        }
+        return sendAll(fd, head) && sendAll(fd, body);
+    }
+    if (!sendAll(fd, head)) {
+        return false;
+    }
+    // Slices of about 10ms at the bandwidth limit.
+    size_t sliceSize = std::clamp<size_t>(config.bandwidth / 100, 1, kMaxInlineBody);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t sent = 0; sent < body.size();) {
+        size_t n = std::min(sliceSize, body.size() - sent);
+        if (!sendAll(fd, body.substr(sent, n))) {
+            return false;
+        }
+        sent += n;
+        auto elapsed = std::chrono::microseconds{static_cast<long>(sent * 1e6 / config.bandwidth)};
+        std::this_thread::sleep_until(start + elapsed);
+    }
+    return true;
+}
+
+bool S3TestServer::sendAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        numBytesSent += n;
+        data.remove_prefix(n);
+    }
+    return true;
+}
+
+std::shared_ptr<const std::string> S3TestServer::readFile(
+        const std::string &path,
+        long offset,
+        long size) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    auto data = std::make_shared<std::string>(size, '\0');
+    long done = 0;
+    while (done < size) {
+        ssize_t n = ::pread(fd, data->data() + done, size - done, offset + done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        done += n;
+    }
+    ::close(fd);
+    return done == size ? data : nullptr;
+}
+
+std::optional<S3TestServer::Object> S3TestServer::findObject(
+        const std::string &bucket,
+        const std::string &key) {
+    if (config.directory.empty()) {
+        std::lock_guard lock{mutex};
+        auto it = objects.find(bucket + "/" + key);
+        return it == objects.end() ? std::nullopt : std::optional<Object>{it->second};
+    }
+    Object object;
+    object.path = (std::filesystem::path{config.directory} / bucket / key).string();
+    struct stat st{};
+    if (::stat(object.path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return std::nullopt;
+    }
+    object.size = st.st_size;
+    object.lastModified = st.st_mtime;
+    object.etag = makeEtag(std::to_string(st.st_size) + "-" + std::to_string(st.st_mtime));
+    return object;
+}
+
+std::string S3TestServer::storeObject(
+        const std::string &bucket,
+        const std::string &key,
+        std::string data) {
+    if (config.directory.empty()) {
+        Object object;
+        object.size = static_cast<long>(data.size());
+        object.etag = makeEtag(data);
+        object.lastModified = std::time(nullptr);
+        object.data = std::make_shared<const std::string>(std::move(data));
+        std::lock_guard lock{mutex};
+        return (objects[bucket + "/" + key] = std::move(object)).etag;
+    }
+    // Written aside and renamed, so a concurrent GET sees the old or the new object. Bucket
+    // names can't start with a dot.
+    std::filesystem::path directory{config.directory};
+    std::filesystem::path path = directory / bucket / key;
+    std::filesystem::path temp = directory / ".incoming"
+            / std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    std::filesystem::create_directories(path.parent_path());
+    std::filesystem::create_directories(temp.parent_path());
+    {
+        std::ofstream file{temp, std::ios::binary | std::ios::trunc};
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+    std::filesystem::rename(temp, path);
+    return findObject(bucket, key)->etag;
+}
+
+bool S3TestServer::removeObject(const std::string &bucket, const std::string &key) {
+    if (config.directory.empty()) {
+        std::lock_guard lock{mutex};
+        return objects.erase(bucket + "/" + key) > 0;
+    }
+    std::error_code error;
+    return std::filesystem::remove(std::filesystem::path{config.directory} / bucket / key, error);
+}
+
+std::vector<std::pair<std::string, S3TestServer::Object>> S3TestServer::listObjects(
+        const std::string &bucket,
+        const std::string &prefix,
+        const std::string &startAfter) {
+    std::vector<std::pair<std::string, Object>> result;
+    if (config.directory.empty()) {
+        std::string bucketPrefix = bucket + "/";
+        std::lock_guard lock{mutex};
+        for (auto it = objects.lower_bound(bucketPrefix + std::max(prefix, startAfter));
+             it != objects.end() && it->first.starts_with(bucketPrefix + prefix);
+             ++it) {
+            std::string key = it->first.substr(bucketPrefix.size());
+            if (key > startAfter) {
+                result.emplace_back(std::move(key), it->second);
+            }
+        }
+        return result;
+    }
+    std::filesystem::path root = std::filesystem::path{config.directory} / bucket;
+    std::error_code error;
+    for (std::filesystem::recursive_directory_iterator it{root, error}, end; it != end;
+         it.increment(error)) {
+        if (!it->is_regular_file(error)) {
+            continue;
+        }
+        std::string key = it->path().lexically_relative(root).generic_string();
+        if (key.starts_with(prefix) && key > startAfter) {
+            if (auto object = findObject(bucket, key)) {
+                result.emplace_back(std::move(key), std::move(*object));
+            }
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const auto &a, const auto &b) {
+        return a.first < b.first;
+    });
+    return result;
+}
+
+S3TestFixture::S3TestFixture(const S3TestServerConfig &serverConfig, int maxAttempts) :
+    S3TestFixture{serverConfig, getRetryConfig(maxAttempts)} {}
+
+S3TestFixture::S3TestFixture(const S3TestServerConfig &serverConfig, S3ClientConfig clientConfig) :
+    server{serverConfig},
+    endpoint{server.getEndpoint()},
+    http{createHttpClientCurl(HttpClientConfig{})} {
+    clientConfig.endpoint = endpoint;
+    clientConfig.accessKey = "test";
+    clientConfig.secretKey = "test";
+    clientConfig.region = "us-east-1";
+    s3 = createS3Client(http.get(), clientConfig);
+}
+
+} // namespace molecula
@@ -0,0 +1,202 @@
+#pragma once
+
+#include "molecula/s3/S3Client.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace molecula {
+
+// Delay before each response, log-normal with the given median and 99th percentile like the
+// first byte latency of S3. Zero median for none.
+class S3TestLatency {
+public:
+    std::chrono::microseconds median{};
+    std::chrono::microseconds p99{};
+};
+
+class S3TestServerConfig {
+public:
+    // Objects are the files <directory>/<bucket>/<key>. Empty keeps objects in memory.
+    std::string directory;
+    S3TestLatency latency;
+    // Bytes per second sent on each connection, zero for no limit.
+    long bandwidth{};
+    // Fraction of requests failed with @errorStatus, and of requests answered by closing the
+    // connection.
+    double errorRate{};
+    int errorStatus{503};
+    double resetRate{};
+    // Seed of the latency and error draws.
+    uint64_t seed{1};
+};
+
+class S3TestServerStats {
+public:
+    long connections{};
+    long requests{};
+    long bytesReceived{};
+    long bytesSent{};
+    long errors{};
+    long resets{};
+};
+
+// S3 stand-in on a loopback port for tests and benchmarks without a network: GetObject with
+// ranges and conditions, HeadObject, PutObject, DeleteObject, DeleteObjects, ListObjectsV2 and
+// multipart uploads over path-style URLs. Signatures and part sizes are not checked, parts are
+// kept in memory.
+// Serves each connection on its own thread with HTTP/1.1 keep-alive.
+class S3TestServer {
+public:
+    // Listens on an ephemeral port of 127.0.0.1. Throws if the socket can't be opened.
+    explicit S3TestServer(const S3TestServerConfig &config);
+    ~S3TestServer();
+
+    S3TestServer(const S3TestServer &) = delete;
+    S3TestServer &operator=(const S3TestServer &) = delete;
+
+    // "http://127.0.0.1:<port>"
+    std::string getEndpoint() const;
+    int getPort() const {
+        return port;
+    }
+
+    void putObject(std::string_view bucket, std::string_view key, std::string data);
+    std::optional<std::string> getObject(std::string_view bucket, std::string_view key);
+    // Fails @count requests with @status after the next @skip, in addition to the error rate.
+    void failRequests(int count, int status, int skip = 0);
+    // DeleteObjects reports AccessDenied for keys starting with @prefix and keeps them.
+    void denyDeletes(std::string_view bucket, std::string_view prefix);
+
+    S3TestServerStats getStats() const;
+    // Multipart uploads neither completed nor aborted.
+    int getNumUploads();
+
+private:
+    struct Object {
+        // In memory, or the file of a directory object.
+        std::shared_ptr<const std::string> data;
+        std::string path;
+        long size{};
+        std::string etag;
+        std::time_t lastModified{};
+    };
+
+    struct Upload {
+        std::string bucket;
+        std::string key;
+        // ETag and data by part number
+        std::map<int, std::pair<std::string, std::string>> parts;
+    };
+
+    struct Request {
+        std::string method;
+        std::string bucket;
+        std::string key;
+        std::map<std::string, std::string> query;
+        std::map<std::string, std::string> headers;
+        std::string body;
+    };
+
+    struct Response {
+        int status{200};
+        std::vector<std::pair<std::string, std::string>> headers;
+        std::shared_ptr<const std::string> body;
+        // Part of @body sent
+        size_t offset{};
+        size_t size{};
+        // HEAD: Content-Length is sent without the body.
+        bool headersOnly{};
+    };
+
+    void acceptLoop();
+    void serve(int fd);
+    // Reads the next request, false when the connection is closed.
+    bool readRequest(int fd, std::string &buffer, Request &req);
+    bool receive(int fd, std::string &buffer);
+    Response handle(Request &req);
+    // GetObject and HeadObject
+    Response handleGet(const Request &req);
+    Response handleList(const Request &req);
+    Response handleDelete(const Request &req);
+    // CreateMultipartUpload, UploadPart, CompleteMultipartUpload and AbortMultipartUpload
+    Response handleMultipart(Request &req);
+    bool isDeleteDenied(const std::string &bucket, const std::string &key);
+    static Response makeError(int status);
+    static Response makeXml(int status, std::string xml);
+    // Error injected into the next request, zero for none, -1 to reset the connection.
+    int drawFault();
+    std::chrono::microseconds drawLatency();
+    bool send(int fd, const Response &response, bool close);
+    bool sendAll(int fd, std::string_view data);
+
+    // Empty if the file can't be read.
+    static std::shared_ptr<const std::string> readFile(
+            const std::string &path,
+            long offset,
+            long size);
+    std::optional<Object> findObject(const std::string &bucket, const std::string &key);
+    // Returns the ETag.
+    std::string storeObject(const std::string &bucket, const std::string &key, std::string data);
+    bool removeObject(const std::string &bucket, const std::string &key);
+    // Keys starting with @prefix after @startAfter, sorted.
+    std::vector<std::pair<std::string, Object>> listObjects(
+            const std::string &bucket,
+            const std::string &prefix,
+            const std::string &startAfter);
+
+    const S3TestServerConfig config;
+    int listenFd{-1};
+    int port{};
+    std::thread acceptThread;
+
+    std::mutex mutex;
+    bool stopping{};
+    std::unordered_set<int> connections;
+    std::vector<std::thread> connectionThreads;
+    // Keyed by "<bucket>/<key>", so a bucket listing is a range.
+    std::map<std::string, Object> objects;
+    std::map<std::string, Upload> uploads;
+    long lastUploadId{};
+    std::mt19937_64 random;
+    int failCount{};
+    int failStatus{};
+    int failSkip{};
+    // "<bucket>/<prefix>"
+    std::vector<std::string> deniedDeletes;
+
+    std::atomic<long> numConnections{};
+    std::atomic<long> numRequests{};
+    std::atomic<long> numBytesReceived{};
+    std::atomic<long> numBytesSent{};
+    std::atomic<long> numErrors{};
+    std::atomic<long> numResets{};
+};
+
+// Test server and an S3 client of it over its own HTTP client.
+class S3TestFixture {
+public:
+    // Retries wait 1ms.
+    explicit S3TestFixture(const S3TestServerConfig &serverConfig = {}, int maxAttempts = 1);
+    // Endpoint and credentials of @clientConfig are set to the server's.
+    S3TestFixture(const S3TestServerConfig &serverConfig, S3ClientConfig clientConfig);
+
+    S3TestServer server;
+    std::string endpoint;
+    std::unique_ptr<HttpClient> http;
+    std::unique_ptr<S3Client> s3;
+};
+
+} // namespace molecula
@@ -0,0 +1,632 @@
+#include "molecula/s3/S3TestServer.hpp"
+
+#include "folly/coro/BlockingWait.h"
+#include "molecula/s3/FakeS3Client.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace molecula {
+
+namespace {
+double getSeconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+} // namespace
+
+GTEST_TEST(S3TestServer, PutGet) {
+    S3TestFixture test;
+    std::string data = makeData(100'000);
+    S3PutObjectRequest put{"bucket", "dir/key"};
+    put.body = data;
+    S3PutObject putResult = test.s3->putObject(put).get();
+    EXPECT_EQ(putResult.status, 200);
+    EXPECT_FALSE(putResult.etag.empty());
+    EXPECT_EQ(test.server.getObject("bucket", "dir/key"), data);
+
+    S3GetObject get = test.s3->getObject(S3GetObjectRequest{"bucket", "dir/key"}).get();
+    EXPECT_EQ(get.status, 200);
+    EXPECT_EQ(get.data.view(), data);
+
+    S3GetObjectRequest rangeReq{"bucket", "dir/key"};
+    rangeReq.setRange(1'000, 1'999);
+    S3GetObject range = test.s3->getObject(rangeReq).get();
+    EXPECT_EQ(range.status, 206);
+    EXPECT_EQ(range.data.view(), data.substr(1'000, 1'000));
+    EXPECT_EQ(range.objectSize, 100'000);
+
+    rangeReq.setRange(200'000, 200'999);
+    EXPECT_EQ(test.s3->getObject(rangeReq).get().status, 416);
+}
+
+GTEST_TEST(S3TestServer, GetObjectInfo) {
+    S3TestFixture test;
+    test.server.putObject("bucket", "key", makeData(1'234));
+    S3GetObjectInfo info = test.s3->getObjectInfo(S3GetObjectInfoRequest{"bucket", "key"}).get();
+    EXPECT_EQ(info.status, 200);
+    EXPECT_EQ(info.size, 1'234);
+    EXPECT_FALSE(info.etag.empty());
+    EXPECT_GT(info.lastModified, 0);
+
+    auto missing = test.s3->getObjectInfo(S3GetObjectInfoRequest{"bucket", "missing"}).get();
+    EXPECT_EQ(missing.status, 404);
+}
+
+GTEST_TEST(S3TestServer, GetRanges) {
+    S3TestFixture test;
+    std::string data = makeData(1'000);
+    test.server.putObject("bucket", "key", data);
+    S3GetRangesRequest req{"bucket", "key"};
+    // Single bytes, the first one at offset zero, with a GET each.
+    req.ranges = {{0, 1}, {500, 1}};
+    req.maxGap = 0;
+    S3GetRanges get = test.s3->getRanges(req).get();
+    EXPECT_EQ(get.status, 200);
+    ASSERT_EQ(get.ranges.size(), 2);
+    EXPECT_EQ(get.ranges[0], data.substr(0, 1));
+    EXPECT_EQ(get.ranges[1], data.substr(500, 1));
+    EXPECT_EQ(test.s3->getStats().rangesRequested, 2);
+    EXPECT_LT(test.server.getStats().bytesSent, 1'000);
+}
+
+GTEST_TEST(S3TestServer, GetObjectParallel) {
+    S3TestFixture test;
+    std::string data = makeData(10'500);
+    test.server.putObject("bucket", "key", data);
+    S3GetObjectParallelRequest req{"bucket", "key"};
+    req.partSize = 1'000;
+    S3GetObject get = test.s3->getObjectParallel(req).get();
+    EXPECT_EQ(get.status, 200);
+    EXPECT_EQ(get.data.view(), data);
+    // HEAD for the size, then 11 parts, the last one shorter.
+    EXPECT_EQ(test.server.getStats().requests, 12);
+
+    // Known size: no HEAD.
+    req.size = data.size();
+    req.partSize = 2'100;
+    get = test.s3->getObjectParallel(req).get();
+    EXPECT_EQ(get.status, 200);
+    EXPECT_EQ(get.data.view(), data);
+    EXPECT_EQ(test.server.getStats().requests, 17);
+}
+
+GTEST_TEST(S3TestServer, GetObjectParallelSmall) {
+    S3TestFixture test;
+    std::string data = makeData(500);
+    test.server.putObject("bucket", "key", data);
+    S3GetObjectParallelRequest req{"bucket", "key"};
+    req.size = data.size();
+    req.partSize = 1'000;
+    S3GetObject get = test.s3->getObjectParallel(req).get();
+    EXPECT_EQ(get.status, 200);
+    EXPECT_EQ(get.data.view(), data);
+    EXPECT_EQ(test.server.getStats().requests, 1);
+
+    // One part of exactly the part size.
+    req.partSize = 500;
+    get = test.s3->getObjectParallel(req).get();
+    EXPECT_EQ(get.data.view(), data);
+    EXPECT_EQ(test.server.getStats().requests, 2);
+}
+
+GTEST_TEST(S3TestServer, GetObjectParallelErrors) {
+    S3TestFixture test;
+    std::string data = makeData(4'000);
+    test.server.putObject("bucket", "key", data);
+    S3GetObjectParallelRequest req{"bucket", "key"};
+    req.size = data.size();
+    req.partSize = 1'000;
+    // The first part fails, without retries: the others aren't started without its ETag.
+    test.server.failRequests(1, 503);
+    S3GetObject get = test.s3->getObjectParallel(req).get();
+    EXPECT_EQ(get.status, 503);
+    EXPECT_TRUE(get.data.view().empty());
+    EXPECT_EQ(test.server.getStats().requests, 1);
+
+    // Object shorter than the given size: the last part is out of range.
+    req.size = 4'500;
+    EXPECT_EQ(test.s3->getObjectParallel(req).get().status, 416);
+
+    S3GetObjectParallelRequest missing{"bucket", "none"};
+    EXPECT_EQ(test.s3->getObjectParallel(missing).get().status, 404);
+}
+
+GTEST_TEST(S3TestServer, GetObjectParallelOverwrite) {
+    S3TestFixture test;
+    test.server.putObject("bucket", "key", makeData(4'000));
+    S3GetObjectInfo info = test.s3->getObjectInfo(S3GetObjectInfoRequest{"bucket", "key"}).get();
+    // Same size, other data
+    std::string data(4'000, 'x');
+    test.server.putObject("bucket", "key", data);
+
+    S3GetObjectParallelRequest req{"bucket", "key"};
+    req.size = 4'000;
+    req.etag = info.etag;
+    req.partSize = 1'000;
+    EXPECT_EQ(test.s3->getObjectParallel(req).get().status, 412);
+
+    // Part 0 tells the ETag of the others.
+    req.etag = {};
+    S3GetObject get = test.s3->getObjectParallel(req).get();
+    EXPECT_EQ(get.status, 200);
+    EXPECT_EQ(get.data.view(), data);
+    EXPECT_NE(get.etag, info.etag);
+    EXPECT_FALSE(get.etag.empty());
+}
+
+GTEST_TEST(S3TestServer, GetObjectParallelCancel) {
+    // Parts take 0.5s each.
+    S3TestServerConfig config;
+    config.bandwidth = 500'000;
+    S3TestFixture test{config};
+    test.server.putObject("bucket", "key", makeData(1'000'000));
+    S3GetObjectParallelRequest req{"bucket", "key"};
+    req.partSize = 250'000;
+    // Skips the HEAD, fails one of the four parts.
+    test.server.failRequests(1, 500, 1);
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(test.s3->getObjectParallel(req).get().status, 500);
+    EXPECT_LT(getSeconds(start), 0.3);
+    EXPECT_LT(test.server.getStats().bytesSent, 500'000);
+}
+
+GTEST_TEST(S3TestServer, ConditionalGet) {
+    S3TestFixture test;
+    test.server.putObject("bucket", "key", "v1");
+    S3GetObject first = test.s3->getObject(S3GetObjectRequest{"bucket", "key"}).get();
+    ASSERT_EQ(first.status, 200);
+
+    S3GetObjectRequest req{"bucket", "key"};
+    req.ifNoneMatch = first.etag;
+    S3GetObject notModified = test.s3->getObject(req).get();
+    EXPECT_EQ(notModified.status, 304);
+    EXPECT_EQ(notModified.data.size(), 0);
+
+    S3GetObjectRequest ifMatch{"bucket", "key"};
+    ifMatch.ifMatch = first.etag;
+    EXPECT_EQ(test.s3->getObject(ifMatch).get().status, 200);
+    ifMatch.ifMatch = "\"other\"";
+    EXPECT_EQ(test.s3->getObject(ifMatch).get().status, 412);
+
+    S3GetObjectRequest byTime{"bucket", "key"};
+    byTime.ifModifiedSince = first.lastModified;
+    EXPECT_EQ(test.s3->getObject(byTime).get().status, 304);
+
+    test.server.putObject("bucket", "key", "v2");
+    S3GetObject changed = test.s3->getObject(req).get();
+    EXPECT_EQ(changed.status, 200);
+    EXPECT_EQ(changed.data.view(), "v2");
+    EXPECT_NE(changed.etag, first.etag);
+}
+
+GTEST_TEST(S3TestServer, Coroutines) {
+    S3TestFixture test;
+    test.server.putObject("bucket", "key", "data");
+    auto read = [&]() -> folly::coro::Task<std::string> {
+        S3GetObjectInfo info = co_await test.s3->co_getObjectInfo({"bucket", "key"});
+        EXPECT_EQ(info.size, 4);
+        S3GetObject get = co_await test.s3->co_getObject({"bucket", "key"});
+        co_return std::string{get.data.view()};
+    };
+    EXPECT_EQ(folly::coro::blockingWait(read()), "data");
+
+    HttpRequest request;
+    request.url = test.endpoint + "/bucket/missing";
+    EXPECT_EQ(folly::coro::blockingWait(test.http->co_makeRequest(std::move(request))).status, 404);
+}
+
+GTEST_TEST(S3TestServer, ListObjects) {
+    S3TestFixture test;
+    for (int i = 0; i < 25; i++) {
+        test.server.putObject("bucket", "data/" + std::to_string(100 + i), "x");
+    }
+    test.server.putObject("bucket", "meta/a/1", "x");
+    test.server.putObject("bucket", "meta/b/1", "x");
+    test.server.putObject("bucket", "meta/c", "x");
+
+    S3ListObjectsRequest req{"bucket", "data/"};
+    req.maxKeys = 10;
+    long numObjects = 0;
+    auto result = test.s3->listObjects(req, [&](S3ListObjects &page) {
+                             numObjects += static_cast<long>(page.objects.size());
+                         }).get();
+    EXPECT_EQ(result.status, 200);
+    EXPECT_EQ(result.numPages, 3);
+    EXPECT_EQ(numObjects, 25);
+
+    S3ListObjectsRequest delimited{"bucket", "meta/"};
+    delimited.delimiter = "/";
+    S3ListObjects page = test.s3->listObjectsPage(delimited).get();
+    EXPECT_EQ(page.status, 200);
+    ASSERT_EQ(page.objects.size(), 1);
+    EXPECT_EQ(page.objects[0].key, "meta/c");
+    EXPECT_EQ(page.commonPrefixes, (std::vector<std::string>{"meta/a/", "meta/b/"}));
+}
+
+// Sorted keys delivered by listObjectsParallel.
+std::vector<std::string> listParallel(
+        S3Client &s3,
+        const S3ListObjectsRequest &req,
+        S3ListObjectsResult &result) {
+    std::mutex mutex;
+    std::vector<std::string> keys;
+    result = s3.listObjectsParallel(req, [&](S3ListObjects &page) {
+                   EXPECT_TRUE(page.commonPrefixes.empty());
+                   std::lock_guard lock{mutex};
+                   for (const S3Object &object : page.objects) {
+                       keys.push_back(object.key);
+                   }
+               }).get();
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+GTEST_TEST(S3TestServer, ListObjectsParallel) {
+    S3TestFixture test;
+    std::vector<std::string> keys{"t/a/x/1", "t/a/x/2", "t/a/y/1", "t/b/2", "t/b/x/1", "t/c"};
+    for (const std::string &key : keys) {
+        test.server.putObject("bucket", key, "x");
+    }
+    test.server.putObject("bucket", "u/1", "x");
+
+    // Requests: "t/", then "t/a/" and "t/b/" delimited, then "t/a/x/", "t/a/y/" and "t/b/x/".
+    std::vector<long> expectedRequests{1, 3, 6, 6};
+    long numRequests = 0;
+    for (int depth = 0; depth <= 3; depth++) {
+        S3ListObjectsRequest req{"bucket", "t/"};
+        req.fanOutDepth = depth;
+        S3ListObjectsResult result;
+        EXPECT_EQ(listParallel(*test.s3, req, result), keys) << depth;
+        EXPECT_EQ(result.status, 200);
+        EXPECT_EQ(result.numObjects, 6);
+        long requests = test.server.getStats().requests;
+        EXPECT_EQ(requests - numRequests, expectedRequests[depth]) << depth;
+        EXPECT_EQ(result.numPages, requests - numRequests) << depth;
+        numRequests = requests;
+    }
+}
+
+GTEST_TEST(S3TestServer, ListObjectsParallelConcurrency) {
+    S3TestServerConfig config;
+    config.latency.median = std::chrono::milliseconds{20};
+    config.latency.p99 = std::chrono::milliseconds{20};
+    S3TestFixture test{config};
+    for (int i = 0; i < 12; i++) {
+        test.server.putObject("bucket", "t/" + std::to_string(10 + i) + "/1", "x");
+    }
+    S3ListObjectsRequest req{"bucket", "t/"};
+    req.maxConcurrency = 3;
+    auto start = std::chrono::steady_clock::now();
+    S3ListObjectsResult result;
+    EXPECT_EQ(listParallel(*test.s3, req, result).size(), 12);
+    EXPECT_EQ(result.status, 200);
+    EXPECT_EQ(test.server.getStats().requests, 13);
+    // At most 3 listings in flight: one connection each, and 12 prefixes take 4 rounds after
+    // the first listing.
+    EXPECT_LE(test.server.getStats().connections, 3);
+    EXPECT_GE(getSeconds(start), 0.1);
+}
+
+GTEST_TEST(S3TestServer, ListObjectsParallelError) {
+    S3TestFixture test;
+    for (int i = 0; i < 10; i++) {
+        test.server.putObject("bucket", "t/" + std::to_string(10 + i) + "/1", "x");
+    }
+    S3ListObjectsRequest req{"bucket", "t/"};
+    req.maxConcurrency = 1;
+    // "t/" and "t/10/" succeed, "t/11/" fails: the 8 prefixes left are not listed.
+    test.server.failRequests(1, 503, 2);
+    S3ListObjectsResult result;
+    EXPECT_EQ(listParallel(*test.s3, req, result).size(), 1);
+    EXPECT_EQ(result.status, 503);
+    EXPECT_EQ(test.server.getStats().requests, 3);
+}
+
+std::vector<std::string> putKeys(S3TestServer &server, int count) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < count; i++) {
+        keys.push_back("dir/key" + std::to_string(i));
+        server.putObject("bucket", keys.back(), "x");
+    }
+    return keys;
+}
+
+GTEST_TEST(S3TestServer, DeleteObjects) {
+    S3TestFixture test;
+    std::vector<std::string> keys = putKeys(test.server, 10);
+    test.server.putObject("bucket", "other", "x");
+    S3DeleteObjectsRequest req{"bucket", keys};
+    req.batchSize = 3;
+    req.maxConcurrentBatches = 2;
+    S3DeleteObjects result = test.s3->deleteObjects(req).get();
+    EXPECT_EQ(result.status, 200);
+    EXPECT_EQ(result.numDeleted, 10);
+    EXPECT_EQ(result.numBatches, 4);
+    EXPECT_TRUE(result.errors.empty());
+    for (const std::string &key : keys) {
+        EXPECT_FALSE(test.server.getObject("bucket", key)) << key;
+    }
+    EXPECT_TRUE(test.server.getObject("bucket", "other"));
+}
+
+GTEST_TEST(S3TestServer, DeleteObjectsKeyErrors) {
+    S3TestFixture test;
+    std::vector<std::string> keys = putKeys(test.server, 4);
+    keys.push_back("keep/a&b");
+    test.server.putObject("bucket", keys.back(), "x");
+    test.server.denyDeletes("bucket", "keep/");
+    S3DeleteObjects result = test.s3->deleteObjects(S3DeleteObjectsRequest{"bucket", keys}).get();
+    // Per-key errors don't fail the request.
+    EXPECT_EQ(result.status, 200);
+    EXPECT_EQ(result.numDeleted, 4);
+    ASSERT_EQ(result.errors.size(), 1);
+    EXPECT_EQ(result.errors[0].key, "keep/a&b");
+    EXPECT_EQ(result.errors[0].code, "AccessDenied");
+    EXPECT_TRUE(test.server.getObject("bucket", "keep/a&b"));
+    EXPECT_FALSE(test.server.getObject("bucket", "dir/key0"));
+}
+
+GTEST_TEST(S3TestServer, DeleteObjectsRetry) {
+    S3TestFixture test{S3TestServerConfig{}, 2};
+    std::vector<std::string> keys = putKeys(test.server, 4);
+    test.server.failRequests(1, 503);
+    S3DeleteObjects result = test.s3->deleteObjects(S3DeleteObjectsRequest{"bucket", keys}).get();
+    EXPECT_EQ(result.status, 200);
+    EXPECT_EQ(result.numDeleted, 4);
+    EXPECT_TRUE(result.errors.empty());
+    EXPECT_EQ(test.s3->getStats().retries, 1);
+    EXPECT_FALSE(test.server.getObject("bucket", "dir/key3"));
+}
+
+GTEST_TEST(S3TestServer, DeleteObjectsFailedBatch) {
+    S3TestFixture test;
+    std::vector<std::string> keys = putKeys(test.server, 6);
+    test.server.failRequests(1, 503);
+    S3DeleteObjectsRequest req{"bucket", keys};
+    req.batchSize = 2;
+    req.maxConcurrentBatches = 1;
+    S3DeleteObjects result = test.s3->deleteObjects(req).get();
+    // Only the keys of the first batch fail.
+    EXPECT_EQ(result.status, 503);
+    EXPECT_EQ(result.numDeleted, 4);
+    EXPECT_EQ(result.numBatches, 3);
+    ASSERT_EQ(result.errors.size(), 2);
+    EXPECT_EQ(result.errors[0].key, "dir/key0");
+    EXPECT_EQ(result.errors[1].key, "dir/key1");
+    EXPECT_EQ(result.errors[0].code, "SlowDown");
+    EXPECT_TRUE(test.server.getObject("bucket", "dir/key0"));
+    EXPECT_FALSE(test.server.getObject("bucket", "dir/key2"));
+}
+
+GTEST_TEST(S3TestServer, UploadObject) {
+    S3TestFixture test;
+    std::string data = makeData(10'500);
+    S3UploadObjectRequest req{"bucket", "key"};
+    req.body = data;
+    req.partSize = 1'000;
+    req.maxConcurrentParts = 4;
+    S3PutObject put = test.s3->uploadObject(req).get();
+    EXPECT_EQ(put.status, 200);
+    EXPECT_FALSE(put.etag.empty());
+    EXPECT_EQ(test.server.getObject("bucket", "key"), data);
+    EXPECT_EQ(test.server.getNumUploads(), 0);
+    // Create, 11 parts and complete.
+    EXPECT_EQ(test.server.getStats().requests, 13);
+}
+
+GTEST_TEST(S3TestServer, CompleteMultipartUpload) {
+    S3TestFixture test;
+    S3CreateMultipartUpload created =
+            test.s3->createMultipartUpload(S3PutObjectRequest{"bucket", "key"}).get();
+    ASSERT_EQ(created.status, 200);
+    EXPECT_FALSE(created.uploadId.empty());
+
+    std::string data = makeData(3'000);
+    std::vector<S3CompletedPart> parts(3);
+    // Parts may be uploaded in any order.
+    for (int i = 2; i >= 0; i--) {
+        S3UploadPartRequest part;
+        part.bucket = "bucket";
+        part.key = "key";
+        part.uploadId = created.uploadId;
+        part.partNumber = i + 1;
+        part.body = std::string_view{data}.substr(i * 1'000, 1'000);
+        S3PutObject uploaded = test.s3->uploadPart(part).get();
+        ASSERT_EQ(uploaded.status, 200);
+        parts[i] = S3CompletedPart{i + 1, uploaded.etag};
+    }
+    EXPECT_FALSE(test.server.getObject("bucket", "key"));
+
+    S3CompleteMultipartUploadRequest complete;
+    complete.bucket = "bucket";
+    complete.key = "key";
+    complete.uploadId = created.uploadId;
+    complete.parts = {parts[0], S3CompletedPart{2, "\"stale\""}, parts[2]};
+    EXPECT_EQ(test.s3->completeMultipartUpload(complete).get().status, 400);
+    complete.parts = parts;
+    S3PutObject put = test.s3->completeMultipartUpload(complete).get();
+    EXPECT_EQ(put.status, 200);
+    EXPECT_FALSE(put.etag.empty());
+    EXPECT_EQ(test.server.getObject("bucket", "key"), data);
+    EXPECT_EQ(test.server.getNumUploads(), 0);
+    // Completed uploads are gone.
+    EXPECT_EQ(test.s3->completeMultipartUpload(complete).get().status, 404);
+}
+
+GTEST_TEST(S3TestServer, UploadObjectAbort) {
+    S3TestFixture test;
+    std::string data = makeData(4'000);
+    S3UploadObjectRequest req{"bucket", "key"};
+    req.body = data;
+    req.partSize = 1'000;
+    req.maxConcurrentParts = 1;
+    // Second part fails without retries: the remaining parts are skipped, the upload aborted.
+    test.server.failRequests(1, 503, 2);
+    EXPECT_EQ(test.s3->uploadObject(req).get().status, 503);
+    EXPECT_FALSE(test.server.getObject("bucket", "key"));
+    EXPECT_EQ(test.server.getNumUploads(), 0);
+    // Create, two parts and abort.
+    EXPECT_EQ(test.server.getStats().requests, 4);
+
+    // Failed create: nothing to abort.
+    test.server.failRequests(1, 500);
+    EXPECT_EQ(test.s3->uploadObject(req).get().status, 500);
+    EXPECT_EQ(test.server.getNumUploads(), 0);
+}
+
+GTEST_TEST(S3TestServer, Directory) {
+    auto directory = std::filesystem::temp_directory_path() / "S3TestServer_Test";
+    std::filesystem::remove_all(directory);
+    S3TestServerConfig config;
+    config.directory = directory.string();
+    S3TestFixture test{config};
+
+    std::string data = makeData(10'000);
+    S3PutObjectRequest put{"bucket", "a/b"};
+    put.body = data;
+    EXPECT_EQ(test.s3->putObject(put).get().status, 200);
+    std::ifstream file{directory / "bucket" / "a" / "b", std::ios::binary};
+    std::stringstream content;
+    content << file.rdbuf();
+    EXPECT_EQ(content.str(), data);
+
+    S3GetObjectRequest get{"bucket", "a/b"};
+    get.setRange(9'000, 9'999);
+    EXPECT_EQ(test.s3->getObject(get).get().data.view(), data.substr(9'000));
+
+    S3ListObjects page = test.s3->listObjectsPage(S3ListObjectsRequest{"bucket", ""}).get();
+    ASSERT_EQ(page.objects.size(), 1);
+    EXPECT_EQ(page.objects[0].key, "a/b");
+    EXPECT_EQ(page.objects[0].size, 10'000);
+    std::filesystem::remove_all(directory);
+}
+
+GTEST_TEST(S3TestServer, InjectedErrorsAreRetried) {
+    S3TestFixture test{S3TestServerConfig{}, 4};
+    test.server.putObject("bucket", "key", "data");
+    test.server.failRequests(2, 503);
+    S3GetObject get = test.s3->getObject(S3GetObjectRequest{"bucket", "key"}).get();
+    EXPECT_EQ(get.status, 200);
+    EXPECT_EQ(test.s3->getStats().retries, 2);
+    EXPECT_EQ(test.server.getStats().errors, 2);
+}
+
+GTEST_TEST(S3TestServer, Reset) {
+    S3TestServerConfig config;
+    config.resetRate = 1.0;
+    S3TestFixture test{config};
+    test.server.putObject("bucket", "key", "data");
+    S3GetObject get = test.s3->getObject(S3GetObjectRequest{"bucket", "key"}).get();
+    EXPECT_FALSE(is2xx(get.status));
+    EXPECT_GE(test.server.getStats().resets, 1);
+}
+
+GTEST_TEST(S3TestServer, Latency) {
+    S3TestServerConfig config;
+    config.latency.median = std::chrono::milliseconds{50};
+    config.latency.p99 = std::chrono::milliseconds{50};
+    S3TestFixture test{config};
+    test.server.putObject("bucket", "key", "data");
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(test.s3->getObject(S3GetObjectRequest{"bucket", "key"}).get().status, 200);
+    EXPECT_GE(getSeconds(start), 0.05);
+}
+
+GTEST_TEST(S3TestServer, Bandwidth) {
+    S3TestServerConfig config;
+    config.bandwidth = 1'000'000;
+    S3TestFixture test{config};
+    test.server.putObject("bucket", "key", makeData(200'000));
+    auto start = std::chrono::steady_clock::now();
+    S3GetObject get = test.s3->getObject(S3GetObjectRequest{"bucket", "key"}).get();
+    EXPECT_EQ(get.size, 200'000);
+    EXPECT_GE(getSeconds(start), 0.19);
+}
+
+GTEST_TEST(S3TestServer, RequestTimeout) {
+    S3TestServerConfig config;
+    config.bandwidth = 100'000;
+    S3ClientConfig clientConfig;
+    clientConfig.requestTimeout = std::chrono::milliseconds{200};
+    clientConfig.retry.maxAttempts = 1;
+    S3TestFixture test{config, clientConfig};
+    test.server.putObject("bucket", "key", makeData(100'000));
+
+    // Headers arrive in time, the body doesn't.
+    auto start = std::chrono::steady_clock::now();
+    S3GetObject get = test.s3->getObject(S3GetObjectRequest{"bucket", "key"}).get();
+    EXPECT_EQ(get.status, 0);
+    EXPECT_LT(getSeconds(start), 0.9);
+
+    std::string buffer(100'000, '\0');
+    S3GetObjectRequest req{"bucket", "key"};
+    req.output = buffer;
+    EXPECT_EQ(test.s3->getObject(req).get().status, 0);
+}
+
+GTEST_TEST(S3TestServer, RequestTimeoutRetried) {
+    S3TestServerConfig config;
+    config.bandwidth = 100'000;
+    S3ClientConfig clientConfig;
+    clientConfig.requestTimeout = std::chrono::milliseconds{100};
+    clientConfig.retry.maxAttempts = 2;
+    clientConfig.retry.baseDelay = std::chrono::milliseconds{1};
+    S3TestFixture test{config, clientConfig};
+    test.server.putObject("bucket", "key", makeData(100'000));
+
+    S3GetObject get = test.s3->getObject(S3GetObjectRequest{"bucket", "key"}).get();
+    EXPECT_EQ(get.status, 0);
+    EXPECT_EQ(test.s3->getStats().retries, 1);
+    EXPECT_EQ(test.server.getStats().requests, 2);
+}
+
+GTEST_TEST(S3TestServer, Cancel) {
+    S3TestServerConfig config;
+    config.latency.median = std::chrono::milliseconds{500};
+    config.latency.p99 = std::chrono::milliseconds{500};
+    S3TestFixture test{config};
+    test.server.putObject("bucket", "key", "data");
+
+    auto start = std::chrono::steady_clock::now();
+    auto future = test.s3->getObject(S3GetObjectRequest{"bucket", "key"});
+    std::this_thread::sleep_for(std::chrono::milliseconds{50});
+    future.cancel();
+    EXPECT_THROW(std::move(future).get(), folly::FutureCancellation);
+    EXPECT_LT(getSeconds(start), 0.4);
+}
+
+GTEST_TEST(S3TestServer, Hedging) {
+    // About one GET in six is slower than 20ms.
+    S3TestServerConfig config;
+    config.latency.median = std::chrono::milliseconds{1};
+    config.latency.p99 = std::chrono::milliseconds{1'000};
+    S3ClientConfig clientConfig;
+    clientConfig.hedging.enabled = true;
+    clientConfig.hedging.percentile = 0.5;
+    clientConfig.hedging.minDelay = std::chrono::milliseconds{20};
+    clientConfig.hedging.minSamples = 1;
+    S3TestFixture test{config, clientConfig};
+    std::string data = makeData(1'000);
+    test.server.putObject("bucket", "key", data);
+
+    for (int i = 0; i < 50; i++) {
+        S3GetObject get = test.s3->getObject(S3GetObjectRequest{"bucket", "key"}).get();
+        ASSERT_EQ(get.status, 200);
+        EXPECT_EQ(get.data.view(), data);
+    }
+    S3ClientStats stats = test.s3->getStats();
+    EXPECT_GT(stats.hedgedRequests, 0);
+    EXPECT_GT(stats.hedgeWins, 0);
+    EXPECT_LE(test.server.getStats().requests, 50 + stats.hedgedRequests);
+}
+
+} // namespace molecula
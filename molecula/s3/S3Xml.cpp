@@ -0,0 +1,144 @@
+#include "molecula/s3/S3Xml.hpp"
+
+#include <charconv>
+#include <cstdint>
+
+namespace molecula {
+
+std::optional<std::string_view> S3XmlScanner::next(std::string_view name) {
+    while (pos < xml.size()) {
+        size_t open = xml.find('<', pos);
+        if (open == std::string_view::npos) {
+            break;
+        }
+        pos = open + 1;
+        std::string_view rest = xml.substr(pos);
+        if (!rest.starts_with(name) || rest.size() == name.size()) {
+            continue;
+        }
+        char after = rest[name.size()];
+        if (after == '/' && rest.substr(name.size()).starts_with("/>")) {
+            // Empty element
+            pos += name.size() + 2;
+            return std::string_view{};
+        }
+        if (after != '>' && after != ' ') {
+            // Longer name with the same prefix
+            continue;
+        }
+        size_t contentBegin = xml.find('>', pos);
+        if (contentBegin == std::string_view::npos) {
+            break;
+        }
+        contentBegin++;
+        std::string closeTag{"</"};
+        closeTag.append(name).append(">");
+        size_t contentEnd = xml.find(closeTag, contentBegin);
+        if (contentEnd == std::string_view::npos) {
+            break;
+        }
+        pos = contentEnd + closeTag.size();
+        return xml.substr(contentBegin, contentEnd - contentBegin);
+    }
+    pos = xml.size();
+    return std::nullopt;
+}
+
+std::string_view getXmlElement(std::string_view xml, std::string_view name) {
+    return S3XmlScanner{xml}.next(name).value_or(std::string_view{});
+}
+
+static void appendUtf8(std::string &output, uint32_t code) {
+    if (code < 0x80) {
+        output.push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+        output.push_back(static_cast<char>(0xc0 | (code >> 6)));
+        output.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    } else if (code < 0x10000) {
+        output.push_back(static_cast<char>(0xe0 | (code >> 12)));
+        output.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+        output.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    } else {
+        output.push_back(static_cast<char>(0xf0 | (code >> 18)));
+        output.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3f)));
+        output.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+        output.push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    }
+}
+
+std::string unescapeXml(std::string_view text) {
+    std::string output;
+    output.reserve(text.size());
+    size_t i = 0;
+    while (i < text.size()) {
+        size_t amp = text.find('&', i);
+        if (amp == std::string_view::npos) {
+            output.append(text.substr(i));
+            break;
+        }
+        output.append(text.substr(i, amp - i));
+        size_t semicolon = text.find(';', amp);
+        if (semicolon == std::string_view::npos) {
+            output.append(text.substr(amp));
+            break;
+        }
+        std::string_view entity = text.substr(amp + 1, semicolon - amp - 1);
+        if (entity == "amp") {
+            output.push_back('&');
+        } else if (entity == "lt") {
+            output.push_back('<');
+        } else if (entity == "gt") {
+            output.push_back('>');
+        } else if (entity == "quot") {
+            output.push_back('"');
+        } else if (entity == "apos") {
+            output.push_back('\'');
+        } else if (entity.starts_with("#")) {
+            int base = 10;
+            std::string_view digits = entity.substr(1);
+            if (digits.starts_with("x")) {
+                base = 16;
+                digits.remove_prefix(1);
+            }
+            uint32_t code = 0;
+            auto [ptr, ec] =
+                    std::from_chars(digits.data(), digits.data() + digits.size(), code, base);
+            if (ec != std::errc{} || ptr != digits.data() + digits.size()) {
+                output.append(text.substr(amp, semicolon - amp + 1));
+            } else {
+                appendUtf8(output, code);
+            }
+        } else {
+            // Unknown entity, keep as is.
+            output.append(text.substr(amp, semicolon - amp + 1));
+        }
+        i = semicolon + 1;
+    }
+    return output;
+}
+
+void appendXmlEscaped(std::string &output, std::string_view text) {
+    for (char c : text) {
+        switch (c) {
+        case '&':
+            output.append("&amp;");
+            break;
+        case '<':
+            output.append("&lt;");
+            break;
+        case '>':
+            output.append("&gt;");
+            break;
+        case '"':
+            output.append("&quot;");
+            break;
+        case '\'':
+            output.append("&apos;");
+            break;
+        default:
+            output.push_back(c);
+        }
+    }
+}
+
+} // namespace molecula
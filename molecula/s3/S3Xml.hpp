@@ -0,0 +1,31 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace molecula {
+
+// Forward-only scanner over an S3 XML response, without building a tree. Elements are found by
+// name, so a list is read by calling @next in a loop and looking into each element.
+class S3XmlScanner {
+public:
+    explicit S3XmlScanner(std::string_view xml) : xml{xml} {}
+
+    // Moves past the next element named @name and returns its content (raw, not unescaped),
+    // or nothing at the end. Doesn't support nested elements of the same name.
+    std::optional<std::string_view> next(std::string_view name);
+
+private:
+    std::string_view xml;
+    size_t pos{};
+};
+
+// Returns content of the first element named @name in @xml, empty if none.
+std::string_view getXmlElement(std::string_view xml, std::string_view name);
+
+// Replaces the five predefined entities and numeric character references.
+std::string unescapeXml(std::string_view text);
+void appendXmlEscaped(std::string &output, std::string_view text);
+
+} // namespace molecula
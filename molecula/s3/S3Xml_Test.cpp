@@ -0,0 +1,49 @@
+#include "molecula/s3/S3Xml.hpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace molecula {
+
+GTEST_TEST(S3Xml, getXmlElement) {
+    std::string_view xml{
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            "<InitiateMultipartUploadResult xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">"
+            "<Bucket>bucket</Bucket><Key>a/b.parquet</Key><UploadId>VXBsb2FkIElE</UploadId>"
+            "</InitiateMultipartUploadResult>"};
+    EXPECT_EQ(getXmlElement(xml, "UploadId"), "VXBsb2FkIElE");
+    EXPECT_EQ(getXmlElement(xml, "Key"), "a/b.parquet");
+    EXPECT_EQ(getXmlElement(xml, "Upload"), "");
+    EXPECT_EQ(getXmlElement(xml, "Missing"), "");
+}
+
+GTEST_TEST(S3Xml, S3XmlScanner) {
+    std::string_view xml{
+            "<ListBucketResult><Name>b</Name>"
+            "<Contents><Key>k1</Key><Size>10</Size></Contents>"
+            "<Contents><Key>k2</Key><Size>20</Size></Contents>"
+            "<ContentsX>no</ContentsX>"
+            "<Contents/>"
+            "<IsTruncated>false</IsTruncated></ListBucketResult>"};
+    S3XmlScanner scanner{xml};
+    std::vector<std::string_view> keys;
+    while (auto contents = scanner.next("Contents")) {
+        keys.push_back(getXmlElement(*contents, "Key"));
+    }
+    EXPECT_EQ(keys, (std::vector<std::string_view>{"k1", "k2", ""}));
+    EXPECT_FALSE(scanner.next("Contents"));
+}
+
+GTEST_TEST(S3Xml, Escaping) {
+    EXPECT_EQ(unescapeXml("a&amp;b&lt;c&gt;&quot;&apos;"), "a&b<c>\"'");
+    EXPECT_EQ(unescapeXml("&#65;&#x42;&#xe9;"), "AB\xc3\xa9");
+    EXPECT_EQ(unescapeXml("&unknown; &"), "&unknown; &");
+
+    std::string output;
+    appendXmlEscaped(output, "\"etag\"&<>");
+    EXPECT_EQ(output, "&quot;etag&quot;&amp;&lt;&gt;");
+    EXPECT_EQ(unescapeXml(output), "\"etag\"&<>");
+}
+
+} // namespace molecula
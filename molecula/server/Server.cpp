@@ -1,6 +1,8 @@
 #include "molecula/server/Server.hpp"
 
+#include "folly/coro/BlockingWait.h"
 #include "molecula/iceberg/Iceberg.hpp"
+#include "molecula/s3/S3CachingClient.hpp"
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
@@ -9,6 +11,13 @@ DEFINE_string(s3_endpoint, "", "S3 endpoint");
 DEFINE_string(s3_access_key, "", "S3 access key");
 DEFINE_string(s3_secret_key, "", "S3 secret key");
 DEFINE_string(s3_region, "us-east-1", "S3 region");
+DEFINE_int64(s3_block_cache_mb, 0, "Memory for cached S3 object blocks, 0 disables the cache");
+DEFINE_string(s3_disk_cache_dir, "", "Directory of the S3 disk cache, empty disables it");
+DEFINE_int64(s3_disk_cache_gb, 100, "Disk space for cached S3 object blocks");
+DEFINE_int32(
+        iceberg_metadata_refresh_ms,
+        1000,
+        "Period of checking cached Iceberg table metadata for changes, 0 disables it");
 
 namespace molecula {
 
@@ -26,11 +35,34 @@ std::unique_ptr<Server> createServer() {
     if (!s3Client) {
         return nullptr;
     }
-    return std::make_unique<Server>(std::move(httpClient), std::move(s3Client));
+    if (FLAGS_s3_block_cache_mb > 0) {
+        S3CachingClientConfig cacheConfig;
+        cacheConfig.cache.capacity = FLAGS_s3_block_cache_mb * 1024 * 1024;
+        cacheConfig.disk.directory = FLAGS_s3_disk_cache_dir;
+        cacheConfig.disk.capacity = FLAGS_s3_disk_cache_gb * 1024 * 1024 * 1024;
+        // Iceberg files are never rewritten, except the version hint of Hadoop tables.
+        cacheConfig.isImmutable = [](std::string_view, std::string_view key) {
+            return !key.ends_with("version-hint.text");
+        };
+        s3Client = std::make_unique<S3CachingClient>(std::move(s3Client), cacheConfig);
+    }
+    iceberg::MetadataCacheConfig metadataCacheConfig;
+    metadataCacheConfig.refreshInterval =
+            std::chrono::milliseconds{FLAGS_iceberg_metadata_refresh_ms};
+    return std::make_unique<Server>(
+            std::move(httpClient), std::move(s3Client), metadataCacheConfig);
 }
 
-Server::Server(std::unique_ptr<HttpClient> httpClient, std::unique_ptr<S3Client> s3Client) :
-    httpClient{std::move(httpClient)}, s3Client{std::move(s3Client)} {}
+Server::Server(
+        std::unique_ptr<HttpClient> httpClient,
+        std::unique_ptr<S3Client> s3Client,
+        const iceberg::MetadataCacheConfig &metadataCacheConfig) :
+    httpClient{std::move(httpClient)},
+    s3Client{std::move(s3Client)},
+    metadataCache{std::make_unique<iceberg::MetadataCache>(
+            this->s3Client.get(), metadataCacheConfig)},
+    tableLoader{std::make_unique<iceberg::TableLoader>(
+            this->s3Client.get(), metadataCache.get(), iceberg::TableLoaderConfig{})} {}
 
 void Server::start() {
     // Start the server
@@ -42,48 +74,32 @@ void Server::stop() {
 
 void Server::testIceberg() {
     LOG(INFO) << "Testing Iceberg...";
-    S3GetObjectRequest s3GetMetadataRequest{"datalake", "db/testtbl/metadata/v2.metadata.json"};
-    auto s3GetMetadata = s3Client->getObject(s3GetMetadataRequest).get();
-    if (s3GetMetadata.status != 200) {
-        LOG(ERROR) << "Failed to get Iceberg metadata, status: " << s3GetMetadata.status;
+    iceberg::LoadedTable table;
+    try {
+        // Manifests are read concurrently, only this thread waits.
+        table = folly::coro::blockingWait(
+                tableLoader->load("s3://datalake/db/testtbl/metadata/v2.metadata.json"));
+    } catch (const std::exception &e) {
+        LOG(ERROR) << "Failed to load Iceberg table: " << e.what();
         return;
     }
 
-    auto metadata =
-            iceberg::Metadata::fromJson(s3GetMetadata.data.view(), s3GetMetadata.data.capacity());
-    LOG(INFO) << "Table UUID: " << metadata->getUuid();
-    LOG(INFO) << "Table location: " << metadata->getLocation();
-
-    auto *currentSnapshot = metadata->findCurrentSnapshot();
-    if (!currentSnapshot) {
+    LOG(INFO) << "Table UUID: " << table.metadata->getUuid();
+    LOG(INFO) << "Table location: " << table.metadata->getLocation();
+    if (!table.manifestList) {
         LOG(ERROR) << "No current snapshot found!";
         return;
     }
 
-    LOG(INFO) << "Current snapshot manifest list: " << currentSnapshot->getManifestList();
-    auto s3ManifestListId = S3Id::fromStringView(currentSnapshot->getManifestList());
-    auto s3GetManifestList = s3Client->getObject(S3GetObjectRequest{s3ManifestListId}).get();
-    if (s3GetManifestList.status != 200) {
-        LOG(ERROR) << "Failed to get Iceberg metadata, status: " << s3GetManifestList.status;
-        return;
-    }
-
-    auto manifestList = iceberg::ManifestList::fromAvro(s3GetManifestList.data.view());
-    for (const auto &entry : manifestList->getManifests()) {
-        LOG(INFO) << "Manifest path: " << entry.manifestPath;
-        LOG(INFO) << "Manifest length: " << entry.manifestLength;
+    LOG(INFO) << "Current snapshot manifest list: "
+              << table.metadata->findCurrentSnapshot()->getManifestList();
+    auto entries = table.manifestList->getManifests();
+    for (size_t i = 0; i < entries.size(); i++) {
+        LOG(INFO) << "Manifest path: " << entries[i].manifestPath;
+        LOG(INFO) << "Manifest length: " << entries[i].manifestLength;
         LOG(INFO) << "Manifest content: "
-                  << (entry.content == iceberg::ManifestContent::Data ? "data" : "deletes");
-
-        auto s3ManifestId = S3Id::fromStringView(entry.manifestPath);
-        auto s3GetManifest =
-                s3Client->getObject(S3GetObjectRequest{s3ManifestId.bucket(), s3ManifestId.key()})
-                        .get();
-        if (s3GetManifest.status != 200) {
-            LOG(ERROR) << "Failed to get Iceberg metadata, status: " << s3GetManifest.status;
-            return;
-        }
-        auto manifest = iceberg::Manifest::fromAvro(s3GetManifest.data.view());
+                  << (entries[i].content == iceberg::ManifestContent::Data ? "data" : "deletes");
+        LOG(INFO) << "Manifest files: " << table.manifests[i]->getDataFiles().size();
     }
 }
 
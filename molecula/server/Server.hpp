@@ -1,6 +1,8 @@
 #pragma once
 
 #include "molecula/http_client/HttpClient.hpp"
+#include "molecula/iceberg/IcebergMetadataCache.hpp"
+#include "molecula/iceberg/IcebergTableLoader.hpp"
 #include "molecula/s3/S3Client.hpp"
 
 #include <memory>
@@ -10,7 +12,9 @@ namespace molecula {
 // SQL server.
 class Server {
 public:
-    Server(std::unique_ptr<HttpClient> httpClient, std::unique_ptr<S3Client> s3Client);
+    Server(std::unique_ptr<HttpClient> httpClient,
+           std::unique_ptr<S3Client> s3Client,
+           const iceberg::MetadataCacheConfig &metadataCacheConfig);
 
     void start();
     void stop();
@@ -19,6 +23,9 @@ public:
 private:
     std::unique_ptr<HttpClient> httpClient;
     std::unique_ptr<S3Client> s3Client;
+    // Parsed table metadata, refreshed in the background.
+    std::unique_ptr<iceberg::MetadataCache> metadataCache;
+    std::unique_ptr<iceberg::TableLoader> tableLoader;
 };
 
 std::unique_ptr<Server> createServer();